@@ -1,6 +1,7 @@
 #ifndef CMCPP_HPP
 #define CMCPP_HPP
 
+#include <cmcpp/alloc.hpp>
 #include <cmcpp/context.hpp>
 #include <cmcpp/monostate.hpp>
 #include <cmcpp/bool.hpp>
@@ -9,6 +10,7 @@
 #include <cmcpp/string.hpp>
 #include <cmcpp/error_context.hpp>
 #include <cmcpp/flags.hpp>
+#include <cmcpp/handle.hpp>
 #include <cmcpp/tuple.hpp>
 #include <cmcpp/record.hpp>
 #include <cmcpp/list.hpp>
@@ -18,5 +20,14 @@
 #include <cmcpp/lower.hpp>
 #include <cmcpp/lift.hpp>
 #include <cmcpp/runtime.hpp>
+#include <cmcpp/coro.hpp>
+#include <cmcpp/fiber.hpp>
+#include <cmcpp/reactor.hpp>
+#include <cmcpp/thread_pool.hpp>
+#include <cmcpp/concurrent_table.hpp>
+#include <cmcpp/host_resource.hpp>
+#include <cmcpp/host_stream.hpp>
+#include <cmcpp/fd_stream.hpp>
+#include <cmcpp/stream_adapter.hpp>
 
 #endif // CMCPP_HPP
\ No newline at end of file
@@ -0,0 +1,380 @@
+#ifndef CMCPP_ALLOC_HPP
+#define CMCPP_ALLOC_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cmcpp
+{
+    //  Move-only callable with inline storage ---
+    //  Behaves like std::function but never allocates when the callable fits in
+    //  Capacity bytes, and accepts move-only captures.
+    template <typename Signature, std::size_t Capacity = 48>
+    class InlineFunction;
+
+    template <typename R, typename... Args, std::size_t Capacity>
+    class InlineFunction<R(Args...), Capacity>
+    {
+    public:
+        InlineFunction() noexcept = default;
+        InlineFunction(std::nullptr_t) noexcept {}
+
+        template <typename F, typename Fn = std::decay_t<F>,
+                  typename = std::enable_if_t<!std::is_same_v<Fn, InlineFunction> && std::is_invocable_r_v<R, Fn &, Args...>>>
+        InlineFunction(F &&f)
+        {
+            if constexpr (std::is_pointer_v<Fn> || std::is_member_pointer_v<Fn> || std::is_same_v<Fn, std::function<R(Args...)>>)
+            {
+                if (!f)
+                {
+                    return;
+                }
+            }
+            if constexpr (stored_inline<Fn>())
+            {
+                ::new (static_cast<void *>(&storage_)) Fn(std::forward<F>(f));
+                ops_ = &inline_ops<Fn>;
+            }
+            else
+            {
+                *reinterpret_cast<Fn **>(&storage_) = new Fn(std::forward<F>(f));
+                ops_ = &heap_ops<Fn>;
+            }
+        }
+
+        InlineFunction(InlineFunction &&other) noexcept
+        {
+            move_from(other);
+        }
+
+        InlineFunction &operator=(InlineFunction &&other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                move_from(other);
+            }
+            return *this;
+        }
+
+        InlineFunction &operator=(std::nullptr_t) noexcept
+        {
+            reset();
+            return *this;
+        }
+
+        InlineFunction(const InlineFunction &) = delete;
+        InlineFunction &operator=(const InlineFunction &) = delete;
+
+        ~InlineFunction()
+        {
+            reset();
+        }
+
+        explicit operator bool() const noexcept
+        {
+            return ops_ != nullptr;
+        }
+
+        R operator()(Args... args) const
+        {
+            if (!ops_)
+            {
+                throw std::bad_function_call();
+            }
+            return ops_->invoke(const_cast<void *>(static_cast<const void *>(&storage_)), std::forward<Args>(args)...);
+        }
+
+        void reset() noexcept
+        {
+            if (ops_)
+            {
+                ops_->destroy(&storage_);
+                ops_ = nullptr;
+            }
+        }
+
+    private:
+        struct Ops
+        {
+            R (*invoke)(void *, Args &&...);
+            void (*move)(void *dst, void *src) noexcept;
+            void (*destroy)(void *) noexcept;
+        };
+
+        template <typename Fn>
+        static constexpr bool stored_inline()
+        {
+            return sizeof(Fn) <= Capacity && alignof(Fn) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<Fn>;
+        }
+
+        template <typename Fn>
+        static constexpr Ops inline_ops{
+            [](void *p, Args &&...args) -> R
+            { return std::invoke(*static_cast<Fn *>(p), std::forward<Args>(args)...); },
+            [](void *dst, void *src) noexcept
+            {
+                ::new (dst) Fn(std::move(*static_cast<Fn *>(src)));
+                static_cast<Fn *>(src)->~Fn();
+            },
+            [](void *p) noexcept
+            { static_cast<Fn *>(p)->~Fn(); }};
+
+        template <typename Fn>
+        static constexpr Ops heap_ops{
+            [](void *p, Args &&...args) -> R
+            { return std::invoke(**static_cast<Fn **>(p), std::forward<Args>(args)...); },
+            [](void *dst, void *src) noexcept
+            { *static_cast<Fn **>(dst) = *static_cast<Fn **>(src); },
+            [](void *p) noexcept
+            { delete *static_cast<Fn **>(p); }};
+
+        void move_from(InlineFunction &other) noexcept
+        {
+            if (other.ops_)
+            {
+                other.ops_->move(&storage_, &other.storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+
+        alignas(std::max_align_t) mutable unsigned char storage_[Capacity];
+        const Ops *ops_ = nullptr;
+    };
+
+    //  Fixed-size block pool ---
+    //  Hands out blocks of a single size from slabs, recycling freed blocks through
+    //  an embedded free list.  Requests of any other size fall through to the
+    //  global allocator, so it is safe to rebind across types.
+    class SlabPool
+    {
+    public:
+        static constexpr std::size_t BLOCKS_PER_SLAB = 64;
+
+        SlabPool() = default;
+        SlabPool(const SlabPool &) = delete;
+        SlabPool &operator=(const SlabPool &) = delete;
+
+        void *allocate(std::size_t bytes, std::size_t alignment)
+        {
+            if (alignment > alignof(std::max_align_t))
+            {
+                return ::operator new(bytes, std::align_val_t(alignment));
+            }
+            std::lock_guard lock(mutex_);
+            if (block_size_ == 0)
+            {
+                block_size_ = round_up(bytes);
+            }
+            if (round_up(bytes) != block_size_)
+            {
+                return ::operator new(bytes);
+            }
+            if (!free_)
+            {
+                grow();
+            }
+            auto *block = free_;
+            free_ = free_->next;
+            live_ += 1;
+            return block;
+        }
+
+        void deallocate(void *p, std::size_t bytes, std::size_t alignment) noexcept
+        {
+            if (alignment > alignof(std::max_align_t))
+            {
+                ::operator delete(p, std::align_val_t(alignment));
+                return;
+            }
+            std::lock_guard lock(mutex_);
+            if (round_up(bytes) != block_size_)
+            {
+                ::operator delete(p);
+                return;
+            }
+            auto *block = static_cast<FreeBlock *>(p);
+            block->next = free_;
+            free_ = block;
+            live_ -= 1;
+        }
+
+        std::size_t live() const
+        {
+            std::lock_guard lock(mutex_);
+            return live_;
+        }
+
+        std::size_t capacity() const
+        {
+            std::lock_guard lock(mutex_);
+            return slabs_.size() * BLOCKS_PER_SLAB;
+        }
+
+    private:
+        struct FreeBlock
+        {
+            FreeBlock *next;
+        };
+
+        static std::size_t round_up(std::size_t bytes)
+        {
+            constexpr std::size_t align = alignof(std::max_align_t);
+            bytes = std::max(bytes, sizeof(FreeBlock));
+            return (bytes + align - 1) & ~(align - 1);
+        }
+
+        void grow()
+        {
+            slabs_.emplace_back(new std::max_align_t[(block_size_ * BLOCKS_PER_SLAB) / sizeof(std::max_align_t)]);
+            auto *base = reinterpret_cast<unsigned char *>(slabs_.back().get());
+            for (std::size_t i = BLOCKS_PER_SLAB; i-- > 0;)
+            {
+                auto *block = reinterpret_cast<FreeBlock *>(base + i * block_size_);
+                block->next = free_;
+                free_ = block;
+            }
+        }
+
+        mutable std::mutex mutex_;
+        std::vector<std::unique_ptr<std::max_align_t[]>> slabs_;
+        FreeBlock *free_ = nullptr;
+        std::size_t block_size_ = 0;
+        std::size_t live_ = 0;
+    };
+
+    //  Vector of trivially copyable values that keeps its first N elements
+    //  inline and only allocates once it grows past them.
+    template <typename T, std::size_t N>
+    class SmallVector
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "SmallVector holds trivially copyable values");
+
+    public:
+        SmallVector() noexcept = default;
+
+        SmallVector(const SmallVector &other) : size_(other.size_), heap_(other.heap_)
+        {
+            std::copy(other.inline_, other.inline_ + std::min(size_, N), inline_);
+        }
+
+        SmallVector &operator=(const SmallVector &other)
+        {
+            size_ = other.size_;
+            heap_ = other.heap_;
+            std::copy(other.inline_, other.inline_ + std::min(size_, N), inline_);
+            return *this;
+        }
+
+        void push_back(const T &value)
+        {
+            if (size_ < N)
+            {
+                inline_[size_] = value;
+            }
+            else
+            {
+                heap_.push_back(value);
+            }
+            size_ += 1;
+        }
+
+        void clear() noexcept
+        {
+            size_ = 0;
+            heap_.clear();
+        }
+
+        std::size_t size() const noexcept
+        {
+            return size_;
+        }
+
+        bool empty() const noexcept
+        {
+            return size_ == 0;
+        }
+
+        //  True once elements have spilled to the heap.
+        bool spilled() const noexcept
+        {
+            return size_ > N;
+        }
+
+        T &operator[](std::size_t i)
+        {
+            return i < N ? inline_[i] : heap_[i - N];
+        }
+
+        const T &operator[](std::size_t i) const
+        {
+            return i < N ? inline_[i] : heap_[i - N];
+        }
+
+        template <typename F>
+        void for_each(F &&fn)
+        {
+            for (std::size_t i = 0; i < std::min(size_, N); ++i)
+            {
+                fn(inline_[i]);
+            }
+            for (auto &value : heap_)
+            {
+                fn(value);
+            }
+        }
+
+    private:
+        std::size_t size_ = 0;
+        T inline_[N]{};
+        std::vector<T> heap_;
+    };
+
+    //  Standard allocator over a shared SlabPool.  Holding the pool by shared_ptr
+    //  keeps it alive for as long as any control block still refers to it.
+    template <typename T>
+    class PoolAllocator
+    {
+    public:
+        using value_type = T;
+
+        explicit PoolAllocator(std::shared_ptr<SlabPool> pool) noexcept : pool_(std::move(pool)) {}
+
+        template <typename U>
+        PoolAllocator(const PoolAllocator<U> &other) noexcept : pool_(other.pool()) {}
+
+        T *allocate(std::size_t n)
+        {
+            return static_cast<T *>(pool_->allocate(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T *p, std::size_t n) noexcept
+        {
+            pool_->deallocate(p, n * sizeof(T), alignof(T));
+        }
+
+        const std::shared_ptr<SlabPool> &pool() const noexcept
+        {
+            return pool_;
+        }
+
+        template <typename U>
+        bool operator==(const PoolAllocator<U> &other) const noexcept
+        {
+            return pool_ == other.pool();
+        }
+
+    private:
+        std::shared_ptr<SlabPool> pool_;
+    };
+}
+
+#endif
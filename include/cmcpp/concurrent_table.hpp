@@ -0,0 +1,654 @@
+#ifndef CMCPP_CONCURRENT_TABLE_HPP
+#define CMCPP_CONCURRENT_TABLE_HPP
+
+#include "context.hpp"
+
+//  Opt-in concurrent handle and instance tables.
+//
+//  ComponentInstance::handles and ComponentInstance::table assume a single
+//  thread.  A host that resolves handles of one instance from several worker
+//  threads can keep its handles in ConcurrentHandleTables/ConcurrentInstanceTable
+//  instead.  Lookups of existing slots take no lock: slots live in segments that
+//  never move, and a reader pins an EpochDomain for as long as it dereferences
+//  an entry.  add and remove use sharded free lists, and removed entries are
+//  reclaimed once no reader pinned before the removal can still see them.
+//  Freed indices are reused most recent first within a shard only.
+
+#include <bit>
+#include <functional>
+#include <thread>
+
+namespace cmcpp
+{
+    //  Small per-thread number used to spread threads over shards and epoch
+    //  records.
+    inline std::size_t this_thread_shard()
+    {
+        thread_local const std::size_t shard = std::hash<std::thread::id>{}(std::this_thread::get_id());
+        return shard;
+    }
+
+    [[noreturn]] inline void table_trap(const HostTrap &trap, const char *message)
+    {
+        auto trap_cx = make_trap_context(trap);
+        trap_if(trap_cx, true, message);
+        throw std::logic_error(message);
+    }
+
+    //  Epoch-based reclamation ---
+    //  A reader publishes the global epoch in a record while pinned.  An object
+    //  retired at epoch e is freed once every pinned record shows an epoch
+    //  above e; readers pinned later cannot reach it because it was unlinked
+    //  before the epoch advanced.
+    class EpochDomain
+    {
+        struct Record;
+
+    public:
+        static constexpr std::size_t MAX_READERS = 64;
+        static constexpr std::size_t COLLECT_THRESHOLD = 64;
+
+        class Guard
+        {
+        public:
+            Guard(const Guard &) = delete;
+            Guard &operator=(const Guard &) = delete;
+
+            ~Guard()
+            {
+                record_->epoch.store(0);
+                record_->in_use.store(false, std::memory_order_release);
+            }
+
+        private:
+            friend class EpochDomain;
+
+            explicit Guard(EpochDomain &domain) : record_(domain.claim())
+            {
+                record_->epoch.store(domain.epoch_.load());
+                //  Pairs with the fence in collect_locked(): the collector
+                //  sees this pin or this reader sees the unlinked slot.
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+
+            Record *record_;
+        };
+
+        EpochDomain() = default;
+        EpochDomain(const EpochDomain &) = delete;
+        EpochDomain &operator=(const EpochDomain &) = delete;
+
+        ~EpochDomain()
+        {
+            for (auto &item : retired_)
+            {
+                item.deleter(item.ptr);
+            }
+        }
+
+        Guard pin()
+        {
+            return Guard(*this);
+        }
+
+        //  ptr must already be unreachable for readers that pin from now on.
+        void retire(void *ptr, void (*deleter)(void *))
+        {
+            uint64_t epoch = epoch_.fetch_add(1);
+            std::lock_guard<std::mutex> lock(mutex_);
+            retired_.push_back({ptr, deleter, epoch});
+            if (retired_.size() >= COLLECT_THRESHOLD)
+            {
+                collect_locked();
+            }
+        }
+
+        template <typename T>
+        void retire(T *ptr)
+        {
+            retire(ptr, [](void *p)
+                   { delete static_cast<T *>(p); });
+        }
+
+        //  Frees every retired object that no pinned reader can reach.
+        void collect()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            collect_locked();
+        }
+
+        std::size_t retired() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return retired_.size();
+        }
+
+    private:
+        struct alignas(64) Record
+        {
+            std::atomic<uint64_t> epoch{0};
+            std::atomic<bool> in_use{false};
+        };
+
+        struct Retired
+        {
+            void *ptr;
+            void (*deleter)(void *);
+            uint64_t epoch;
+        };
+
+        Record *claim()
+        {
+            std::size_t start = this_thread_shard();
+            for (;;)
+            {
+                for (std::size_t i = 0; i < MAX_READERS; ++i)
+                {
+                    auto &record = records_[(start + i) % MAX_READERS];
+                    bool expected = false;
+                    if (!record.in_use.load(std::memory_order_relaxed) &&
+                        record.in_use.compare_exchange_strong(expected, true, std::memory_order_acquire))
+                    {
+                        return &record;
+                    }
+                }
+                std::this_thread::yield();
+            }
+        }
+
+        void collect_locked()
+        {
+            //  Order the caller's unlink before the scan of pinned epochs.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            uint64_t oldest = UINT64_MAX;
+            for (const auto &record : records_)
+            {
+                uint64_t epoch = record.epoch.load();
+                if (epoch != 0)
+                {
+                    oldest = std::min(oldest, epoch);
+                }
+            }
+            auto keep = std::partition(retired_.begin(), retired_.end(), [oldest](const Retired &item)
+                                       { return item.epoch >= oldest; });
+            for (auto it = keep; it != retired_.end(); ++it)
+            {
+                it->deleter(it->ptr);
+            }
+            retired_.erase(keep, retired_.end());
+        }
+
+        std::array<Record, MAX_READERS> records_{};
+        std::atomic<uint64_t> epoch_{1};
+        mutable std::mutex mutex_;
+        std::vector<Retired> retired_;
+    };
+
+    //  Index-addressed storage in segments of doubling size.  Segments are
+    //  allocated on first touch and never move, so a reference stays valid for
+    //  the lifetime of the array and lookups need no lock.
+    template <typename T>
+    class SegmentedArray
+    {
+    public:
+        static constexpr uint32_t BASE_BITS = 6;
+        static constexpr uint32_t SEGMENTS = 25;
+
+        SegmentedArray() = default;
+        SegmentedArray(const SegmentedArray &) = delete;
+        SegmentedArray &operator=(const SegmentedArray &) = delete;
+
+        ~SegmentedArray()
+        {
+            for (auto &segment : segments_)
+            {
+                delete[] segment.load(std::memory_order_relaxed);
+            }
+        }
+
+        //  nullptr when index lies in a segment not yet allocated.
+        T *find(uint32_t index) const
+        {
+            auto [segment, offset] = locate(index);
+            if (segment >= SEGMENTS)
+            {
+                return nullptr;
+            }
+            T *base = segments_[segment].load(std::memory_order_acquire);
+            return base ? base + offset : nullptr;
+        }
+
+        T &at(uint32_t index)
+        {
+            auto [segment, offset] = locate(index);
+            T *base = segments_[segment].load(std::memory_order_acquire);
+            if (!base)
+            {
+                T *fresh = new T[std::size_t{1} << (BASE_BITS + segment)]();
+                if (segments_[segment].compare_exchange_strong(base, fresh, std::memory_order_acq_rel))
+                {
+                    base = fresh;
+                }
+                else
+                {
+                    delete[] fresh;
+                }
+            }
+            return base[offset];
+        }
+
+    private:
+        static std::pair<uint32_t, uint32_t> locate(uint32_t index)
+        {
+            uint64_t biased = uint64_t{index} + (uint64_t{1} << BASE_BITS);
+            uint32_t segment = static_cast<uint32_t>(std::bit_width(biased)) - 1 - BASE_BITS;
+            return {segment, static_cast<uint32_t>(biased - (uint64_t{1} << (BASE_BITS + segment)))};
+        }
+
+        mutable std::array<std::atomic<T *>, SEGMENTS> segments_{};
+    };
+
+    //  Slot table of heap-boxed values with lock-free lookup.  Index 0 is
+    //  reserved.  Pointers returned by find and remove stay valid while the
+    //  caller holds a Guard from epochs().
+    template <typename T>
+    class ConcurrentSlotTable
+    {
+    public:
+        static constexpr uint32_t MAX_LENGTH = 1u << 30;
+        static constexpr std::size_t SHARDS = 16;
+
+        ConcurrentSlotTable() = default;
+        ConcurrentSlotTable(const ConcurrentSlotTable &) = delete;
+        ConcurrentSlotTable &operator=(const ConcurrentSlotTable &) = delete;
+
+        ~ConcurrentSlotTable()
+        {
+            uint32_t end = next_.load();
+            for (uint32_t i = 1; i < end && i < MAX_LENGTH; ++i)
+            {
+                if (auto *slot = slots_.find(i))
+                {
+                    delete slot->value.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        EpochDomain &epochs() const
+        {
+            return epochs_;
+        }
+
+        uint32_t add(std::unique_ptr<T> value, const HostTrap &trap)
+        {
+            uint32_t index = take_free();
+            if (index == 0)
+            {
+                index = next_.fetch_add(1);
+                if (index >= MAX_LENGTH)
+                {
+                    table_trap(trap, "table overflow");
+                }
+            }
+            slots_.at(index).value.store(value.release(), std::memory_order_release);
+            return index;
+        }
+
+        T *find(uint32_t index, const EpochDomain::Guard &) const
+        {
+            auto *slot = index == 0 ? nullptr : slots_.find(index);
+            return slot ? slot->value.load(std::memory_order_acquire) : nullptr;
+        }
+
+        uint32_t generation(uint32_t index) const
+        {
+            auto *slot = index == 0 ? nullptr : slots_.find(index);
+            return slot ? slot->generation.load(std::memory_order_acquire) : 0;
+        }
+
+        //  Unlinks the value at index and retires it; returns nullptr if the slot
+        //  is empty or was removed concurrently.  With expected set, only that
+        //  value is unlinked.
+        T *remove(uint32_t index, const EpochDomain::Guard &, T *expected = nullptr)
+        {
+            auto *slot = index == 0 ? nullptr : slots_.find(index);
+            if (!slot)
+            {
+                return nullptr;
+            }
+            T *value = expected;
+            if (expected)
+            {
+                if (!slot->value.compare_exchange_strong(value, nullptr, std::memory_order_acq_rel))
+                {
+                    return nullptr;
+                }
+            }
+            else
+            {
+                value = slot->value.exchange(nullptr, std::memory_order_acq_rel);
+            }
+            if (!value)
+            {
+                return nullptr;
+            }
+            slot->generation.fetch_add(1, std::memory_order_release);
+            epochs_.retire(value);
+            auto &shard = shards_[this_thread_shard() % SHARDS];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.free.push_back(index);
+            return value;
+        }
+
+        //  Bounded by the highest index handed out, not by the live count.
+        template <typename F>
+        void for_each(F &&fn, const EpochDomain::Guard &guard) const
+        {
+            uint32_t end = std::min(next_.load(), MAX_LENGTH);
+            for (uint32_t i = 1; i < end; ++i)
+            {
+                if (auto *value = find(i, guard))
+                {
+                    fn(i, *value);
+                }
+            }
+        }
+
+    private:
+        struct Slot
+        {
+            std::atomic<T *> value{nullptr};
+            std::atomic<uint32_t> generation{0};
+        };
+
+        struct alignas(64) Shard
+        {
+            std::mutex mutex;
+            std::vector<uint32_t> free;
+        };
+
+        //  The calling thread's shard first, then any other shard that is not
+        //  contended, before the table grows.
+        uint32_t take_free()
+        {
+            std::size_t home = this_thread_shard() % SHARDS;
+            for (std::size_t i = 0; i < SHARDS; ++i)
+            {
+                auto &shard = shards_[(home + i) % SHARDS];
+                std::unique_lock<std::mutex> lock(shard.mutex, std::defer_lock);
+                if (i == 0)
+                {
+                    lock.lock();
+                }
+                else if (!lock.try_lock())
+                {
+                    continue;
+                }
+                if (!shard.free.empty())
+                {
+                    uint32_t index = shard.free.back();
+                    shard.free.pop_back();
+                    return index;
+                }
+            }
+            return 0;
+        }
+
+        SegmentedArray<Slot> slots_;
+        std::atomic<uint32_t> next_{1};
+        std::array<Shard, SHARDS> shards_;
+        mutable EpochDomain epochs_;
+    };
+
+    //  Handle element with an atomic lend count, so lends and drops can race
+    //  from different threads.
+    struct ConcurrentHandle
+    {
+        uint32_t rep = 0;
+        bool own = false;
+        LiftLowerContext *scope = nullptr;
+        std::atomic<uint32_t> lend_count{0};
+
+        HandleElement element() const
+        {
+            return {rep, own, scope, lend_count.load()};
+        }
+    };
+
+    //  Concurrent counterpart of HandleTables, indexed by ResourceType::id().
+    class ConcurrentHandleTables
+    {
+    public:
+        using Table = ConcurrentSlotTable<ConcurrentHandle>;
+
+        ConcurrentHandleTables() = default;
+        ConcurrentHandleTables(const ConcurrentHandleTables &) = delete;
+        ConcurrentHandleTables &operator=(const ConcurrentHandleTables &) = delete;
+
+        ~ConcurrentHandleTables()
+        {
+            for (uint32_t i = 0; i < size_.load(); ++i)
+            {
+                if (auto *entry = tables_.find(i))
+                {
+                    delete entry->load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        uint32_t add(const ResourceType &rt, const HandleElement &element, const HostTrap &trap)
+        {
+            auto handle = std::make_unique<ConcurrentHandle>();
+            handle->rep = element.rep;
+            handle->own = element.own;
+            handle->scope = element.scope;
+            handle->lend_count.store(element.lend_count, std::memory_order_relaxed);
+            return table(rt).add(std::move(handle), trap);
+        }
+
+        HandleElement get(const ResourceType &rt, uint32_t index, const HostTrap &trap) const
+        {
+            auto &t = existing(rt, trap);
+            auto guard = t.epochs().pin();
+            return live(t.find(index, guard), trap)->element();
+        }
+
+        uint32_t rep(const ResourceType &rt, uint32_t index, const HostTrap &trap) const
+        {
+            auto &t = existing(rt, trap);
+            auto guard = t.epochs().pin();
+            return live(t.find(index, guard), trap)->rep;
+        }
+
+        HandleElement remove(const ResourceType &rt, uint32_t index, const HostTrap &trap)
+        {
+            auto &t = existing(rt, trap);
+            auto guard = t.epochs().pin();
+            return live(t.remove(index, guard), trap)->element();
+        }
+
+        //  A lend that races with a drop of the same handle either lands first
+        //  (the drop then traps on the outstanding lend) or traps itself.
+        void lend(const ResourceType &rt, uint32_t index, const HostTrap &trap)
+        {
+            auto &t = existing(rt, trap);
+            auto guard = t.epochs().pin();
+            auto *handle = live(t.find(index, guard), trap);
+            if (!handle->own)
+            {
+                table_trap(trap, "lender must own resource");
+            }
+            handle->lend_count.fetch_add(1);
+            if (t.find(index, guard) != handle)
+            {
+                handle->lend_count.fetch_sub(1);
+                table_trap(trap, "resource slot empty");
+            }
+        }
+
+        void end_lend(const ResourceType &rt, uint32_t index)
+        {
+            if (auto *t = find(rt))
+            {
+                auto guard = t->epochs().pin();
+                if (auto *handle = t->find(index, guard))
+                {
+                    uint32_t count = handle->lend_count.load();
+                    while (count > 0 && !handle->lend_count.compare_exchange_weak(count, count - 1))
+                    {
+                    }
+                }
+            }
+        }
+
+        Table &table(const ResourceType &rt)
+        {
+            auto &entry = tables_.at(rt.id());
+            Table *t = entry.load(std::memory_order_acquire);
+            if (!t)
+            {
+                auto fresh = std::make_unique<Table>();
+                if (entry.compare_exchange_strong(t, fresh.get(), std::memory_order_acq_rel))
+                {
+                    t = fresh.release();
+                    uint32_t size = size_.load();
+                    while (size <= rt.id() && !size_.compare_exchange_weak(size, rt.id() + 1))
+                    {
+                    }
+                }
+            }
+            return *t;
+        }
+
+        Table *find(const ResourceType &rt) const
+        {
+            auto *entry = tables_.find(rt.id());
+            return entry ? entry->load(std::memory_order_acquire) : nullptr;
+        }
+
+    private:
+        Table &existing(const ResourceType &rt, const HostTrap &trap) const
+        {
+            auto *t = find(rt);
+            if (!t)
+            {
+                table_trap(trap, "resource table missing");
+            }
+            return *t;
+        }
+
+        template <typename H>
+        static H *live(H *handle, const HostTrap &trap)
+        {
+            if (!handle)
+            {
+                table_trap(trap, "resource slot empty");
+            }
+            return handle;
+        }
+
+        SegmentedArray<std::atomic<Table *>> tables_;
+        std::atomic<uint32_t> size_{0};
+    };
+
+    //  Concurrent counterpart of InstanceTable.  Entries keep their shared
+    //  ownership; get() hands out a reference taken while the slot is pinned.
+    class ConcurrentInstanceTable
+    {
+    public:
+        uint32_t add(const std::shared_ptr<TableEntry> &entry, const HostTrap &trap)
+        {
+            if (!entry)
+            {
+                table_trap(trap, "null table entry");
+            }
+            return slots_.add(std::make_unique<Box>(Box{entry}), trap);
+        }
+
+        template <typename T = TableEntry>
+        std::shared_ptr<T> get(uint32_t index, const HostTrap &trap) const
+        {
+            auto guard = slots_.epochs().pin();
+            return std::static_pointer_cast<T>(checked<T>(slots_.find(index, guard), trap)->entry);
+        }
+
+        template <typename T>
+        std::shared_ptr<T> get(TableKey key, const HostTrap &trap) const
+        {
+            auto guard = slots_.epochs().pin();
+            auto entry = std::static_pointer_cast<T>(checked<T>(slots_.find(key.index, guard), trap)->entry);
+            if (slots_.generation(key.index) != key.generation)
+            {
+                table_trap(trap, "stale table handle");
+            }
+            return entry;
+        }
+
+        TableKey key(uint32_t index, const HostTrap &trap) const
+        {
+            auto guard = slots_.epochs().pin();
+            checked<TableEntry>(slots_.find(index, guard), trap);
+            return {index, slots_.generation(index)};
+        }
+
+        template <typename T = TableEntry>
+        std::shared_ptr<T> remove(uint32_t index, const HostTrap &trap)
+        {
+            auto guard = slots_.epochs().pin();
+            auto *box = checked<T>(slots_.find(index, guard), trap);
+            if (!slots_.remove(index, guard, box))
+            {
+                table_trap(trap, "table slot empty");
+            }
+            return std::static_pointer_cast<T>(box->entry);
+        }
+
+        //  Reclaims removed slots that no reader can still reach.
+        void collect()
+        {
+            slots_.epochs().collect();
+        }
+
+    private:
+        struct Box
+        {
+            std::shared_ptr<TableEntry> entry;
+        };
+
+        template <typename T>
+        static Box *checked(Box *box, const HostTrap &trap)
+        {
+            if (!box)
+            {
+                table_trap(trap, "table slot empty");
+            }
+            if (!InstanceTable::matches<T>(*box->entry))
+            {
+                table_trap(trap, "table entry type mismatch");
+            }
+            return box;
+        }
+
+        ConcurrentSlotTable<Box> slots_;
+    };
+
+    inline uint32_t canon_resource_new(ConcurrentHandleTables &handles, const ResourceType &rt, uint32_t rep, const HostTrap &trap)
+    {
+        HandleElement element;
+        element.rep = rep;
+        element.own = true;
+        return handles.add(rt, element, trap);
+    }
+
+    inline uint32_t canon_resource_rep(const ConcurrentHandleTables &handles, const ResourceType &rt, uint32_t index, const HostTrap &trap)
+    {
+        return handles.rep(rt, index, trap);
+    }
+
+    inline void canon_resource_drop(const ComponentInstance &inst, ConcurrentHandleTables &handles, const ResourceType &rt, uint32_t index, const HostTrap &trap)
+    {
+        release_handle(inst, rt, handles.remove(rt, index, trap), trap);
+    }
+}
+
+#endif
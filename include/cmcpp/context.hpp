@@ -7,12 +7,14 @@
 #include <algorithm>
 #include <array>
 #include <deque>
+#include <functional>
 #include <future>
 #include <memory>
 #include <optional>
 #include <random>
 #include <stdexcept>
 #include <thread>
+#include <tuple>
 #include <condition_variable>
 #include <typeindex>
 #include <unordered_map>
@@ -79,7 +81,36 @@ namespace cmcpp
     };
 
     struct ComponentInstance;
-    struct HandleElement;
+    class HandleTable;
+
+    //  An owned handle lent for the duration of a call; see track_owning_lend.
+    struct HandleLend
+    {
+        HandleTable *table = nullptr;
+        uint32_t index = 0;
+    };
+
+    //  Slab pools for the short-lived objects of an async call (Supertasks, guest
+    //  copy buffers, lift/lower contexts).  Each pool serves a single block size,
+    //  so a released object's block is reused by the next call of the same kind.
+    struct CallPools
+    {
+        std::shared_ptr<SlabPool> supertasks = std::make_shared<SlabPool>();
+        std::shared_ptr<SlabPool> buffers = std::make_shared<SlabPool>();
+        std::shared_ptr<SlabPool> contexts = std::make_shared<SlabPool>();
+    };
+
+    //  Allocates T together with its control block from pool, or from the heap
+    //  when there is no pool.
+    template <typename T, typename... Args>
+    std::shared_ptr<T> make_pooled(const std::shared_ptr<SlabPool> &pool, Args &&...args)
+    {
+        if (!pool)
+        {
+            return std::make_shared<T>(std::forward<Args>(args)...);
+        }
+        return std::allocate_shared<T>(PoolAllocator<T>(pool), std::forward<Args>(args)...);
+    }
 
     class LiftLowerContext
     {
@@ -89,7 +120,9 @@ namespace cmcpp
 
         LiftLowerOptions opts;
         ComponentInstance *inst = nullptr;
-        std::vector<HandleElement *> lenders;
+        //  Owned handles lent to this call.  Lifting a borrow records a lender
+        //  through a const context, hence mutable.
+        mutable SmallVector<HandleLend, 8> lenders;
         uint32_t borrow_count = 0;
 
         LiftLowerContext(const HostTrap &host_trap, const HostUnicodeConversion &conversion, const LiftLowerOptions &options, ComponentInstance *instance = nullptr)
@@ -102,7 +135,7 @@ namespace cmcpp
         void invoke_post_return() const;
         void notify_async_event(EventCode code, uint32_t index, uint32_t payload) const;
 
-        void track_owning_lend(HandleElement &lending_handle);
+        void track_owning_lend(HandleTable &table, uint32_t index) const;
         void exit_call();
 
     private:
@@ -200,17 +233,37 @@ namespace cmcpp
         uint32_t payload = 0;
     };
 
+    //  Compact type tag stored in every table entry so InstanceTable lookups can
+    //  check types without RTTI.  Kinds from Waitable on are all Waitables.
+    enum class EntryKind : uint8_t
+    {
+        Other = 0,
+        Thread,
+        WaitableSet,
+        ErrorContext,
+        Waitable,
+        ReadableStream,
+        WritableStream,
+        ReadableFuture,
+        WritableFuture
+    };
+
     struct TableEntry
     {
+        explicit TableEntry(EntryKind kind = EntryKind::Other) : kind(kind) {}
         virtual ~TableEntry() = default;
+
+        const EntryKind kind;
     };
 
     class WaitableSet;
 
-    class ThreadEntry : public TableEntry
+    class ThreadEntry final : public TableEntry
     {
     public:
-        explicit ThreadEntry(std::shared_ptr<Thread> thread) : thread_(std::move(thread)) {}
+        static constexpr EntryKind KIND = EntryKind::Thread;
+
+        explicit ThreadEntry(std::shared_ptr<Thread> thread) : TableEntry(KIND), thread_(std::move(thread)) {}
 
         const std::shared_ptr<Thread> &thread() const
         {
@@ -224,100 +277,122 @@ namespace cmcpp
     class Waitable : public TableEntry
     {
     public:
-        Waitable() = default;
+        static constexpr EntryKind KIND = EntryKind::Waitable;
 
-        void set_pending_event(const Event &event, ReclaimBuffer reclaim = {})
-        {
-            pending_event_ = event;
-            pending_reclaim_ = std::move(reclaim);
-        }
+        Waitable() : TableEntry(KIND) {}
+
+        void set_pending_event(const Event &event, ReclaimBuffer reclaim = {});
 
         bool has_pending_event() const
         {
+            std::lock_guard lock(mu_);
             return pending_event_.has_value();
         }
 
-        Event get_pending_event(const HostTrap &trap)
-        {
-            auto trap_cx = make_trap_context(trap);
-            trap_if(trap_cx, !pending_event_.has_value(), "waitable pending event missing");
-            auto reclaim = std::move(pending_reclaim_);
-            Event event = *pending_event_;
-            pending_event_.reset();
-            pending_reclaim_ = {};
-            if (reclaim)
-            {
-                reclaim();
-            }
-            return event;
-        }
+        Event get_pending_event(const HostTrap &trap);
 
-        void clear_pending_event()
-        {
-            pending_event_.reset();
-            pending_reclaim_ = {};
-        }
+        void clear_pending_event();
 
         void join(WaitableSet *set, const HostTrap &trap);
 
         WaitableSet *joined_set() const
         {
+            std::lock_guard lock(mu_);
             return wset_;
         }
 
         void drop(const HostTrap &trap);
 
+        //  Runs waker on the next event; wakers whose park already ended are
+        //  pruned here, so a waiter that re-registers does not accumulate them.
+        void add_waker(ThreadWaker waker)
+        {
+            std::lock_guard lock(mu_);
+            std::erase_if(wakers_, [](const ThreadWaker &w)
+                          { return w.expired(); });
+            wakers_.push_back(std::move(waker));
+        }
+
+    protected:
+        explicit Waitable(EntryKind kind) : TableEntry(kind) {}
+
     private:
+        friend class WaitableSet;
+
+        //  Events may be set from another OS thread (a stream end completed by
+        //  its peer), so the event and set membership are guarded by mu_.
+        //  Lock order: mu_, then the set's ready mutex.  While mu_ is held, a
+        //  member of a set is on its ready list exactly when an event is pending.
+        mutable std::mutex mu_;
         std::optional<Event> pending_event_;
         ReclaimBuffer pending_reclaim_;
         WaitableSet *wset_ = nullptr;
+        std::vector<ThreadWaker> wakers_;
+        //  Links in wset_'s ready list, guarded by the set's ready mutex.
+        Waitable *ready_prev_ = nullptr;
+        Waitable *ready_next_ = nullptr;
+        bool ready_ = false;
     };
 
-    class WaitableSet : public TableEntry
+    class WaitableSet final : public TableEntry
     {
     public:
+        static constexpr EntryKind KIND = EntryKind::WaitableSet;
+
+        WaitableSet() : TableEntry(KIND) {}
+
+        //  Membership lives in Waitable::join; the set only counts members and
+        //  keeps the ones with a pending event on an intrusive FIFO, so events
+        //  are delivered in the order they fired and no member starves.  The
+        //  caller holds the waitable's lock.
         void add_waitable(Waitable &waitable)
         {
-            if (std::find(waitables_.begin(), waitables_.end(), &waitable) == waitables_.end())
+            std::lock_guard lock(ready_mutex_);
+            members_ += 1;
+            if (waitable.pending_event_)
             {
-                waitables_.push_back(&waitable);
+                link_locked(waitable);
             }
         }
 
         void remove_waitable(Waitable &waitable)
         {
-            auto it = std::find(waitables_.begin(), waitables_.end(), &waitable);
-            if (it != waitables_.end())
-            {
-                waitables_.erase(it);
-            }
+            std::lock_guard lock(ready_mutex_);
+            members_ -= 1;
+            unlink_locked(waitable);
+        }
+
+        std::size_t size() const
+        {
+            std::lock_guard lock(ready_mutex_);
+            return members_;
         }
 
         bool has_pending_event() const
         {
-            return std::any_of(waitables_.begin(), waitables_.end(), [](const Waitable *w)
-                               { return w && w->has_pending_event(); });
+            std::lock_guard lock(ready_mutex_);
+            return ready_head_ != nullptr;
         }
 
-        Event take_pending_event(const HostTrap &trap)
+        Event take_pending_event(const HostTrap &trap);
+
+        //  Both take the ready mutex; the caller holds the waitable's lock.
+        void mark_ready(Waitable &waitable)
         {
-            auto trap_cx = make_trap_context(trap);
-            trap_if(trap_cx, waitables_.empty(), "waitable set empty");
-            for (auto *w : waitables_)
-            {
-                if (w != nullptr && w->has_pending_event())
-                {
-                    return w->get_pending_event(trap);
-                }
-            }
-            trap_if(trap_cx, true, "waitable set missing event");
-            return {};
+            std::lock_guard lock(ready_mutex_);
+            link_locked(waitable);
+        }
+
+        void mark_unready(Waitable &waitable)
+        {
+            std::lock_guard lock(ready_mutex_);
+            unlink_locked(waitable);
         }
 
         void drop(const HostTrap &trap)
         {
             auto trap_cx = make_trap_context(trap);
-            trap_if(trap_cx, !waitables_.empty(), "waitable set not empty");
+            trap_if(trap_cx, size() != 0, "waitable set not empty");
             trap_if(trap_cx, num_waiting_ != 0, "waitable set has waiters");
         }
 
@@ -339,32 +414,166 @@ namespace cmcpp
             return num_waiting_;
         }
 
+        //  Wakers of parked threads waiting on this set; all of them run (once)
+        //  when any member receives an event.  Wakers whose park already ended
+        //  (timed out, cancelled) are pruned here, so a quiet set holds at most
+        //  one per parked thread.
+        void add_waker(ThreadWaker waker)
+        {
+            std::lock_guard lock(wakers_mutex_);
+            std::erase_if(wakers_, [](const ThreadWaker &w)
+                          { return w.expired(); });
+            wakers_.push_back(std::move(waker));
+        }
+
+        std::size_t waker_count() const
+        {
+            std::lock_guard lock(wakers_mutex_);
+            return wakers_.size();
+        }
+
+        void notify()
+        {
+            std::vector<ThreadWaker> wakers;
+            {
+                std::lock_guard lock(wakers_mutex_);
+                wakers.swap(wakers_);
+            }
+            for (auto &waker : wakers)
+            {
+                waker();
+            }
+        }
+
     private:
-        std::vector<Waitable *> waitables_;
+        void link_locked(Waitable &waitable)
+        {
+            if (waitable.ready_)
+            {
+                return;
+            }
+            waitable.ready_ = true;
+            waitable.ready_prev_ = ready_tail_;
+            waitable.ready_next_ = nullptr;
+            (ready_tail_ ? ready_tail_->ready_next_ : ready_head_) = &waitable;
+            ready_tail_ = &waitable;
+        }
+
+        void unlink_locked(Waitable &waitable)
+        {
+            if (!waitable.ready_)
+            {
+                return;
+            }
+            (waitable.ready_prev_ ? waitable.ready_prev_->ready_next_ : ready_head_) = waitable.ready_next_;
+            (waitable.ready_next_ ? waitable.ready_next_->ready_prev_ : ready_tail_) = waitable.ready_prev_;
+            waitable.ready_ = false;
+            waitable.ready_prev_ = nullptr;
+            waitable.ready_next_ = nullptr;
+        }
+
+        std::size_t members_ = 0;
+        //  set_pending_event may run on another OS thread (host stream ends).
+        mutable std::mutex ready_mutex_;
+        Waitable *ready_head_ = nullptr;
+        Waitable *ready_tail_ = nullptr;
         uint32_t num_waiting_ = 0;
+        mutable std::mutex wakers_mutex_;
+        std::vector<ThreadWaker> wakers_;
     };
 
-    inline void Waitable::join(WaitableSet *set, const HostTrap &)
+    inline void Waitable::set_pending_event(const Event &event, ReclaimBuffer reclaim)
     {
-        if (wset_ == set)
+        WaitableSet *set;
+        std::vector<ThreadWaker> wakers;
         {
-            return;
+            std::lock_guard lock(mu_);
+            pending_event_ = event;
+            pending_reclaim_ = std::move(reclaim);
+            wakers.swap(wakers_);
+            set = wset_;
+            if (set)
+            {
+                set->mark_ready(*this);
+            }
         }
-        if (wset_)
+        for (auto &waker : wakers)
         {
-            wset_->remove_waitable(*this);
+            waker();
+        }
+        if (set)
+        {
+            set->notify();
+        }
+    }
+
+    inline Event Waitable::get_pending_event(const HostTrap &trap)
+    {
+        ReclaimBuffer reclaim;
+        Event event;
+        {
+            std::lock_guard lock(mu_);
+            auto trap_cx = make_trap_context(trap);
+            trap_if(trap_cx, !pending_event_.has_value(), "waitable pending event missing");
+            reclaim = std::move(pending_reclaim_);
+            event = *pending_event_;
+            pending_event_.reset();
+            pending_reclaim_ = {};
+            if (wset_)
+            {
+                wset_->mark_unready(*this);
+            }
         }
-        wset_ = set;
+        if (reclaim)
+        {
+            reclaim();
+        }
+        return event;
+    }
+
+    inline void Waitable::clear_pending_event()
+    {
+        std::lock_guard lock(mu_);
+        pending_event_.reset();
+        pending_reclaim_ = {};
         if (wset_)
         {
+            wset_->mark_unready(*this);
+        }
+    }
+
+    inline void Waitable::join(WaitableSet *set, const HostTrap &)
+    {
+        bool notify;
+        {
+            std::lock_guard lock(mu_);
+            if (wset_ == set)
+            {
+                return;
+            }
+            if (wset_)
+            {
+                wset_->remove_waitable(*this);
+            }
+            wset_ = set;
+            if (!wset_)
+            {
+                return;
+            }
             wset_->add_waitable(*this);
+            notify = pending_event_.has_value();
+        }
+        if (notify)
+        {
+            set->notify();
         }
     }
 
     inline void Waitable::drop(const HostTrap &trap)
     {
+        std::lock_guard lock(mu_);
         auto trap_cx = make_trap_context(trap);
-        trap_if(trap_cx, has_pending_event(), "waitable drop with pending event");
+        trap_if(trap_cx, pending_event_.has_value(), "waitable drop with pending event");
         if (wset_)
         {
             wset_->remove_waitable(*this);
@@ -372,69 +581,248 @@ namespace cmcpp
         }
     }
 
+    //  The head of the ready list is read under the set's lock and the event
+    //  taken under the waitable's, per the lock order.  A head whose event was
+    //  cleared, or which moved to another set, in between is no longer this
+    //  set's head by the time its lock is held, so the loop moves on.
+    inline Event WaitableSet::take_pending_event(const HostTrap &trap)
+    {
+        auto trap_cx = make_trap_context(trap);
+        trap_if(trap_cx, size() == 0, "waitable set empty");
+        for (;;)
+        {
+            Waitable *w;
+            {
+                std::lock_guard lock(ready_mutex_);
+                w = ready_head_;
+            }
+            trap_if(trap_cx, w == nullptr, "waitable set missing event");
+            ReclaimBuffer reclaim;
+            Event event;
+            {
+                std::lock_guard lock(w->mu_);
+                if (w->wset_ != this || !w->pending_event_)
+                {
+                    continue;
+                }
+                reclaim = std::move(w->pending_reclaim_);
+                event = *w->pending_event_;
+                w->pending_event_.reset();
+                w->pending_reclaim_ = {};
+                mark_unready(*w);
+            }
+            if (reclaim)
+            {
+                reclaim();
+            }
+            return event;
+        }
+    }
+
+    //  Identifies one occupancy of a table slot; a removed and reused index gets a
+    //  new generation, so stale keys are detected instead of aliasing.
+    struct TableKey
+    {
+        uint32_t index = 0;
+        uint32_t generation = 0;
+    };
+
+    //  Handle table with the canonical free-list semantics: index 0 is reserved
+    //  and freed indices are reused most recent first.  Each slot carries the
+    //  entry's kind tag and a generation counter.
     class InstanceTable
     {
     public:
+        static constexpr uint32_t MAX_LENGTH = 1u << 30;
+
         uint32_t add(const std::shared_ptr<TableEntry> &entry, const HostTrap &trap)
         {
-            auto trap_cx = make_trap_context(trap);
-            trap_if(trap_cx, !entry, "null table entry");
+            if (!entry)
+            {
+                fail(trap, "null table entry");
+            }
             uint32_t index;
             if (!free_.empty())
             {
                 index = free_.back();
                 free_.pop_back();
-                entries_[index] = entry;
+                slots_[index].entry = entry;
             }
             else
             {
-                trap_if(trap_cx, entries_.size() >= (1u << 30), "instance table overflow");
-                entries_.push_back(entry);
-                index = static_cast<uint32_t>(entries_.size() - 1);
+                if (slots_.size() >= MAX_LENGTH)
+                {
+                    fail(trap, "instance table overflow");
+                }
+                slots_.push_back({entry, 0});
+                index = static_cast<uint32_t>(slots_.size() - 1);
             }
+            slots_[index].live_pos = static_cast<uint32_t>(live_.size());
+            live_.push_back(index);
             return index;
         }
 
         std::shared_ptr<TableEntry> get_entry(uint32_t index, const HostTrap &trap) const
         {
-            auto trap_cx = make_trap_context(trap);
-            trap_if(trap_cx, index == 0 || index >= entries_.size(), "table index out of bounds");
-            auto entry = entries_[index];
-            trap_if(trap_cx, !entry, "table slot empty");
-            return entry;
+            return slot(index, trap).entry;
         }
 
         std::shared_ptr<TableEntry> remove_entry(uint32_t index, const HostTrap &trap)
         {
-            auto entry = get_entry(index, trap);
-            entries_[index].reset();
+            auto &s = slot(index, trap);
+            auto entry = std::move(s.entry);
+            s.generation += 1;
+            uint32_t moved = live_.back();
+            live_[s.live_pos] = moved;
+            slots_[moved].live_pos = s.live_pos;
+            live_.pop_back();
             free_.push_back(index);
             return entry;
         }
 
+        //  Releases every live entry in O(live entries).  Slots keep their
+        //  capacity and move to the free list under a new generation.  The
+        //  entries are destroyed after the table is consistent again, so their
+        //  destructors may use it.
+        void clear()
+        {
+            std::vector<std::shared_ptr<TableEntry>> released;
+            released.reserve(live_.size());
+            for (uint32_t index : live_)
+            {
+                auto &s = slots_[index];
+                released.push_back(std::move(s.entry));
+                s.generation += 1;
+                free_.push_back(index);
+            }
+            live_.clear();
+        }
+
+        std::size_t size() const
+        {
+            return live_.size();
+        }
+
+        //  Borrowed access for the hot path: no reference count traffic and no
+        //  RTTI.  The pointer is valid until the entry is removed.
+        template <typename T>
+        T *borrow(uint32_t index, const HostTrap &trap) const
+        {
+            auto *entry = slot(index, trap).entry.get();
+            if (!matches<T>(*entry))
+            {
+                fail(trap, "table entry type mismatch");
+            }
+            return static_cast<T *>(entry);
+        }
+
         template <typename T>
         std::shared_ptr<T> get(uint32_t index, const HostTrap &trap) const
         {
-            auto base = get_entry(index, trap);
-            auto derived = std::dynamic_pointer_cast<T>(base);
-            auto trap_cx = make_trap_context(trap);
-            trap_if(trap_cx, !derived, "table entry type mismatch");
-            return derived;
+            const auto &entry = slot(index, trap).entry;
+            if (!matches<T>(*entry))
+            {
+                fail(trap, "table entry type mismatch");
+            }
+            return std::static_pointer_cast<T>(entry);
         }
 
         template <typename T>
         std::shared_ptr<T> remove(uint32_t index, const HostTrap &trap)
         {
-            auto base = remove_entry(index, trap);
-            auto derived = std::dynamic_pointer_cast<T>(base);
-            auto trap_cx = make_trap_context(trap);
-            trap_if(trap_cx, !derived, "table entry type mismatch");
-            return derived;
+            if (!matches<T>(*slot(index, trap).entry))
+            {
+                fail(trap, "table entry type mismatch");
+            }
+            return std::static_pointer_cast<T>(remove_entry(index, trap));
+        }
+
+        TableKey key(uint32_t index, const HostTrap &trap) const
+        {
+            return {index, slot(index, trap).generation};
+        }
+
+        template <typename T>
+        std::shared_ptr<T> get(TableKey key, const HostTrap &trap) const
+        {
+            check_generation(key, trap);
+            return get<T>(key.index, trap);
+        }
+
+        template <typename T>
+        T *borrow(TableKey key, const HostTrap &trap) const
+        {
+            check_generation(key, trap);
+            return borrow<T>(key.index, trap);
+        }
+
+        template <typename T>
+        static bool matches(const TableEntry &entry)
+        {
+            if constexpr (std::is_same_v<T, TableEntry>)
+            {
+                return true;
+            }
+            else if constexpr (std::is_same_v<T, Waitable>)
+            {
+                return entry.kind >= EntryKind::Waitable;
+            }
+            else if constexpr (std::is_final_v<T> && requires { T::KIND; })
+            {
+                return entry.kind == T::KIND;
+            }
+            else
+            {
+                return dynamic_cast<const T *>(&entry) != nullptr;
+            }
         }
 
     private:
-        std::vector<std::shared_ptr<TableEntry>> entries_{nullptr};
+        struct Slot
+        {
+            std::shared_ptr<TableEntry> entry;
+            uint32_t generation = 0;
+            //  Position of this slot's index in live_.
+            uint32_t live_pos = 0;
+        };
+
+        [[noreturn]] static void fail(const HostTrap &trap, const char *message)
+        {
+            auto trap_cx = make_trap_context(trap);
+            trap_if(trap_cx, true, message);
+            throw std::logic_error(message);
+        }
+
+        const Slot &slot(uint32_t index, const HostTrap &trap) const
+        {
+            if (index == 0 || index >= slots_.size())
+            {
+                fail(trap, "table index out of bounds");
+            }
+            const auto &s = slots_[index];
+            if (!s.entry)
+            {
+                fail(trap, "table slot empty");
+            }
+            return s;
+        }
+
+        Slot &slot(uint32_t index, const HostTrap &trap)
+        {
+            return const_cast<Slot &>(std::as_const(*this).slot(index, trap));
+        }
+
+        void check_generation(TableKey key, const HostTrap &trap) const
+        {
+            if (key.index < slots_.size() && slots_[key.index].generation != key.generation)
+            {
+                fail(trap, "stale table handle");
+            }
+        }
+
+        std::vector<Slot> slots_{Slot{}};
         std::vector<uint32_t> free_;
+        std::vector<uint32_t> live_;
     };
 
     struct StreamDescriptor
@@ -528,8 +916,12 @@ namespace cmcpp
         trap_if(trap_cx, expected.type != actual.type, "future descriptor type mismatch");
     }
 
-    using OnCopy = std::function<void(ReclaimBuffer)>;
-    using OnCopyDone = std::function<void(CopyResult)>;
+    //  Sized to hold the stream/future end completion closures without allocating.
+    using OnCopy = InlineFunction<void(ReclaimBuffer), 48>;
+    using OnCopyDone = InlineFunction<void(CopyResult), 48>;
+
+    //  Pool for guest copy buffers of the instance cx belongs to (null without one).
+    const std::shared_ptr<SlabPool> &buffer_pool(const LiftLowerContext &cx);
 
     class BufferGuestImpl
     {
@@ -565,6 +957,37 @@ namespace cmcpp
             return progress_;
         }
 
+        uint32_t elem_size() const
+        {
+            return elem_size_;
+        }
+
+        //  Guest memory not yet copied; valid until the guest memory grows.
+        std::span<uint8_t> remaining_bytes() const
+        {
+            auto &memory = cx_->opts.memory;
+            std::size_t offset = ptr_ + static_cast<std::size_t>(progress_) * elem_size_;
+            std::size_t bytes = static_cast<std::size_t>(remain()) * elem_size_;
+            return offset + bytes <= memory.size() ? memory.subspan(offset, bytes) : std::span<uint8_t>{};
+        }
+
+        //  Guest address of the next element to copy.
+        uint32_t position() const
+        {
+            return ptr_ + progress_ * elem_size_;
+        }
+
+        LiftLowerContext &cx() const
+        {
+            return *cx_;
+        }
+
+        //  Records n elements as copied through remaining_bytes().
+        void advance(uint32_t n)
+        {
+            progress_ += std::min(n, remain());
+        }
+
     protected:
         uint32_t elem_size_ = 0;
         uint32_t alignment_ = 1;
@@ -574,11 +997,17 @@ namespace cmcpp
         uint32_t progress_ = 0;
     };
 
+    class WritableBufferGuestImpl;
+
     class ReadableBufferGuestImpl : public BufferGuestImpl
     {
     public:
         using BufferGuestImpl::BufferGuestImpl;
 
+        //  Moves n elements straight from this buffer's memory into dst's with
+        //  one memmove; no staging copy and no allocation.
+        void copy_to(WritableBufferGuestImpl &dst, uint32_t n, const HostTrap &trap);
+
         std::vector<uint8_t> read(uint32_t n, const HostTrap &trap)
         {
             auto trap_cx = make_trap_context(trap);
@@ -615,6 +1044,66 @@ namespace cmcpp
             }
             progress_ += n;
         }
+
+    private:
+        friend class ReadableBufferGuestImpl;
+    };
+
+    inline void ReadableBufferGuestImpl::copy_to(WritableBufferGuestImpl &dst, uint32_t n, const HostTrap &trap)
+    {
+        uint64_t bytes = static_cast<uint64_t>(n) * elem_size_;
+        uint64_t read_ptr = ptr_ + static_cast<uint64_t>(progress_) * elem_size_;
+        uint64_t write_ptr = dst.ptr_ + static_cast<uint64_t>(dst.progress_) * dst.elem_size_;
+        auto &src_memory = cx_->opts.memory;
+        auto &dst_memory = dst.cx_->opts.memory;
+        //  Both ranges were validated when the buffers were created; only the
+        //  chunk bounds are rechecked here.
+        if (n > remain() || n > dst.remain() || elem_size_ != dst.elem_size_ ||
+            read_ptr + bytes > src_memory.size() || write_ptr + bytes > dst_memory.size())
+        {
+            auto trap_cx = make_trap_context(trap);
+            trap_if(trap_cx, elem_size_ != dst.elem_size_, "buffer element size mismatch");
+            trap_if(trap_cx, n > remain(), "buffer read past end");
+            trap_if(trap_cx, n > dst.remain(), "buffer write past end");
+            trap_if(trap_cx, true, "memory overflow");
+        }
+        if (bytes > 0)
+        {
+            std::memmove(dst_memory.data() + write_ptr, src_memory.data() + read_ptr, bytes);
+        }
+        progress_ += n;
+        dst.progress_ += n;
+    }
+
+    //  Host-side end of a stream, standing in for the guest on the other side
+    //  (implementations in host_stream.hpp).  SharedStreamState calls these with
+    //  its mutex held.
+    class HostStreamEndpoint
+    {
+    public:
+        virtual ~HostStreamEndpoint() = default;
+
+        //  Moves elements between the host end and guest; returns the count moved.
+        virtual uint32_t transfer(BufferGuestImpl &guest) = 0;
+        //  No element will move again; a waiting guest copy completes as Dropped.
+        virtual bool finished() const = 0;
+        //  A guest copy is pending until the host's next batch.
+        virtual void set_waiting(bool waiting) = 0;
+        virtual void peer_dropped() = 0;
+        //  Called after a transfer once the mutex has been released, for work
+        //  that may re-enter the host end (e.g. a ready callback that pushes).
+        virtual void flush() {}
+    };
+
+    //  Bounded internal buffering for a guest-to-guest stream, in elements.
+    //  Writers complete at once while the buffer has room; a parked reader is
+    //  woken once high_water elements are buffered (or the writer drops), and
+    //  a writer parked on a full buffer once it drains to low_water.
+    struct StreamBuffering
+    {
+        uint32_t capacity = 0;
+        uint32_t high_water = 1;
+        uint32_t low_water = 0;
     };
 
     struct SharedStreamState
@@ -623,6 +1112,17 @@ namespace cmcpp
 
         StreamDescriptor descriptor;
         bool dropped = false;
+        //  Set when the stream's other end belongs to the host.
+        std::shared_ptr<HostStreamEndpoint> host;
+        //  Host batches post their guest-side completion here; null runs it
+        //  on the host's thread.
+        Store *host_store = nullptr;
+
+        //  capacity 0 keeps the unbuffered rendezvous.
+        StreamBuffering buffering;
+        std::vector<uint8_t> buffered_bytes;
+        uint32_t buffered_head = 0;
+        uint32_t buffered = 0;
 
         std::shared_ptr<BufferGuestImpl> pending_buffer;
         OnCopy pending_on_copy;
@@ -636,11 +1136,36 @@ namespace cmcpp
             cv.notify_all();
         }
 
-        template <typename Pred>
-        void wait_until(Pred pred)
+        //  Blocks until end has a pending event.  Under a Suspender the runtime
+        //  Thread parks with a waker on end instead of being polled.
+        void wait_for(Waitable &end)
         {
+            CMCPP_SCHED_RECORD(record_suspend(SuspendReason::StreamWait);)
+            auto ready = [&end]()
+            { return end.has_pending_event(); };
+            if (auto *suspender = current_suspender())
+            {
+                suspender->park_until(ready, [&end](const ThreadWaker &waker)
+                                      { end.add_waker(waker); });
+                return;
+            }
+            //  A host batch only wakes a sync waiter, which pumps the ring itself.
             std::unique_lock<std::mutex> lock(mu);
-            cv.wait(lock, std::move(pred));
+            cv.wait(lock, [this, &ready]()
+                    {
+                        pump_host_locked();
+                        return ready(); });
+            lock.unlock();
+            flush_host();
+        }
+
+        //  Call without mu held.
+        void flush_host()
+        {
+            if (host)
+            {
+                host->flush();
+            }
         }
 
         void reset_pending()
@@ -657,33 +1182,158 @@ namespace cmcpp
             pending_on_copy_done = std::move(on_copy_done);
         }
 
-        void reset_and_notify_pending(CopyResult result)
+        void reset_and_notify_pending(CopyResult result)
+        {
+            auto on_copy_done = std::move(pending_on_copy_done);
+            reset_pending();
+            if (on_copy_done)
+            {
+                on_copy_done(result);
+            }
+        }
+
+        void cancel()
+        {
+            if (host)
+            {
+                host->set_waiting(false);
+            }
+            if (pending_buffer)
+            {
+                reset_and_notify_pending(CopyResult::Cancelled);
+            }
+        }
+
+        void drop()
+        {
+            if (dropped)
+            {
+                return;
+            }
+            dropped = true;
+            if (host)
+            {
+                host->peer_dropped();
+            }
+            //  A reader parked below the high-water mark still gets what the
+            //  dropped writer left behind.
+            if (buffered > 0 && pending_reader())
+            {
+                drain_buffer(*pending_buffer);
+                reset_and_notify_pending(CopyResult::Completed);
+            }
+            if (pending_buffer)
+            {
+                reset_and_notify_pending(CopyResult::Dropped);
+            }
+        }
+
+        void set_buffering(const StreamBuffering &config)
+        {
+            buffering = config;
+            buffered_bytes.assign(static_cast<std::size_t>(config.capacity) * descriptor.element_size, 0);
+            buffered_head = 0;
+            buffered = 0;
+        }
+
+        bool pending_reader() const
+        {
+            return dynamic_cast<WritableBufferGuestImpl *>(pending_buffer.get()) != nullptr;
+        }
+
+        //  Moves as much of src as fits into the buffer; returns the count.
+        uint32_t fill_buffer(BufferGuestImpl &src)
+        {
+            uint32_t n = std::min(src.remain(), buffering.capacity - buffered);
+            auto bytes = src.remaining_bytes();
+            std::size_t es = descriptor.element_size;
+            uint32_t tail = (buffered_head + buffered) % buffering.capacity;
+            uint32_t first = std::min(n, buffering.capacity - tail);
+            std::memcpy(&buffered_bytes[tail * es], bytes.data(), first * es);
+            std::memcpy(&buffered_bytes[0], bytes.data() + first * es, (n - first) * es);
+            buffered += n;
+            src.advance(n);
+            return n;
+        }
+
+        //  Moves as much of the buffer as fits into dst; returns the count.
+        uint32_t drain_buffer(BufferGuestImpl &dst)
+        {
+            uint32_t n = std::min(dst.remain(), buffered);
+            auto bytes = dst.remaining_bytes();
+            std::size_t es = descriptor.element_size;
+            uint32_t first = std::min(n, buffering.capacity - buffered_head);
+            std::memcpy(bytes.data(), &buffered_bytes[buffered_head * es], first * es);
+            std::memcpy(bytes.data() + first * es, &buffered_bytes[0], (n - first) * es);
+            buffered_head = (buffered_head + n) % buffering.capacity;
+            buffered -= n;
+            dst.advance(n);
+            return n;
+        }
+
+        void buffered_read(const std::shared_ptr<WritableBufferGuestImpl> &dst, OnCopy on_copy, OnCopyDone on_copy_done)
+        {
+            if (buffered > 0 || dst->is_zero_length())
+            {
+                drain_buffer(*dst);
+                //  Low-water crossing: refill from a writer parked on a full buffer.
+                if (buffered <= buffering.low_water && pending_buffer && !pending_reader())
+                {
+                    fill_buffer(*pending_buffer);
+                    reset_and_notify_pending(CopyResult::Completed);
+                }
+                on_copy_done(CopyResult::Completed);
+                return;
+            }
+            if (dropped)
+            {
+                on_copy_done(CopyResult::Dropped);
+                return;
+            }
+            set_pending(dst, std::move(on_copy), std::move(on_copy_done));
+        }
+
+        void buffered_write(const std::shared_ptr<ReadableBufferGuestImpl> &src, OnCopy on_copy, OnCopyDone on_copy_done)
         {
-            auto on_copy_done = std::move(pending_on_copy_done);
-            reset_pending();
-            if (on_copy_done)
+            if (buffered == buffering.capacity && !src->is_zero_length())
             {
-                on_copy_done(result);
+                set_pending(src, std::move(on_copy), std::move(on_copy_done));
+                return;
             }
+            fill_buffer(*src);
+            //  High-water crossing: hand the buffer to a parked reader.
+            if (buffered >= buffering.high_water && pending_reader())
+            {
+                drain_buffer(*pending_buffer);
+                reset_and_notify_pending(CopyResult::Completed);
+            }
+            on_copy_done(CopyResult::Completed);
         }
 
-        void cancel()
+        //  Copies against the host end at once when it can; otherwise parks the
+        //  guest buffer until the host's next batch calls pump_host_locked().
+        void serve_host(const std::shared_ptr<BufferGuestImpl> &guest, OnCopy on_copy, OnCopyDone on_copy_done)
         {
-            if (pending_buffer)
-            {
-                reset_and_notify_pending(CopyResult::Cancelled);
-            }
+            set_pending(guest, std::move(on_copy), std::move(on_copy_done));
+            host->set_waiting(true);
+            pump_host_locked();
         }
 
-        void drop()
+        void pump_host_locked()
         {
-            if (dropped)
+            if (!host || !pending_buffer)
             {
                 return;
             }
-            dropped = true;
-            if (pending_buffer)
+            uint32_t moved = host->transfer(*pending_buffer);
+            if (moved > 0 || pending_buffer->is_zero_length())
             {
+                host->set_waiting(false);
+                reset_and_notify_pending(CopyResult::Completed);
+            }
+            else if (host->finished())
+            {
+                host->set_waiting(false);
                 reset_and_notify_pending(CopyResult::Dropped);
             }
         }
@@ -691,11 +1341,21 @@ namespace cmcpp
         void read(const std::shared_ptr<WritableBufferGuestImpl> &dst, OnCopy on_copy, OnCopyDone on_copy_done, const HostTrap &trap)
         {
             std::scoped_lock<std::mutex> lock(mu);
+            if (buffering.capacity > 0)
+            {
+                buffered_read(dst, std::move(on_copy), std::move(on_copy_done));
+                return;
+            }
             if (dropped)
             {
                 on_copy_done(CopyResult::Dropped);
                 return;
             }
+            if (host)
+            {
+                serve_host(dst, std::move(on_copy), std::move(on_copy_done));
+                return;
+            }
             if (!pending_buffer)
             {
                 set_pending(dst, std::move(on_copy), std::move(on_copy_done));
@@ -711,7 +1371,7 @@ namespace cmcpp
                 if (dst->remain() > 0)
                 {
                     uint32_t n = std::min<uint32_t>(dst->remain(), src->remain());
-                    dst->write(src->read(n, trap), trap);
+                    src->copy_to(*dst, n, trap);
                     if (pending_on_copy)
                     {
                         pending_on_copy([this]()
@@ -736,6 +1396,16 @@ namespace cmcpp
                 on_copy_done(CopyResult::Dropped);
                 return;
             }
+            if (buffering.capacity > 0)
+            {
+                buffered_write(src, std::move(on_copy), std::move(on_copy_done));
+                return;
+            }
+            if (host)
+            {
+                serve_host(src, std::move(on_copy), std::move(on_copy_done));
+                return;
+            }
             if (!pending_buffer)
             {
                 set_pending(src, std::move(on_copy), std::move(on_copy_done));
@@ -751,7 +1421,7 @@ namespace cmcpp
                 if (src->remain() > 0)
                 {
                     uint32_t n = std::min<uint32_t>(src->remain(), dst->remain());
-                    dst->write(src->read(n, trap), trap);
+                    src->copy_to(*dst, n, trap);
                     if (pending_on_copy)
                     {
                         pending_on_copy(
@@ -800,13 +1470,17 @@ namespace cmcpp
         }
 
     protected:
+        explicit CopyEnd(EntryKind kind) : Waitable(kind) {}
+
         CopyState state_ = CopyState::IDLE;
     };
 
     class ReadableStreamEnd final : public CopyEnd
     {
     public:
-        explicit ReadableStreamEnd(std::shared_ptr<SharedStreamState> shared) : shared_(std::move(shared)) {}
+        static constexpr EntryKind KIND = EntryKind::ReadableStream;
+
+        explicit ReadableStreamEnd(std::shared_ptr<SharedStreamState> shared) : CopyEnd(KIND), shared_(std::move(shared)) {}
 
         const StreamDescriptor &descriptor() const
         {
@@ -819,17 +1493,12 @@ namespace cmcpp
             trap_if(trap_cx, !shared_, "stream state missing");
             trap_if(trap_cx, state_ != CopyState::IDLE, "stream read not idle");
 
-            auto buffer = std::make_shared<WritableBufferGuestImpl>(shared_->descriptor.element_size, shared_->descriptor.alignment, cx, ptr, n, trap);
+            auto buffer = make_pooled<WritableBufferGuestImpl>(buffer_pool(*cx), shared_->descriptor.element_size, shared_->descriptor.alignment, cx, ptr, n, trap);
 
-            auto make_payload = [buffer](CopyResult result) -> uint32_t
-            {
-                return pack_copy_result(result, buffer->progress());
-            };
-
-            OnCopy on_copy = [this, handle_index, cx, make_payload](ReclaimBuffer reclaim)
+            OnCopy on_copy = [this, handle_index, cx, buffer](ReclaimBuffer reclaim)
             {
                 bool notify = (state_ == CopyState::ASYNC_COPYING || state_ == CopyState::CANCELLING_COPY);
-                uint32_t payload = make_payload(CopyResult::Completed);
+                uint32_t payload = pack_copy_result(CopyResult::Completed, buffer->progress());
                 set_pending_event({EventCode::STREAM_READ, handle_index, payload}, std::move(reclaim));
                 state_ = CopyState::IDLE;
                 if (shared_)
@@ -842,10 +1511,10 @@ namespace cmcpp
                 }
             };
 
-            OnCopyDone on_copy_done = [this, handle_index, cx, make_payload](CopyResult result)
+            OnCopyDone on_copy_done = [this, handle_index, cx, buffer](CopyResult result)
             {
                 bool notify = (state_ == CopyState::ASYNC_COPYING || state_ == CopyState::CANCELLING_COPY);
-                uint32_t payload = make_payload(result);
+                uint32_t payload = pack_copy_result(result, buffer->progress());
                 set_pending_event({EventCode::STREAM_READ, handle_index, payload});
                 state_ = (result == CopyResult::Dropped) ? CopyState::DONE : CopyState::IDLE;
                 if (shared_)
@@ -859,20 +1528,26 @@ namespace cmcpp
             };
 
             shared_->read(buffer, std::move(on_copy), std::move(on_copy_done), trap);
+            shared_->flush_host();
 
-            if (!has_pending_event())
+            //  A host end may complete the copy from another thread, so the
+            //  blocked state is published under the lock its callbacks run under.
+            bool blocked;
             {
-                if (sync)
+                std::scoped_lock<std::mutex> lock(shared_->mu);
+                blocked = !has_pending_event();
+                if (blocked)
                 {
-                    state_ = CopyState::SYNC_COPYING;
-                    shared_->wait_until([this]()
-                                        { return has_pending_event(); });
+                    state_ = sync ? CopyState::SYNC_COPYING : CopyState::ASYNC_COPYING;
                 }
-                else
+            }
+            if (blocked)
+            {
+                if (!sync)
                 {
-                    state_ = CopyState::ASYNC_COPYING;
                     return BLOCKED;
                 }
+                shared_->wait_for(*this);
             }
             auto event = get_pending_event(trap);
             return event.payload;
@@ -881,20 +1556,23 @@ namespace cmcpp
         uint32_t cancel(bool sync, const HostTrap &trap)
         {
             auto trap_cx = make_trap_context(trap);
-            trap_if(trap_cx, state_ != CopyState::ASYNC_COPYING, "stream cancel requires async copy");
-            state_ = CopyState::CANCELLING_COPY;
-
-            if (!has_pending_event() && shared_)
+            trap_if(trap_cx, !shared_, "stream state missing");
             {
-                shared_->cancel();
+                //  A host batch may be completing the copy under the same lock.
+                std::scoped_lock<std::mutex> lock(shared_->mu);
+                trap_if(trap_cx, state_ != CopyState::ASYNC_COPYING, "stream cancel requires async copy");
+                state_ = CopyState::CANCELLING_COPY;
+                if (!has_pending_event())
+                {
+                    shared_->cancel();
+                }
             }
 
             if (!has_pending_event())
             {
                 if (sync)
                 {
-                    shared_->wait_until([this]()
-                                        { return has_pending_event(); });
+                    shared_->wait_for(*this);
                 }
                 else
                 {
@@ -914,6 +1592,12 @@ namespace cmcpp
         void drop(const HostTrap &trap)
         {
             auto trap_cx = make_trap_context(trap);
+            //  A host batch may be completing a copy under the stream lock.
+            std::unique_lock<std::mutex> lock;
+            if (shared_)
+            {
+                lock = std::unique_lock<std::mutex>(shared_->mu);
+            }
             trap_if(trap_cx, copying(), "cannot drop stream end while copying");
             if (shared_)
             {
@@ -930,7 +1614,9 @@ namespace cmcpp
     class WritableStreamEnd final : public CopyEnd
     {
     public:
-        explicit WritableStreamEnd(std::shared_ptr<SharedStreamState> shared) : shared_(std::move(shared)) {}
+        static constexpr EntryKind KIND = EntryKind::WritableStream;
+
+        explicit WritableStreamEnd(std::shared_ptr<SharedStreamState> shared) : CopyEnd(KIND), shared_(std::move(shared)) {}
 
         const StreamDescriptor &descriptor() const
         {
@@ -943,16 +1629,11 @@ namespace cmcpp
             trap_if(trap_cx, !shared_, "stream state missing");
             trap_if(trap_cx, state_ != CopyState::IDLE, "stream write not idle");
 
-            auto buffer = std::make_shared<ReadableBufferGuestImpl>(shared_->descriptor.element_size, shared_->descriptor.alignment, cx, ptr, n, trap);
-            auto make_payload = [buffer](CopyResult result) -> uint32_t
-            {
-                return pack_copy_result(result, buffer->progress());
-            };
-
-            OnCopy on_copy = [this, handle_index, cx, make_payload](ReclaimBuffer reclaim)
+            auto buffer = make_pooled<ReadableBufferGuestImpl>(buffer_pool(*cx), shared_->descriptor.element_size, shared_->descriptor.alignment, cx, ptr, n, trap);
+            OnCopy on_copy = [this, handle_index, cx, buffer](ReclaimBuffer reclaim)
             {
                 bool notify = (state_ == CopyState::ASYNC_COPYING || state_ == CopyState::CANCELLING_COPY);
-                uint32_t payload = make_payload(CopyResult::Completed);
+                uint32_t payload = pack_copy_result(CopyResult::Completed, buffer->progress());
                 set_pending_event({EventCode::STREAM_WRITE, handle_index, payload}, std::move(reclaim));
                 state_ = CopyState::IDLE;
                 if (shared_)
@@ -965,10 +1646,10 @@ namespace cmcpp
                 }
             };
 
-            OnCopyDone on_copy_done = [this, handle_index, cx, make_payload](CopyResult result)
+            OnCopyDone on_copy_done = [this, handle_index, cx, buffer](CopyResult result)
             {
                 bool notify = (state_ == CopyState::ASYNC_COPYING || state_ == CopyState::CANCELLING_COPY);
-                uint32_t payload = make_payload(result);
+                uint32_t payload = pack_copy_result(result, buffer->progress());
                 set_pending_event({EventCode::STREAM_WRITE, handle_index, payload});
                 state_ = (result == CopyResult::Dropped) ? CopyState::DONE : CopyState::IDLE;
                 if (shared_)
@@ -982,20 +1663,26 @@ namespace cmcpp
             };
 
             shared_->write(buffer, std::move(on_copy), std::move(on_copy_done), trap);
+            shared_->flush_host();
 
-            if (!has_pending_event())
+            //  A host end may complete the copy from another thread, so the
+            //  blocked state is published under the lock its callbacks run under.
+            bool blocked;
             {
-                if (sync)
+                std::scoped_lock<std::mutex> lock(shared_->mu);
+                blocked = !has_pending_event();
+                if (blocked)
                 {
-                    state_ = CopyState::SYNC_COPYING;
-                    shared_->wait_until([this]()
-                                        { return has_pending_event(); });
+                    state_ = sync ? CopyState::SYNC_COPYING : CopyState::ASYNC_COPYING;
                 }
-                else
+            }
+            if (blocked)
+            {
+                if (!sync)
                 {
-                    state_ = CopyState::ASYNC_COPYING;
                     return BLOCKED;
                 }
+                shared_->wait_for(*this);
             }
             auto event = get_pending_event(trap);
             return event.payload;
@@ -1004,20 +1691,23 @@ namespace cmcpp
         uint32_t cancel(bool sync, const HostTrap &trap)
         {
             auto trap_cx = make_trap_context(trap);
-            trap_if(trap_cx, state_ != CopyState::ASYNC_COPYING, "stream cancel requires async copy");
-            state_ = CopyState::CANCELLING_COPY;
-
-            if (!has_pending_event() && shared_)
+            trap_if(trap_cx, !shared_, "stream state missing");
             {
-                shared_->cancel();
+                //  A host batch may be completing the copy under the same lock.
+                std::scoped_lock<std::mutex> lock(shared_->mu);
+                trap_if(trap_cx, state_ != CopyState::ASYNC_COPYING, "stream cancel requires async copy");
+                state_ = CopyState::CANCELLING_COPY;
+                if (!has_pending_event())
+                {
+                    shared_->cancel();
+                }
             }
 
             if (!has_pending_event())
             {
                 if (sync)
                 {
-                    shared_->wait_until([this]()
-                                        { return has_pending_event(); });
+                    shared_->wait_for(*this);
                 }
                 else
                 {
@@ -1037,6 +1727,12 @@ namespace cmcpp
         void drop(const HostTrap &trap)
         {
             auto trap_cx = make_trap_context(trap);
+            //  A host batch may be completing a copy under the stream lock.
+            std::unique_lock<std::mutex> lock;
+            if (shared_)
+            {
+                lock = std::unique_lock<std::mutex>(shared_->mu);
+            }
             trap_if(trap_cx, copying(), "cannot drop stream end while copying");
             if (shared_)
             {
@@ -1068,11 +1764,21 @@ namespace cmcpp
             cv.notify_all();
         }
 
-        template <typename Pred>
-        void wait_until(Pred pred)
+        //  Blocks until end has a pending event.  Under a Suspender the runtime
+        //  Thread parks with a waker on end instead of being polled.
+        void wait_for(Waitable &end)
         {
+            CMCPP_SCHED_RECORD(record_suspend(SuspendReason::FutureWait);)
+            auto ready = [&end]()
+            { return end.has_pending_event(); };
+            if (auto *suspender = current_suspender())
+            {
+                suspender->park_until(ready, [&end](const ThreadWaker &waker)
+                                      { end.add_waker(waker); });
+                return;
+            }
             std::unique_lock<std::mutex> lock(mu);
-            cv.wait(lock, std::move(pred));
+            cv.wait(lock, ready);
         }
 
         void reset_pending()
@@ -1138,7 +1844,7 @@ namespace cmcpp
 
             auto src = std::dynamic_pointer_cast<ReadableBufferGuestImpl>(pending_buffer);
             trap_if(trap_cx, !src, "future pending buffer type mismatch");
-            dst->write(src->read(1, trap), trap);
+            src->copy_to(*dst, 1, trap);
             reset_and_notify_pending(CopyResult::Completed);
             on_copy_done(CopyResult::Completed);
         }
@@ -1161,7 +1867,7 @@ namespace cmcpp
             auto dst = std::dynamic_pointer_cast<WritableBufferGuestImpl>(pending_buffer);
             auto trap_cx = make_trap_context(trap);
             trap_if(trap_cx, !dst, "future pending buffer type mismatch");
-            dst->write(src->read(1, trap), trap);
+            src->copy_to(*dst, 1, trap);
             reset_and_notify_pending(CopyResult::Completed);
             on_copy_done(CopyResult::Completed);
         }
@@ -1170,7 +1876,9 @@ namespace cmcpp
     class ReadableFutureEnd final : public CopyEnd
     {
     public:
-        explicit ReadableFutureEnd(std::shared_ptr<SharedFutureState> shared) : shared_(std::move(shared)) {}
+        static constexpr EntryKind KIND = EntryKind::ReadableFuture;
+
+        explicit ReadableFutureEnd(std::shared_ptr<SharedFutureState> shared) : CopyEnd(KIND), shared_(std::move(shared)) {}
 
         const FutureDescriptor &descriptor() const
         {
@@ -1183,7 +1891,7 @@ namespace cmcpp
             trap_if(trap_cx, !shared_, "future state missing");
             trap_if(trap_cx, state_ != CopyState::IDLE, "future read not idle");
 
-            auto buffer = std::make_shared<WritableBufferGuestImpl>(shared_->descriptor.element_size, shared_->descriptor.alignment, cx, ptr, 1, trap);
+            auto buffer = make_pooled<WritableBufferGuestImpl>(buffer_pool(*cx), shared_->descriptor.element_size, shared_->descriptor.alignment, cx, ptr, 1, trap);
             OnCopyDone on_copy_done = [this, handle_index, cx](CopyResult result)
             {
                 bool notify = (state_ == CopyState::ASYNC_COPYING || state_ == CopyState::CANCELLING_COPY);
@@ -1206,8 +1914,7 @@ namespace cmcpp
                 if (sync)
                 {
                     state_ = CopyState::SYNC_COPYING;
-                    shared_->wait_until([this]()
-                                        { return has_pending_event(); });
+                    shared_->wait_for(*this);
                 }
                 else
                 {
@@ -1232,8 +1939,7 @@ namespace cmcpp
             {
                 if (sync)
                 {
-                    shared_->wait_until([this]()
-                                        { return has_pending_event(); });
+                    shared_->wait_for(*this);
                 }
                 else
                 {
@@ -1267,7 +1973,9 @@ namespace cmcpp
     class WritableFutureEnd final : public CopyEnd
     {
     public:
-        explicit WritableFutureEnd(std::shared_ptr<SharedFutureState> shared) : shared_(std::move(shared)) {}
+        static constexpr EntryKind KIND = EntryKind::WritableFuture;
+
+        explicit WritableFutureEnd(std::shared_ptr<SharedFutureState> shared) : CopyEnd(KIND), shared_(std::move(shared)) {}
 
         const FutureDescriptor &descriptor() const
         {
@@ -1280,7 +1988,7 @@ namespace cmcpp
             trap_if(trap_cx, !shared_, "future state missing");
             trap_if(trap_cx, state_ != CopyState::IDLE, "future write not idle");
 
-            auto buffer = std::make_shared<ReadableBufferGuestImpl>(shared_->descriptor.element_size, shared_->descriptor.alignment, cx, ptr, 1, trap);
+            auto buffer = make_pooled<ReadableBufferGuestImpl>(buffer_pool(*cx), shared_->descriptor.element_size, shared_->descriptor.alignment, cx, ptr, 1, trap);
             OnCopyDone on_copy_done = [this, handle_index, cx](CopyResult result)
             {
                 bool notify = (state_ == CopyState::ASYNC_COPYING || state_ == CopyState::CANCELLING_COPY);
@@ -1304,8 +2012,7 @@ namespace cmcpp
                 if (sync)
                 {
                     state_ = CopyState::SYNC_COPYING;
-                    shared_->wait_until([this]()
-                                        { return has_pending_event(); });
+                    shared_->wait_for(*this);
                 }
                 else
                 {
@@ -1353,15 +2060,128 @@ namespace cmcpp
         std::shared_ptr<SharedFutureState> shared_;
     };
 
+    struct ResourceType;
+
+    //  Hands out dense resource type ids.  A destroyed type's id goes to the
+    //  next type created, lowest first, so per-instance handle tables stay as
+    //  small as the set of live types.  A generation tells a reused id apart,
+    //  and a live id maps back to its type.
+    class ResourceTypeRegistry
+    {
+    public:
+        static ResourceTypeRegistry &global()
+        {
+            static ResourceTypeRegistry registry;
+            return registry;
+        }
+
+        //  Returns {id, generation}.
+        std::pair<uint32_t, uint32_t> acquire(const ResourceType *type)
+        {
+            std::lock_guard lock(mu_);
+            uint32_t id;
+            if (!free_.empty())
+            {
+                std::pop_heap(free_.begin(), free_.end(), std::greater<>());
+                id = free_.back();
+                free_.pop_back();
+            }
+            else
+            {
+                id = static_cast<uint32_t>(slots_.size());
+                slots_.emplace_back();
+            }
+            slots_[id].type = type;
+            slots_[id].generation += 1;
+            return {id, slots_[id].generation};
+        }
+
+        void release(uint32_t id)
+        {
+            std::lock_guard lock(mu_);
+            slots_[id].type = nullptr;
+            free_.push_back(id);
+            std::push_heap(free_.begin(), free_.end(), std::greater<>());
+        }
+
+        //  The type holding id in this generation; null once it is destroyed.
+        const ResourceType *find(uint32_t id, uint32_t generation) const
+        {
+            std::lock_guard lock(mu_);
+            return id < slots_.size() && slots_[id].generation == generation ? slots_[id].type : nullptr;
+        }
+
+    private:
+        struct Slot
+        {
+            const ResourceType *type = nullptr;
+            uint32_t generation = 0;
+        };
+
+        mutable std::mutex mu_;
+        std::vector<Slot> slots_;
+        std::vector<uint32_t> free_;
+    };
+
     struct ResourceType
     {
         ComponentInstance *impl = nullptr;
         std::function<void(uint32_t)> dtor;
+        //  Optional; used by bulk teardown instead of one dtor call per rep.
+        std::function<void(std::span<const uint32_t>)> dtor_batch;
 
-        ResourceType() = default;
+        ResourceType() : ResourceType(nullptr, {}) {}
 
         explicit ResourceType(ComponentInstance &instance, std::function<void(uint32_t)> destructor = {})
-            : impl(&instance), dtor(std::move(destructor)) {}
+            : ResourceType(&instance, std::move(destructor)) {}
+
+        ~ResourceType()
+        {
+            ResourceTypeRegistry::global().release(id_);
+        }
+
+        //  Handle tables find their type through the registry, so it stays put.
+        ResourceType(const ResourceType &) = delete;
+        ResourceType &operator=(const ResourceType &) = delete;
+
+        uint32_t id() const
+        {
+            return id_;
+        }
+
+        uint32_t generation() const
+        {
+            return generation_;
+        }
+
+        void destroy(std::span<const uint32_t> reps) const
+        {
+            if (reps.empty())
+            {
+                return;
+            }
+            if (dtor_batch)
+            {
+                dtor_batch(reps);
+            }
+            else if (dtor)
+            {
+                for (uint32_t rep : reps)
+                {
+                    dtor(rep);
+                }
+            }
+        }
+
+    private:
+        ResourceType(ComponentInstance *instance, std::function<void(uint32_t)> destructor)
+            : impl(instance), dtor(std::move(destructor))
+        {
+            std::tie(id_, generation_) = ResourceTypeRegistry::global().acquire(this);
+        }
+
+        uint32_t id_;
+        uint32_t generation_;
     };
 
     struct HandleElement
@@ -1372,104 +2192,373 @@ namespace cmcpp
         uint32_t lend_count = 0;
     };
 
+    //  Handle storage in struct-of-arrays form.  A free slot's rep field holds the
+    //  next free index, so the free list needs no separate storage; index 0 is
+    //  reserved and doubles as the list terminator.  Freed indices are reused
+    //  most recent first, as in the canonical definitions.
     class HandleTable
     {
     public:
         static constexpr uint32_t MAX_LENGTH = 1u << 30;
 
-        HandleElement &get(uint32_t index, const HostTrap &trap)
+        explicit HandleTable(const ResourceType &type) : type_id_(type.id()), generation_(type.generation()) {}
+
+        //  The live type this table holds handles of, looked up when needed so
+        //  bulk teardown sees its current destructors; null once destroyed.
+        const ResourceType *type() const
         {
-            auto trap_cx = make_trap_context(trap);
-            trap_if(trap_cx, index >= entries_.size(), "resource index out of bounds");
-            auto &slot = entries_[index];
-            trap_if(trap_cx, !slot.has_value(), "resource slot empty");
-            return slot.value();
+            return ResourceTypeRegistry::global().find(type_id_, generation_);
         }
 
-        const HandleElement &get(uint32_t index, const HostTrap &trap) const
+        bool belongs_to(const ResourceType &type) const
         {
-            auto trap_cx = make_trap_context(trap);
-            trap_if(trap_cx, index >= entries_.size(), "resource index out of bounds");
-            const auto &slot = entries_[index];
-            trap_if(trap_cx, !slot.has_value(), "resource slot empty");
-            return slot.value();
+            return generation_ == type.generation();
+        }
+
+        //  Hands the table to the type that reused its id; handles left by
+        //  the destroyed type are discarded without destructors.
+        void rebind(const ResourceType &type)
+        {
+            reps_.resize(1);
+            scopes_.resize(1);
+            lend_counts_.resize(1);
+            flags_.resize(1);
+            free_head_ = 0;
+            free_count_ = 0;
+            generation_ = type.generation();
+        }
+
+        HandleElement get(uint32_t index, const HostTrap &trap) const
+        {
+            check(index, trap);
+            return {reps_[index], (flags_[index] & OWN) != 0, scopes_[index], lend_counts_[index]};
+        }
+
+        uint32_t rep(uint32_t index, const HostTrap &trap) const
+        {
+            check(index, trap);
+            return reps_[index];
         }
 
         uint32_t add(const HandleElement &element, const HostTrap &trap)
         {
-            auto trap_cx = make_trap_context(trap);
-            uint32_t index;
-            if (!free_.empty())
+            uint32_t index = free_head_;
+            if (index != 0)
             {
-                index = free_.back();
-                free_.pop_back();
-                entries_[index] = element;
+                free_head_ = reps_[index];
+                free_count_ -= 1;
             }
             else
             {
-                trap_if(trap_cx, entries_.size() >= MAX_LENGTH, "resource table overflow");
-                entries_.push_back(element);
-                index = static_cast<uint32_t>(entries_.size() - 1);
-            }
+                auto trap_cx = make_trap_context(trap);
+                trap_if(trap_cx, reps_.size() >= MAX_LENGTH, "resource table overflow");
+                index = static_cast<uint32_t>(reps_.size());
+                reps_.push_back(0);
+                scopes_.push_back(nullptr);
+                lend_counts_.push_back(0);
+                flags_.push_back(0);
+            }
+            reps_[index] = element.rep;
+            scopes_[index] = element.scope;
+            lend_counts_[index] = element.lend_count;
+            flags_[index] = static_cast<uint8_t>(LIVE | (element.own ? OWN : 0));
             return index;
         }
 
         HandleElement remove(uint32_t index, const HostTrap &trap)
         {
             HandleElement element = get(index, trap);
-            entries_[index].reset();
-            free_.push_back(index);
+            flags_[index] = 0;
+            scopes_[index] = nullptr;
+            reps_[index] = free_head_;
+            free_head_ = index;
+            free_count_ += 1;
             return element;
         }
 
-        const std::vector<std::optional<HandleElement>> &entries() const
+        void lend(uint32_t index, const HostTrap &trap)
+        {
+            check(index, trap);
+            lend_counts_[index] += 1;
+        }
+
+        void end_lend(uint32_t index)
         {
-            return entries_;
+            if (index < lend_counts_.size() && lend_counts_[index] > 0)
+            {
+                lend_counts_[index] -= 1;
+            }
+        }
+
+        bool contains(uint32_t index) const
+        {
+            return index < flags_.size() && (flags_[index] & LIVE) != 0;
+        }
+
+        //  Slots allocated so far, including the reserved index 0.
+        std::size_t size() const
+        {
+            return reps_.size();
+        }
+
+        std::size_t free_count() const
+        {
+            return free_count_;
+        }
+
+        bool has_lends() const
+        {
+            for (std::size_t i = 1; i < flags_.size(); ++i)
+            {
+                if ((flags_[i] & LIVE) != 0 && lend_counts_[i] != 0)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool has_owned() const
+        {
+            for (std::size_t i = 1; i < flags_.size(); ++i)
+            {
+                if ((flags_[i] & (LIVE | OWN)) == (LIVE | OWN))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        //  Appends the scope of every live borrow, one entry per borrow.
+        void borrow_scopes(std::vector<LiftLowerContext *> &scopes) const
+        {
+            for (std::size_t i = 1; i < flags_.size(); ++i)
+            {
+                if ((flags_[i] & (LIVE | OWN)) == LIVE && scopes_[i])
+                {
+                    scopes.push_back(scopes_[i]);
+                }
+            }
         }
 
-        const std::vector<uint32_t> &free_list() const
+        //  Drops every live handle in one pass over the flag array: owned reps
+        //  are appended to owned, borrows are released from their scopes.  The
+        //  arrays keep their capacity for the next occupant.
+        void clear(std::vector<uint32_t> &owned, const HostTrap &trap)
         {
-            return free_;
+            for (std::size_t i = 1; i < flags_.size(); ++i)
+            {
+                if ((flags_[i] & LIVE) == 0)
+                {
+                    continue;
+                }
+                if ((flags_[i] & OWN) != 0)
+                {
+                    owned.push_back(reps_[i]);
+                }
+                else if (auto *scope = scopes_[i])
+                {
+                    auto trap_cx = make_trap_context(trap);
+                    trap_if(trap_cx, scope->borrow_count == 0, "borrow scope underflow");
+                    scope->borrow_count -= 1;
+                }
+            }
+            reps_.resize(1);
+            scopes_.resize(1);
+            lend_counts_.resize(1);
+            flags_.resize(1);
+            free_head_ = 0;
+            free_count_ = 0;
         }
 
     private:
-        std::vector<std::optional<HandleElement>> entries_{std::nullopt};
-        std::vector<uint32_t> free_;
+        static constexpr uint8_t LIVE = 1;
+        static constexpr uint8_t OWN = 2;
+
+        void check(uint32_t index, const HostTrap &trap) const
+        {
+            if (index >= flags_.size() || (flags_[index] & LIVE) == 0)
+            {
+                auto trap_cx = make_trap_context(trap);
+                trap_if(trap_cx, index >= flags_.size(), "resource index out of bounds");
+                trap_if(trap_cx, true, "resource slot empty");
+            }
+        }
+
+        std::vector<uint32_t> reps_{0};
+        std::vector<LiftLowerContext *> scopes_{nullptr};
+        std::vector<uint32_t> lend_counts_{0};
+        std::vector<uint8_t> flags_{0};
+        uint32_t free_head_ = 0;
+        std::size_t free_count_ = 0;
+        uint32_t type_id_;
+        uint32_t generation_;
     };
 
+    //  One table per resource type, indexed by ResourceType::id.  Tables are
+    //  created on first use and never move, so HandleLend can point at them.
     class HandleTables
     {
     public:
-        HandleElement &get(ResourceType &rt, uint32_t index, const HostTrap &trap)
+        HandleElement get(const ResourceType &rt, uint32_t index, const HostTrap &trap) const
+        {
+            auto *t = find(rt);
+            if (!t)
+            {
+                auto trap_cx = make_trap_context(trap);
+                trap_if(trap_cx, true, "resource table missing");
+            }
+            return t->get(index, trap);
+        }
+
+        uint32_t rep(const ResourceType &rt, uint32_t index, const HostTrap &trap) const
+        {
+            auto *t = find(rt);
+            if (!t)
+            {
+                auto trap_cx = make_trap_context(trap);
+                trap_if(trap_cx, true, "resource table missing");
+            }
+            return t->rep(index, trap);
+        }
+
+        uint32_t add(const ResourceType &rt, const HandleElement &element, const HostTrap &trap)
+        {
+            return table(rt).add(element, trap);
+        }
+
+        HandleElement remove(const ResourceType &rt, uint32_t index, const HostTrap &trap)
+        {
+            return table(rt).remove(index, trap);
+        }
+
+        HandleTable &table(const ResourceType &rt)
+        {
+            if (rt.id() >= tables_.size())
+            {
+                tables_.resize(rt.id() + 1);
+            }
+            auto &t = tables_[rt.id()];
+            if (!t)
+            {
+                t = std::make_unique<HandleTable>(rt);
+            }
+            else if (!t->belongs_to(rt))
+            {
+                t->rebind(rt);
+            }
+            return *t;
+        }
+
+        HandleTable *find(const ResourceType &rt) const
+        {
+            if (rt.id() >= tables_.size() || !tables_[rt.id()] || !tables_[rt.id()]->belongs_to(rt))
+            {
+                return nullptr;
+            }
+            return tables_[rt.id()].get();
+        }
+
+        //  Drops every handle of every type, grouped by type: one pass per table
+        //  and one batched destructor call per type.  Every trap condition is
+        //  checked across all tables first, so a trap leaves them untouched.
+        void teardown(const ComponentInstance &inst, const HostTrap &trap);
+
+    private:
+        std::vector<std::unique_ptr<HandleTable>> tables_;
+        std::vector<uint32_t> scratch_;
+        std::vector<LiftLowerContext *> scopes_;
+    };
+
+    class Task;
+
+    //  FIFO of tasks waiting in Task::enter.  Waiters are parked rather than
+    //  polled; backpressure release and Task::exit admit them in order through
+    //  admit_waiters().
+    class AdmissionQueue
+    {
+    public:
+        struct Stats
+        {
+            uint64_t queued_total = 0;
+            uint64_t admitted = 0;
+            uint64_t cancelled = 0;
+            std::size_t max_length = 0;
+            Clock::duration total_wait{};
+            Clock::duration max_wait{};
+        };
+
+        std::size_t size() const
+        {
+            return waiters_.size();
+        }
+
+        //  Tasks admitted but not yet back in Task::enter.
+        uint32_t in_flight() const
+        {
+            return in_flight_;
+        }
+
+        const Stats &stats() const
         {
-            return table(rt).get(index, trap);
+            return stats_;
         }
 
-        const HandleElement &get(const ResourceType &rt, uint32_t index, const HostTrap &trap) const
+    private:
+        friend class Task;
+        friend void admit_waiters(ComponentInstance &inst);
+
+        struct Waiter
         {
-            auto it = tables_.find(&rt);
-            auto trap_cx = make_trap_context(trap);
-            trap_if(trap_cx, it == tables_.end(), "resource table missing");
-            return it->second.get(index, trap);
+            Task *task;
+            ThreadWaker waker;
+            TimePoint since;
+            bool exclusive;
+        };
+
+        bool idle() const
+        {
+            return waiters_.empty() && in_flight_ == 0;
         }
 
-        uint32_t add(ResourceType &rt, const HandleElement &element, const HostTrap &trap)
+        void push(Waiter waiter, bool front)
         {
-            return table(rt).add(element, trap);
+            if (front)
+            {
+                waiters_.push_front(std::move(waiter));
+            }
+            else
+            {
+                waiters_.push_back(std::move(waiter));
+                stats_.queued_total += 1;
+            }
+            stats_.max_length = std::max(stats_.max_length, waiters_.size());
         }
 
-        HandleElement remove(ResourceType &rt, uint32_t index, const HostTrap &trap)
+        Waiter *find(const Task *task)
         {
-            return table(rt).remove(index, trap);
+            auto it = std::find_if(waiters_.begin(), waiters_.end(), [task](const Waiter &w)
+                                   { return w.task == task; });
+            return it == waiters_.end() ? nullptr : &*it;
         }
 
-        HandleTable &table(ResourceType &rt)
+        bool remove(const Task *task)
         {
-            return tables_[&rt];
+            auto it = std::find_if(waiters_.begin(), waiters_.end(), [task](const Waiter &w)
+                                   { return w.task == task; });
+            if (it == waiters_.end())
+            {
+                return false;
+            }
+            waiters_.erase(it);
+            return true;
         }
 
-    private:
-        std::unordered_map<const ResourceType *, HandleTable> tables_;
+        std::deque<Waiter> waiters_;
+        uint32_t in_flight_ = 0;
+        bool exclusive_in_flight_ = false;
+        Stats stats_;
     };
 
     struct ComponentInstance
@@ -1480,10 +2569,80 @@ namespace cmcpp
         bool exclusive = false;
         uint32_t backpressure = 0;
         uint32_t num_waiting_to_enter = 0;
+        //  Threads bound to tasks of this instance join this group (see
+        //  Task::set_thread); instances may share a group.
+        std::shared_ptr<SchedulingGroup> scheduling_group;
+        AdmissionQueue admission;
+        CallPools pools;
         HandleTables handles;
         InstanceTable table;
     };
 
+    void admit_waiters(ComponentInstance &inst);
+
+    inline void HandleTables::teardown(const ComponentInstance &inst, const HostTrap &trap)
+    {
+        auto trap_cx = make_trap_context(trap);
+        scopes_.clear();
+        for (const auto &t : tables_)
+        {
+            if (!t)
+            {
+                continue;
+            }
+            trap_if(trap_cx, t->has_lends(), "resource has outstanding lends");
+            const auto *rt = t->type();
+            if (rt && rt->impl != nullptr && &inst != rt->impl && t->has_owned())
+            {
+                trap_if(trap_cx, !rt->impl->may_enter, "resource impl may not enter");
+            }
+            t->borrow_scopes(scopes_);
+        }
+        //  Borrows from several tables may share a scope; each scope must
+        //  account for all of them.
+        std::sort(scopes_.begin(), scopes_.end());
+        for (std::size_t i = 0; i < scopes_.size();)
+        {
+            std::size_t j = i;
+            while (j < scopes_.size() && scopes_[j] == scopes_[i])
+            {
+                ++j;
+            }
+            trap_if(trap_cx, scopes_[i]->borrow_count < j - i, "borrow scope underflow");
+            i = j;
+        }
+        for (const auto &t : tables_)
+        {
+            if (!t)
+            {
+                continue;
+            }
+            scratch_.clear();
+            t->clear(scratch_, trap);
+            if (const auto *rt = t->type(); rt && !scratch_.empty())
+            {
+                rt->destroy(scratch_);
+            }
+        }
+    }
+
+    //  Returns an instance to an empty state for reuse: every resource handle is
+    //  destroyed in per-type batches and the instance table is released in
+    //  O(live entries).  Traps if tasks are still running in the instance.
+    inline void reset_instance(ComponentInstance &inst, const HostTrap &trap)
+    {
+        auto trap_cx = make_trap_context(trap);
+        trap_if(trap_cx, inst.admission.in_flight() != 0 || inst.admission.size() != 0, "instance has tasks in flight");
+        inst.handles.teardown(inst, trap);
+        inst.table.clear();
+    }
+
+    inline const std::shared_ptr<SlabPool> &buffer_pool(const LiftLowerContext &cx)
+    {
+        static const std::shared_ptr<SlabPool> none;
+        return cx.inst ? cx.inst->pools.buffers : none;
+    }
+
     inline void ensure_may_leave(ComponentInstance &inst, const HostTrap &trap)
     {
         auto trap_cx = make_trap_context(trap);
@@ -1493,6 +2652,10 @@ namespace cmcpp
     inline void canon_backpressure_set(ComponentInstance &inst, bool enabled)
     {
         inst.backpressure = enabled ? 1u : 0u;
+        if (!enabled)
+        {
+            admit_waiters(inst);
+        }
     }
 
     inline void canon_backpressure_inc(ComponentInstance &inst, const HostTrap &trap)
@@ -1507,6 +2670,10 @@ namespace cmcpp
         auto trap_cx = make_trap_context(trap);
         trap_if(trap_cx, inst.backpressure == 0, "backpressure underflow");
         inst.backpressure -= 1;
+        if (inst.backpressure == 0)
+        {
+            admit_waiters(inst);
+        }
     }
 
     class Task : public std::enable_shared_from_this<Task>
@@ -1528,6 +2695,28 @@ namespace cmcpp
         {
         }
 
+        ~Task()
+        {
+            if (owns_supertask_)
+            {
+                supertask_->call = Call();
+            }
+            if (!inst_)
+            {
+                return;
+            }
+            auto &queue = inst_->admission;
+            if (admission_ == Admission::Queued && queue.remove(this))
+            {
+                inst_->num_waiting_to_enter -= 1;
+            }
+            else if (admission_ == Admission::Admitted)
+            {
+                release_admission();
+                admit_waiters(*inst_);
+            }
+        }
+
         void set_thread(const std::shared_ptr<Thread> &thread)
         {
             thread_ = thread;
@@ -1535,12 +2724,19 @@ namespace cmcpp
             {
                 thread_->set_allow_cancellation(!opts_.sync);
                 thread_->set_in_event_loop(opts_.callback.has_value());
+                if (inst_ && inst_->scheduling_group)
+                {
+                    thread_->set_group(inst_->scheduling_group);
+                }
                 if (inst_)
                 {
-                    auto super = std::make_shared<Supertask>();
+                    auto super = make_pooled<Supertask>(inst_->pools.supertasks);
                     super->instance = inst_;
                     super->thread = thread_;
-                    super->parent = supertask_;
+                    super->call = Call([this]()
+                                       { request_cancellation(); });
+                    owns_supertask_ = true;
+                    attach_subtask(supertask_, super);
                     supertask_ = std::move(super);
                 }
             }
@@ -1551,6 +2747,19 @@ namespace cmcpp
             return thread_;
         }
 
+        //  This task's node in the Supertask tree once set_thread has run; pass it
+        //  as the caller of subtasks so deadlines and cancellation reach them.
+        const SupertaskPtr &supertask() const
+        {
+            return supertask_;
+        }
+
+        //  Request deadline inherited from the enclosing scopes, if any.
+        std::optional<TimePoint> deadline() const
+        {
+            return supertask_ ? supertask_->deadline : std::nullopt;
+        }
+
         void set_on_resolve(OnResolve on_resolve)
         {
             on_resolve_ = std::move(on_resolve);
@@ -1565,26 +2774,47 @@ namespace cmcpp
                 return false;
             }
 
-            auto has_backpressure = [inst, this]() -> bool
+            auto &queue = inst->admission;
+            if (admission_ == Admission::Queued)
             {
-                return inst->backpressure > 0 || (needs_exclusive() && inst->exclusive);
-            };
+                //  Woken without being admitted: cancellation or a spurious resume.
+                if (state_ == State::CancelDelivered)
+                {
+                    queue.remove(this);
+                    inst->num_waiting_to_enter -= 1;
+                    queue.stats_.cancelled += 1;
+                    admission_ = Admission::None;
+                    cancel(trap);
+                    return false;
+                }
+                if (auto *waiter = queue.find(this))
+                {
+                    waiter->waker = thread_ptr->park(true);
+                }
+                return false;
+            }
 
-            if (has_backpressure() || inst->num_waiting_to_enter > 0)
+            bool admitted = admission_ == Admission::Admitted;
+            if (admitted)
             {
-                inst->num_waiting_to_enter += 1;
-                bool completed = thread_ptr->suspend_until([has_backpressure]()
-                                                           { return !has_backpressure(); },
-                                                           true);
-                inst->num_waiting_to_enter -= 1;
-                if (!completed)
+                release_admission();
+            }
+
+            bool blocked = inst->backpressure > 0 || (needs_exclusive() && inst->exclusive);
+            if (blocked || (!admitted && !queue.idle()))
+            {
+                if (state_ == State::CancelDelivered)
                 {
-                    if (state_ == State::CancelDelivered)
-                    {
-                        cancel(trap);
-                    }
+                    cancel(trap);
                     return false;
                 }
+                CMCPP_SCHED_RECORD(record_suspend(SuspendReason::Backpressure);)
+                //  An admitted task that lost the race to new backpressure keeps its
+                //  place at the head of the queue.
+                queue.push({this, thread_ptr->park(true), now(), needs_exclusive()}, admitted);
+                inst->num_waiting_to_enter += 1;
+                admission_ = Admission::Queued;
+                return false;
             }
 
             if (needs_exclusive())
@@ -1604,6 +2834,7 @@ namespace cmcpp
             {
                 inst_->exclusive = false;
             }
+            admit_waiters(*inst_);
         }
 
         void request_cancellation()
@@ -1647,6 +2878,29 @@ namespace cmcpp
             return completed;
         }
 
+        bool suspend_until_deadline(TimePoint deadline, bool cancellable)
+        {
+            if (cancellable && state_ == State::CancelDelivered)
+            {
+                return false;
+            }
+            if (cancellable && state_ == State::PendingCancel)
+            {
+                state_ = State::CancelDelivered;
+                return false;
+            }
+            if (!thread_)
+            {
+                return false;
+            }
+            bool completed = thread_->suspend_until_deadline(deadline, cancellable);
+            if (!completed && cancellable && state_ == State::PendingCancel)
+            {
+                state_ = State::CancelDelivered;
+            }
+            return completed;
+        }
+
         Event yield_until(Thread::ReadyFn ready, bool cancellable, bool force_yield = false)
         {
             if (!suspend_until(std::move(ready), cancellable, force_yield))
@@ -1711,17 +2965,48 @@ namespace cmcpp
             return !opts_.sync || state_ == State::Resolved;
         }
 
+    protected:
+        void ensure_resolvable(const HostTrap &trap)
+        {
+            auto trap_cx = make_trap_context(trap);
+            trap_if(trap_cx, state_ == State::Resolved, "task already resolved");
+            trap_if(trap_cx, num_borrows_ > 0, "task has outstanding borrows");
+        }
+
+        void mark_resolved()
+        {
+            state_ = State::Resolved;
+        }
+
     private:
+        friend void admit_waiters(ComponentInstance &inst);
+
+        enum class Admission : uint8_t
+        {
+            None,
+            Queued,
+            Admitted
+        };
+
         bool needs_exclusive() const
         {
             return opts_.sync || opts_.callback.has_value();
         }
 
-        void ensure_resolvable(const HostTrap &trap)
+        TimePoint now() const
         {
-            auto trap_cx = make_trap_context(trap);
-            trap_if(trap_cx, state_ == State::Resolved, "task already resolved");
-            trap_if(trap_cx, num_borrows_ > 0, "task has outstanding borrows");
+            return inst_->store ? inst_->store->now() : Clock::now();
+        }
+
+        void release_admission()
+        {
+            auto &queue = inst_->admission;
+            queue.in_flight_ -= 1;
+            if (needs_exclusive())
+            {
+                queue.exclusive_in_flight_ = false;
+            }
+            admission_ = Admission::None;
         }
 
         bool ready_for_cancellation() const
@@ -1740,6 +3025,94 @@ namespace cmcpp
         uint32_t num_borrows_ = 0;
         std::shared_ptr<Thread> thread_;
         State state_ = State::Initial;
+        Admission admission_ = Admission::None;
+        bool owns_supertask_ = false;
+    };
+
+    //  Wakes waiters from the head of inst.admission while they can enter: all
+    //  leading non-exclusive tasks, or a single exclusive one once the instance
+    //  is free.
+    inline void admit_waiters(ComponentInstance &inst)
+    {
+        auto &queue = inst.admission;
+        while (!queue.waiters_.empty() && inst.backpressure == 0)
+        {
+            auto &head = queue.waiters_.front();
+            if (head.exclusive && (inst.exclusive || queue.exclusive_in_flight_))
+            {
+                break;
+            }
+            auto waiter = std::move(head);
+            queue.waiters_.pop_front();
+            inst.num_waiting_to_enter -= 1;
+            queue.in_flight_ += 1;
+            queue.exclusive_in_flight_ = queue.exclusive_in_flight_ || waiter.exclusive;
+            waiter.task->admission_ = Task::Admission::Admitted;
+
+            auto wait = waiter.task->now() - waiter.since;
+            queue.stats_.admitted += 1;
+            queue.stats_.total_wait += wait;
+            queue.stats_.max_wait = std::max(queue.stats_.max_wait, wait);
+            waiter.waker();
+            if (waiter.exclusive)
+            {
+                break;
+            }
+        }
+    }
+
+    //  Task whose results are delivered unboxed; Params names the argument tuple
+    //  of the matching TypedFuncInst.  The base std::any on_resolve slot holds an
+    //  adapter, so canon_task_return(Task &, ...) and cancellation still reach
+    //  the typed callback.
+    template <typename Params, typename Results>
+    class TypedTask : public Task
+    {
+    public:
+        TypedTask(ComponentInstance &instance,
+                  CanonicalOptions options = {},
+                  SupertaskPtr supertask = {},
+                  TypedOnResolve<Results> on_resolve = {})
+            : Task(instance, std::move(options), std::move(supertask))
+        {
+            set_on_resolve(std::move(on_resolve));
+        }
+
+        TypedTask(const TypedTask &) = delete;
+        TypedTask &operator=(const TypedTask &) = delete;
+
+        void set_on_resolve(TypedOnResolve<Results> on_resolve)
+        {
+            on_resolve_ = std::move(on_resolve);
+            if (!on_resolve_)
+            {
+                Task::set_on_resolve({});
+                return;
+            }
+            Task::set_on_resolve([this](std::optional<std::vector<std::any>> values)
+                                 {
+                                     if (!values)
+                                     {
+                                         on_resolve_(std::nullopt);
+                                         return;
+                                     }
+                                     on_resolve_(from_any_values<Results>(std::move(*values))); });
+        }
+
+        void return_result(Results result, const HostTrap &trap)
+        {
+            ensure_resolvable(trap);
+            if (on_resolve_)
+            {
+                on_resolve_(std::optional<Results>(std::move(result)));
+            }
+            mark_resolved();
+        }
+
+        using Task::return_result;
+
+    private:
+        TypedOnResolve<Results> on_resolve_;
     };
 
     inline void canon_task_return(Task &task, std::vector<std::any> result, const HostTrap &trap)
@@ -1753,6 +3126,19 @@ namespace cmcpp
         task.return_result(std::move(result), trap);
     }
 
+    //  Unboxed task.return for TypedTask.
+    template <typename Params, typename Results>
+    void canon_task_return(TypedTask<Params, Results> &task, Results result, const HostTrap &trap)
+    {
+        if (auto *inst = task.component_instance())
+        {
+            ensure_may_leave(*inst, trap);
+        }
+        auto trap_cx = make_trap_context(trap);
+        trap_if(trap_cx, task.options().sync, "task.return requires async context");
+        task.return_result(std::move(result), trap);
+    }
+
     inline void canon_task_cancel(Task &task, const HostTrap &trap)
     {
         if (auto *inst = task.component_instance())
@@ -1775,6 +3161,7 @@ namespace cmcpp
             return static_cast<uint32_t>(SuspendResult::NOT_CANCELLED);
         }
 
+        CMCPP_SCHED_RECORD(record_suspend(SuspendReason::Yield);)
         auto event = task.yield_until([]
                                       { return true; },
                                       cancellable);
@@ -1796,7 +3183,7 @@ namespace cmcpp
         trap_if(trap_cx, inst == nullptr, "thread.resume-later missing component instance");
         ensure_may_leave(*inst, trap);
 
-        auto entry = inst->table.get<ThreadEntry>(thread_index, trap);
+        auto *entry = inst->table.borrow<ThreadEntry>(thread_index, trap);
         auto other_thread = entry->thread();
         trap_if(trap_cx, !other_thread, "thread.resume-later null thread");
         trap_if(trap_cx, !other_thread->suspended(), "thread not suspended");
@@ -1810,7 +3197,7 @@ namespace cmcpp
         trap_if(trap_cx, inst == nullptr, "thread.yield-to missing component instance");
         ensure_may_leave(*inst, trap);
 
-        auto entry = inst->table.get<ThreadEntry>(thread_index, trap);
+        auto *entry = inst->table.borrow<ThreadEntry>(thread_index, trap);
         auto other_thread = entry->thread();
         trap_if(trap_cx, !other_thread, "thread.yield-to null thread");
         trap_if(trap_cx, !other_thread->suspended(), "thread not suspended");
@@ -1836,7 +3223,7 @@ namespace cmcpp
         trap_if(trap_cx, inst == nullptr, "thread.switch-to missing component instance");
         ensure_may_leave(*inst, trap);
 
-        auto entry = inst->table.get<ThreadEntry>(thread_index, trap);
+        auto *entry = inst->table.borrow<ThreadEntry>(thread_index, trap);
         auto other_thread = entry->thread();
         trap_if(trap_cx, !other_thread, "thread.switch-to null thread");
         trap_if(trap_cx, !other_thread->suspended(), "thread not suspended");
@@ -1861,7 +3248,10 @@ namespace cmcpp
         return static_cast<uint32_t>(SuspendResult::NOT_CANCELLED);
     }
 
-    inline uint32_t canon_thread_new_ref(bool /*shared*/, Task &task, std::function<void(uint32_t)> callee, uint32_t c, const HostTrap &trap)
+    //  With a shared executor installed on the store, shared threads run callee on
+    //  a host OS thread once resumed; the Thread remains the table handle.  Without
+    //  one they run cooperatively, like unshared threads.
+    inline uint32_t canon_thread_new_ref(bool shared, Task &task, std::function<void(uint32_t)> callee, uint32_t c, const HostTrap &trap)
     {
         auto *inst = task.component_instance();
         auto trap_cx = make_trap_context(trap);
@@ -1870,15 +3260,24 @@ namespace cmcpp
         trap_if(trap_cx, inst->store == nullptr, "thread.new-ref missing store");
         trap_if(trap_cx, !callee, "thread.new-ref null callee");
 
-        auto thread = Thread::create_suspended(
-            *inst->store,
-            [callee = std::move(callee), c](bool)
-            {
-                callee(c);
-                return false;
-            },
-            true,
-            {});
+        std::shared_ptr<Thread> thread;
+        if (shared)
+        {
+            thread = Thread::create_shared(*inst->store, [callee = std::move(callee), c]()
+                                           { callee(c); });
+        }
+        else
+        {
+            thread = Thread::create_suspended(
+                *inst->store,
+                [callee = std::move(callee), c](bool)
+                {
+                    callee(c);
+                    return false;
+                },
+                true,
+                {});
+        }
         trap_if(trap_cx, !thread || !thread->suspended(), "thread.new-ref failed to create suspended thread");
 
         uint32_t index = inst->table.add(std::make_shared<ThreadEntry>(thread), trap);
@@ -1886,13 +3285,13 @@ namespace cmcpp
         return index;
     }
 
-    inline uint32_t canon_thread_new_indirect(bool /*shared*/, Task &task, const std::vector<std::function<void(uint32_t)>> &table, uint32_t fi, uint32_t c, const HostTrap &trap)
+    inline uint32_t canon_thread_new_indirect(bool shared, Task &task, const std::vector<std::function<void(uint32_t)>> &table, uint32_t fi, uint32_t c, const HostTrap &trap)
     {
         auto trap_cx = make_trap_context(trap);
         trap_if(trap_cx, fi >= table.size(), "thread.new-indirect out of bounds");
         auto callee = table[fi];
         trap_if(trap_cx, !callee, "thread.new-indirect null callee");
-        return canon_thread_new_ref(false, task, std::move(callee), c, trap);
+        return canon_thread_new_ref(shared, task, std::move(callee), c, trap);
     }
 
     inline uint32_t canon_thread_spawn_ref(bool shared, Task &task, std::function<void(uint32_t)> callee, uint32_t c, const HostTrap &trap)
@@ -1920,6 +3319,11 @@ namespace cmcpp
         {
             return 1;
         }
+        auto executor = inst->store ? inst->store->shared_executor() : nullptr;
+        if (executor)
+        {
+            return static_cast<uint32_t>(std::max<std::size_t>(executor->concurrency(), 1));
+        }
         auto hc = std::thread::hardware_concurrency();
         return hc == 0 ? 1u : hc;
     }
@@ -1947,6 +3351,7 @@ namespace cmcpp
         trap_if(trap_cx, !task.may_block(), "thread.suspend may not block");
 
         // Force a yield of this thread for at least one tick.
+        CMCPP_SCHED_RECORD(record_suspend(SuspendReason::Yield);)
         task.suspend_until([]
                            { return true; },
                            cancellable,
@@ -1959,6 +3364,25 @@ namespace cmcpp
         return static_cast<uint32_t>(SuspendResult::NOT_CANCELLED);
     }
 
+    //  Parks the thread on the Store's timer wheel instead of busy-yielding.
+    inline uint32_t canon_thread_sleep_until(bool cancellable, Task &task, TimePoint deadline, const HostTrap &trap)
+    {
+        auto *inst = task.component_instance();
+        auto trap_cx = make_trap_context(trap);
+        trap_if(trap_cx, inst == nullptr, "thread.sleep missing component instance");
+        ensure_may_leave(*inst, trap);
+        trap_if(trap_cx, !task.may_block(), "thread.sleep may not block");
+
+        CMCPP_SCHED_RECORD(record_suspend(SuspendReason::Sleep);)
+        task.suspend_until_deadline(deadline, cancellable);
+
+        if (cancellable && (task.state() == Task::State::CancelDelivered || task.state() == Task::State::PendingCancel))
+        {
+            return static_cast<uint32_t>(SuspendResult::CANCELLED);
+        }
+        return static_cast<uint32_t>(SuspendResult::NOT_CANCELLED);
+    }
+
     inline uint32_t canon_task_wait(bool /*cancellable*/,
                                     GuestMemory mem,
                                     Task &task,
@@ -1971,12 +3395,13 @@ namespace cmcpp
         trap_if(trap_cx, inst == nullptr, "task.wait missing component instance");
         ensure_may_leave(*inst, trap);
 
-        auto wset = inst->table.get<WaitableSet>(waitable_set_handle, trap);
+        auto *wset = inst->table.borrow<WaitableSet>(waitable_set_handle, trap);
         wset->begin_wait();
         if (!wset->has_pending_event())
         {
             wset->end_wait();
             write_event_fields(mem, event_ptr, 0, 0, trap);
+            CMCPP_SCHED_RECORD(record_suspend(SuspendReason::WaitableSetWait);)
             return BLOCKED;
         }
         auto event = wset->take_pending_event(trap);
@@ -1993,23 +3418,23 @@ namespace cmcpp
     {
     };
 
-    inline void LiftLowerContext::track_owning_lend(HandleElement &lending_handle)
+    inline void LiftLowerContext::track_owning_lend(HandleTable &table, uint32_t index) const
     {
-        trap_if(*this, !lending_handle.own, "lender must own resource");
-        lending_handle.lend_count += 1;
-        lenders.push_back(&lending_handle);
+        trap_if(*this, !table.get(index, trap).own, "lender must own resource");
+        table.lend(index, trap);
+        lenders.push_back({&table, index});
     }
 
     inline void LiftLowerContext::exit_call()
     {
         trap_if(*this, borrow_count != 0, "borrow count mismatch on exit");
-        for (auto *handle : lenders)
-        {
-            if (handle && handle->lend_count > 0)
-            {
-                handle->lend_count -= 1;
-            }
-        }
+        lenders.for_each([](const HandleLend &lend)
+                         {
+                             if (lend.table)
+                             {
+                                 lend.table->end_lend(lend.index);
+                             }
+                         });
         lenders.clear();
     }
 
@@ -2021,9 +3446,10 @@ namespace cmcpp
         return inst.handles.add(rt, element, trap);
     }
 
-    inline void canon_resource_drop(ComponentInstance &inst, ResourceType &rt, uint32_t index, const HostTrap &trap)
+    //  Canonical checks and side effects of dropping a handle that has already
+    //  been removed from its table.
+    inline void release_handle(const ComponentInstance &inst, const ResourceType &rt, const HandleElement &element, const HostTrap &trap)
     {
-        HandleElement element = inst.handles.remove(rt, index, trap);
         auto trap_cx = make_trap_context(trap);
         if (element.own)
         {
@@ -2043,10 +3469,14 @@ namespace cmcpp
         }
     }
 
+    inline void canon_resource_drop(ComponentInstance &inst, ResourceType &rt, uint32_t index, const HostTrap &trap)
+    {
+        release_handle(inst, rt, inst.handles.remove(rt, index, trap), trap);
+    }
+
     inline uint32_t canon_resource_rep(ComponentInstance &inst, ResourceType &rt, uint32_t index, const HostTrap &trap)
     {
-        const HandleElement &element = inst.handles.get(rt, index, trap);
-        return element.rep;
+        return inst.handles.rep(rt, index, trap);
     }
 
     inline int32_t canon_context_get(Task &task, uint32_t index, const HostTrap &trap)
@@ -2085,12 +3515,13 @@ namespace cmcpp
     inline uint32_t canon_waitable_set_wait(bool /*cancellable*/, GuestMemory mem, ComponentInstance &inst, uint32_t set_index, uint32_t ptr, const HostTrap &trap)
     {
         ensure_may_leave(inst, trap);
-        auto wset = inst.table.get<WaitableSet>(set_index, trap);
+        auto *wset = inst.table.borrow<WaitableSet>(set_index, trap);
         wset->begin_wait();
         if (!wset->has_pending_event())
         {
             wset->end_wait();
             write_event_fields(mem, ptr, 0, 0, trap);
+            CMCPP_SCHED_RECORD(record_suspend(SuspendReason::WaitableSetWait);)
             return BLOCKED;
         }
         auto event = wset->take_pending_event(trap);
@@ -2099,10 +3530,60 @@ namespace cmcpp
         return static_cast<uint32_t>(event.code);
     }
 
+    //  Timed variant of waitable-set.wait.  Returns BLOCKED after parking the
+    //  thread until a member receives an event or the deadline passes; the retry
+    //  then reports the event, or EventCode::NONE once the deadline has passed.
+    inline uint32_t canon_waitable_set_wait_until(bool cancellable, GuestMemory mem, Task &task, uint32_t set_index, uint32_t ptr, TimePoint deadline, const HostTrap &trap)
+    {
+        auto *inst = task.component_instance();
+        auto trap_cx = make_trap_context(trap);
+        trap_if(trap_cx, inst == nullptr, "waitable-set.wait missing component instance");
+        ensure_may_leave(*inst, trap);
+        auto *wset = inst->table.borrow<WaitableSet>(set_index, trap);
+        if (wset->has_pending_event())
+        {
+            wset->begin_wait();
+            auto event = wset->take_pending_event(trap);
+            wset->end_wait();
+            write_event_fields(mem, ptr, event.index, event.payload, trap);
+            return static_cast<uint32_t>(event.code);
+        }
+
+        auto thread = task.thread();
+        trap_if(trap_cx, !thread, "thread missing");
+        if (deadline <= thread->store().now())
+        {
+            write_event_fields(mem, ptr, 0, 0, trap);
+            return static_cast<uint32_t>(EventCode::NONE);
+        }
+        trap_if(trap_cx, !task.may_block(), "waitable-set.wait may not block");
+
+        bool expired = task.suspend_until_deadline(deadline, cancellable);
+        if (cancellable && task.state() == Task::State::CancelDelivered)
+        {
+            write_event_fields(mem, ptr, 0, 0, trap);
+            return static_cast<uint32_t>(EventCode::TASK_CANCELLED);
+        }
+        if (!expired)
+        {
+            CMCPP_SCHED_RECORD(record_suspend(SuspendReason::WaitableSetWait);)
+            //  An event that fired after the check above found no waker to
+            //  run; with the waker registered, re-check and wake ourselves.
+            auto waker = thread->waker();
+            wset->add_waker(waker);
+            if (wset->has_pending_event())
+            {
+                waker();
+            }
+        }
+        write_event_fields(mem, ptr, 0, 0, trap);
+        return BLOCKED;
+    }
+
     inline uint32_t canon_waitable_set_poll(bool /*cancellable*/, GuestMemory mem, ComponentInstance &inst, uint32_t set_index, uint32_t ptr, const HostTrap &trap)
     {
         ensure_may_leave(inst, trap);
-        auto wset = inst.table.get<WaitableSet>(set_index, trap);
+        auto *wset = inst.table.borrow<WaitableSet>(set_index, trap);
         if (!wset->has_pending_event())
         {
             write_event_fields(mem, ptr, 0, 0, trap);
@@ -2123,22 +3604,28 @@ namespace cmcpp
     inline void canon_waitable_join(ComponentInstance &inst, uint32_t waitable_index, uint32_t set_index, const HostTrap &trap)
     {
         ensure_may_leave(inst, trap);
-        auto waitable = inst.table.get<Waitable>(waitable_index, trap);
+        auto *waitable = inst.table.borrow<Waitable>(waitable_index, trap);
         if (set_index == 0)
         {
             waitable->join(nullptr, trap);
             return;
         }
-        auto wset = inst.table.get<WaitableSet>(set_index, trap);
-        waitable->join(wset.get(), trap);
+        waitable->join(inst.table.borrow<WaitableSet>(set_index, trap), trap);
     }
 
-    inline uint64_t canon_stream_new(ComponentInstance &inst, const StreamDescriptor &descriptor, const HostTrap &trap)
+    //  A buffering capacity of 0 creates the plain rendezvous stream.
+    inline uint64_t canon_stream_new(ComponentInstance &inst, const StreamDescriptor &descriptor, const StreamBuffering &buffering, const HostTrap &trap)
     {
         ensure_may_leave(inst, trap);
         auto trap_cx = make_trap_context(trap);
         trap_if(trap_cx, descriptor.element_size == 0, "stream descriptor invalid");
         auto shared = std::make_shared<SharedStreamState>(descriptor);
+        if (buffering.capacity > 0)
+        {
+            trap_if(trap_cx, buffering.high_water == 0 || buffering.high_water > buffering.capacity, "stream high-water mark out of range");
+            trap_if(trap_cx, buffering.low_water >= buffering.capacity, "stream low-water mark out of range");
+            shared->set_buffering(buffering);
+        }
         auto readable = std::make_shared<ReadableStreamEnd>(shared);
         auto writable = std::make_shared<WritableStreamEnd>(shared);
         uint32_t readable_index = inst.table.add(readable, trap);
@@ -2146,6 +3633,11 @@ namespace cmcpp
         return (static_cast<uint64_t>(writable_index) << 32) | readable_index;
     }
 
+    inline uint64_t canon_stream_new(ComponentInstance &inst, const StreamDescriptor &descriptor, const HostTrap &trap)
+    {
+        return canon_stream_new(inst, descriptor, StreamBuffering{}, trap);
+    }
+
     inline uint32_t canon_stream_read(ComponentInstance &inst,
                                       const StreamDescriptor &descriptor,
                                       uint32_t readable_index,
@@ -2158,8 +3650,10 @@ namespace cmcpp
         ensure_may_leave(inst, trap);
         auto trap_cx = make_trap_context(trap);
         trap_if(trap_cx, !cx, "lift/lower context required");
-        auto readable = inst.table.get<ReadableStreamEnd>(readable_index, trap);
+        auto *readable = inst.table.borrow<ReadableStreamEnd>(readable_index, trap);
         validate_descriptor(descriptor, readable->descriptor(), trap);
+        //  A sync copy may wait; keep the end alive in case it is dropped meanwhile.
+        auto keep_alive = sync ? inst.table.get_entry(readable_index, trap) : nullptr;
         return readable->read(cx, readable_index, ptr, n, sync, trap);
     }
 
@@ -2174,9 +3668,11 @@ namespace cmcpp
         ensure_may_leave(inst, trap);
         auto trap_cx = make_trap_context(trap);
         trap_if(trap_cx, !cx, "lift/lower context required");
-        auto writable = inst.table.get<WritableStreamEnd>(writable_index, trap);
+        auto *writable = inst.table.borrow<WritableStreamEnd>(writable_index, trap);
         validate_descriptor(descriptor, writable->descriptor(), trap);
         bool sync = cx->is_sync();
+        //  A sync copy may wait; keep the end alive in case it is dropped meanwhile.
+        auto keep_alive = sync ? inst.table.get_entry(writable_index, trap) : nullptr;
         return writable->write(cx, writable_index, ptr, n, sync, trap);
     }
 
@@ -2232,8 +3728,10 @@ namespace cmcpp
         ensure_may_leave(inst, trap);
         auto trap_cx = make_trap_context(trap);
         trap_if(trap_cx, !cx, "lift/lower context required");
-        auto readable = inst.table.get<ReadableFutureEnd>(readable_index, trap);
+        auto *readable = inst.table.borrow<ReadableFutureEnd>(readable_index, trap);
         validate_descriptor(descriptor, readable->descriptor(), trap);
+        //  A sync copy may wait; keep the end alive in case it is dropped meanwhile.
+        auto keep_alive = sync ? inst.table.get_entry(readable_index, trap) : nullptr;
         return readable->read(cx, readable_index, ptr, sync, trap);
     }
 
@@ -2247,9 +3745,11 @@ namespace cmcpp
         ensure_may_leave(inst, trap);
         auto trap_cx = make_trap_context(trap);
         trap_if(trap_cx, !cx, "lift/lower context required");
-        auto writable = inst.table.get<WritableFutureEnd>(writable_index, trap);
+        auto *writable = inst.table.borrow<WritableFutureEnd>(writable_index, trap);
         validate_descriptor(descriptor, writable->descriptor(), trap);
         bool sync = cx->is_sync();
+        //  A sync copy may wait; keep the end alive in case it is dropped meanwhile.
+        auto keep_alive = sync ? inst.table.get_entry(writable_index, trap) : nullptr;
         return writable->write(cx, writable_index, ptr, sync, trap);
     }
 
@@ -2321,6 +3821,20 @@ namespace cmcpp
             retVal->set_canonical_options(std::move(options));
             return retVal;
         }
+
+        //  Shared context for one async call into inst, allocated from the
+        //  instance's call pools along with the call's copy buffers.
+        std::shared_ptr<LiftLowerContext> createCallContext(ComponentInstance &inst, CanonicalOptions options)
+        {
+            if (!options.realloc)
+            {
+                options.realloc = realloc;
+            }
+            LiftLowerOptions opts(options.string_encoding, options.memory, options.realloc);
+            auto retVal = make_pooled<LiftLowerContext>(inst.pools.contexts, trap, convert, opts, &inst);
+            retVal->set_canonical_options(std::move(options));
+            return retVal;
+        }
     };
 
     inline std::unique_ptr<InstanceContext> createInstanceContext(const HostTrap &trap, HostUnicodeConversion convert, const GuestRealloc &realloc)
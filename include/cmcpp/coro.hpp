@@ -0,0 +1,635 @@
+#ifndef CMCPP_CORO_HPP
+#define CMCPP_CORO_HPP
+
+#include "context.hpp"
+
+#include <coroutine>
+#include <exception>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+//  C++20 coroutine front-end for the cooperative runtime.
+//
+//  A task<T> is a lazily started coroutine.  spawn() binds the outermost task to
+//  a runtime Thread; every co_await below it (nested tasks included) runs on that
+//  Thread.  Awaiters suspend by installing a readiness predicate with
+//  Thread::suspend_until, or by parking the Thread with a waker on the
+//  waitable they wait for, so the Store resumes the coroutine exactly where it
+//  left off without any callback plumbing.
+
+namespace cmcpp
+{
+    template <typename T = void>
+    class task;
+
+    template <typename T>
+    std::shared_ptr<Thread> spawn(Store &store, task<T> t, bool cancellable = false, Thread::CancelFn on_cancel = {});
+
+    struct CoroutineContext
+    {
+        Thread *thread = nullptr;
+        std::coroutine_handle<> leaf;
+        bool cancelled = false;
+    };
+
+    class PromiseBase
+    {
+    public:
+        struct FinalAwaiter
+        {
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            template <typename P>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+            {
+                auto &promise = h.promise();
+                if (promise.continuation_)
+                {
+                    promise.ctx_->leaf = promise.continuation_;
+                    return promise.continuation_;
+                }
+                return std::noop_coroutine();
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        std::suspend_always initial_suspend() const noexcept
+        {
+            return {};
+        }
+
+        FinalAwaiter final_suspend() const noexcept
+        {
+            return {};
+        }
+
+        void unhandled_exception() noexcept
+        {
+            exception_ = std::current_exception();
+        }
+
+        CoroutineContext *context() const
+        {
+            return ctx_;
+        }
+
+    protected:
+        template <typename>
+        friend class task;
+        template <typename T>
+        friend std::shared_ptr<Thread> spawn(Store &, task<T>, bool, Thread::CancelFn);
+
+        void rethrow_if_failed() const
+        {
+            if (exception_)
+            {
+                std::rethrow_exception(exception_);
+            }
+        }
+
+        CoroutineContext *ctx_ = nullptr;
+        CoroutineContext root_ctx_;
+        std::coroutine_handle<> continuation_;
+        std::exception_ptr exception_;
+    };
+
+    template <typename T>
+    class TaskPromise : public PromiseBase
+    {
+    public:
+        task<T> get_return_object() noexcept;
+
+        template <typename U>
+        void return_value(U &&value)
+        {
+            value_.emplace(std::forward<U>(value));
+        }
+
+        T take()
+        {
+            rethrow_if_failed();
+            return std::move(*value_);
+        }
+
+    private:
+        std::optional<T> value_;
+    };
+
+    template <>
+    class TaskPromise<void> : public PromiseBase
+    {
+    public:
+        task<void> get_return_object() noexcept;
+
+        void return_void() noexcept {}
+
+        void take()
+        {
+            rethrow_if_failed();
+        }
+    };
+
+    template <typename T>
+    class task
+    {
+    public:
+        using promise_type = TaskPromise<T>;
+        using handle_type = std::coroutine_handle<promise_type>;
+
+        task() = default;
+        explicit task(handle_type handle) : handle_(handle) {}
+
+        task(task &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+
+        task &operator=(task &&other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                handle_ = std::exchange(other.handle_, {});
+            }
+            return *this;
+        }
+
+        task(const task &) = delete;
+        task &operator=(const task &) = delete;
+
+        ~task()
+        {
+            reset();
+        }
+
+        bool done() const
+        {
+            return !handle_ || handle_.done();
+        }
+
+        struct Awaiter
+        {
+            handle_type child;
+
+            bool await_ready() const noexcept
+            {
+                return !child || child.done();
+            }
+
+            template <typename P>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<P> parent) noexcept
+            {
+                auto &promise = child.promise();
+                promise.ctx_ = parent.promise().context();
+                promise.continuation_ = parent;
+                if (promise.ctx_)
+                {
+                    promise.ctx_->leaf = child;
+                }
+                return child;
+            }
+
+            T await_resume()
+            {
+                return child.promise().take();
+            }
+        };
+
+        Awaiter operator co_await() &&noexcept
+        {
+            return Awaiter{handle_};
+        }
+
+    private:
+        template <typename U>
+        friend std::shared_ptr<Thread> spawn(Store &, task<U>, bool, Thread::CancelFn);
+
+        void reset()
+        {
+            if (handle_)
+            {
+                handle_.destroy();
+                handle_ = {};
+            }
+        }
+
+        handle_type handle_;
+    };
+
+    template <typename T>
+    inline task<T> TaskPromise<T>::get_return_object() noexcept
+    {
+        return task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+    }
+
+    inline task<void> TaskPromise<void>::get_return_object() noexcept
+    {
+        return task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+    }
+
+    //  Runs the task on a new runtime Thread.  The coroutine frame is owned by the
+    //  Thread and released as soon as the task completes; an exception escaping
+    //  the task propagates out of the Store::tick() that resumed it.
+    template <typename T>
+    std::shared_ptr<Thread> spawn(Store &store, task<T> t, bool cancellable, Thread::CancelFn on_cancel)
+    {
+        auto &promise = t.handle_.promise();
+        promise.ctx_ = &promise.root_ctx_;
+        promise.root_ctx_.leaf = t.handle_;
+        auto *ctx = promise.ctx_;
+
+        auto thread = Thread::create(
+            store,
+            nullptr,
+            [t = std::move(t), ctx](bool cancelled) mutable
+            {
+                ctx->cancelled = cancelled;
+                ctx->leaf.resume();
+                if (!t.done())
+                {
+                    return true;
+                }
+                auto finished = std::move(t);
+                finished.handle_.promise().take();
+                return false;
+            },
+            cancellable,
+            std::move(on_cancel));
+        ctx->thread = thread.get();
+        return thread;
+    }
+
+    //  Wraps a coroutine body as a FuncInst.  Returning std::nullopt resolves the
+    //  call as cancelled, mirroring OnResolve.
+    template <typename F>
+    FuncInst make_coroutine_func(F body)
+    {
+        return [body = std::move(body)](Store &store, SupertaskPtr caller, OnStart on_start, OnResolve on_resolve) -> Call
+        {
+            auto args = on_start ? on_start() : std::vector<std::any>{};
+            auto resolve = [](task<std::optional<std::vector<std::any>>> inner, OnResolve on_resolve) -> task<void>
+            {
+                auto result = co_await std::move(inner);
+                if (on_resolve)
+                {
+                    on_resolve(std::move(result));
+                }
+            };
+            return Call::from_thread(spawn(store, resolve(body(store, std::move(caller), std::move(args)), std::move(on_resolve)), true));
+        };
+    }
+
+    //  Typed variant of make_coroutine_func: body takes Params and returns
+    //  task<std::optional<Results>>, with no std::any boxing on the way.
+    template <typename Params, typename Results, typename F>
+    TypedFuncInst<Params, Results> make_typed_coroutine_func(F body)
+    {
+        return [body = std::move(body)](Store &store, SupertaskPtr caller, TypedOnStart<Params> on_start, TypedOnResolve<Results> on_resolve) -> Call
+        {
+            auto args = on_start ? on_start() : Params{};
+            auto resolve = [](task<std::optional<Results>> inner, TypedOnResolve<Results> on_resolve) -> task<void>
+            {
+                auto result = co_await std::move(inner);
+                if (on_resolve)
+                {
+                    on_resolve(std::move(result));
+                }
+            };
+            return Call::from_thread(spawn(store, resolve(body(store, std::move(caller), std::move(args)), std::move(on_resolve)), true));
+        };
+    }
+
+    //  Awaiters ---
+
+    class SuspendingAwaiter
+    {
+    protected:
+        template <typename P>
+        void bind(std::coroutine_handle<P> h)
+        {
+            ctx_ = h.promise().context();
+            if (!ctx_ || !ctx_->thread)
+            {
+                throw std::logic_error("coroutine is not running on a runtime thread");
+            }
+            ctx_->leaf = h;
+        }
+
+        template <typename P>
+        bool suspend(std::coroutine_handle<P> h, Thread::ReadyFn ready, bool cancellable, bool force_yield = false)
+        {
+            bind(h);
+            return !ctx_->thread->suspend_until(std::move(ready), cancellable, force_yield);
+        }
+
+        //  Parks the Thread and hands its waker to subscribe, so the Store
+        //  sleeps instead of polling ready.  ready is re-checked once the waker
+        //  is registered, for an event that fired in between.
+        template <typename P, typename Ready, typename Subscribe>
+        bool park(std::coroutine_handle<P> h, Ready ready, bool cancellable, Subscribe subscribe)
+        {
+            bind(h);
+            auto waker = ctx_->thread->park(cancellable, ready);
+            subscribe(waker);
+            if (ready())
+            {
+                waker();
+            }
+            return true;
+        }
+
+        bool was_cancelled() const
+        {
+            return ctx_ && ctx_->cancelled;
+        }
+
+        CoroutineContext *ctx_ = nullptr;
+    };
+
+    //  co_await await_yield(cancellable) ~ canon_thread_yield
+    class YieldAwaiter : public SuspendingAwaiter
+    {
+    public:
+        explicit YieldAwaiter(bool cancellable) : cancellable_(cancellable) {}
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        template <typename P>
+        bool await_suspend(std::coroutine_handle<P> h)
+        {
+            CMCPP_SCHED_RECORD(record_suspend(SuspendReason::Yield);)
+            return suspend(h, nullptr, cancellable_, true);
+        }
+
+        SuspendResult await_resume() const
+        {
+            return (cancellable_ && was_cancelled()) ? SuspendResult::CANCELLED : SuspendResult::NOT_CANCELLED;
+        }
+
+    private:
+        bool cancellable_;
+    };
+
+    inline YieldAwaiter await_yield(bool cancellable = false)
+    {
+        return YieldAwaiter(cancellable);
+    }
+
+    //  co_await await_sleep_until(deadline, cancellable) ~ canon_thread_sleep_until
+    class SleepAwaiter : public SuspendingAwaiter
+    {
+    public:
+        SleepAwaiter(std::optional<TimePoint> deadline, Clock::duration delay, bool cancellable)
+            : deadline_(deadline), delay_(delay), cancellable_(cancellable) {}
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        template <typename P>
+        bool await_suspend(std::coroutine_handle<P> h)
+        {
+            ctx_ = h.promise().context();
+            if (!ctx_ || !ctx_->thread)
+            {
+                throw std::logic_error("coroutine is not running on a runtime thread");
+            }
+            ctx_->leaf = h;
+            auto deadline = deadline_ ? *deadline_ : ctx_->thread->store().now() + delay_;
+            CMCPP_SCHED_RECORD(record_suspend(SuspendReason::Sleep);)
+            return !ctx_->thread->suspend_until_deadline(deadline, cancellable_);
+        }
+
+        SuspendResult await_resume() const
+        {
+            return (cancellable_ && was_cancelled()) ? SuspendResult::CANCELLED : SuspendResult::NOT_CANCELLED;
+        }
+
+    private:
+        std::optional<TimePoint> deadline_;
+        Clock::duration delay_;
+        bool cancellable_;
+    };
+
+    inline SleepAwaiter await_sleep_until(TimePoint deadline, bool cancellable = false)
+    {
+        return SleepAwaiter(deadline, {}, cancellable);
+    }
+
+    inline SleepAwaiter await_sleep_for(Clock::duration delay, bool cancellable = false)
+    {
+        return SleepAwaiter(std::nullopt, delay, cancellable);
+    }
+
+    //  Resumes once the Thread is rescheduled by whatever already called
+    //  suspend_until on it (e.g. Task::enter).  Yields true if cancelled.
+    class RescheduleAwaiter : public SuspendingAwaiter
+    {
+    public:
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        template <typename P>
+        bool await_suspend(std::coroutine_handle<P> h)
+        {
+            ctx_ = h.promise().context();
+            if (!ctx_ || !ctx_->thread)
+            {
+                throw std::logic_error("coroutine is not running on a runtime thread");
+            }
+            ctx_->leaf = h;
+            return true;
+        }
+
+        bool await_resume() const
+        {
+            return was_cancelled();
+        }
+    };
+
+    //  co_await await_enter(task, trap) ~ Task::enter with backpressure.
+    //  Resolves to false if the caller was cancelled while waiting.
+    inline task<bool> await_enter(Task &t, HostTrap trap)
+    {
+        while (!t.enter(trap))
+        {
+            if (t.state() == Task::State::Resolved)
+            {
+                co_return false;
+            }
+            bool cancelled = co_await RescheduleAwaiter{};
+            if (cancelled)
+            {
+                co_return false;
+            }
+        }
+        co_return true;
+    }
+
+    //  co_await await_waitable_set(inst, set, cancellable, trap) ~ canon_waitable_set_wait
+    class WaitableSetAwaiter : public SuspendingAwaiter
+    {
+    public:
+        WaitableSetAwaiter(ComponentInstance &inst, uint32_t set_index, bool cancellable, HostTrap trap)
+            : cancellable_(cancellable), trap_(std::move(trap))
+        {
+            ensure_may_leave(inst, trap_);
+            wset_ = inst.table.get<WaitableSet>(set_index, trap_);
+        }
+
+        bool await_ready() const
+        {
+            return wset_->has_pending_event();
+        }
+
+        template <typename P>
+        bool await_suspend(std::coroutine_handle<P> h)
+        {
+            wset_->begin_wait();
+            waiting_ = true;
+            CMCPP_SCHED_RECORD(record_suspend(SuspendReason::WaitableSetWait);)
+            auto *wset = wset_.get();
+            return park(
+                h, [wset]()
+                { return wset->has_pending_event(); },
+                cancellable_, [wset](const ThreadWaker &waker)
+                { wset->add_waker(waker); });
+        }
+
+        Event await_resume()
+        {
+            if (waiting_)
+            {
+                wset_->end_wait();
+                waiting_ = false;
+            }
+            if (cancellable_ && was_cancelled() && !wset_->has_pending_event())
+            {
+                return {EventCode::TASK_CANCELLED, 0, 0};
+            }
+            return wset_->take_pending_event(trap_);
+        }
+
+    private:
+        std::shared_ptr<WaitableSet> wset_;
+        bool cancellable_;
+        bool waiting_ = false;
+        HostTrap trap_;
+    };
+
+    inline WaitableSetAwaiter await_waitable_set(ComponentInstance &inst, uint32_t set_index, bool cancellable, HostTrap trap)
+    {
+        return WaitableSetAwaiter(inst, set_index, cancellable, std::move(trap));
+    }
+
+    //  Shared shape of the copy awaiters: issue the async canon call up front and,
+    //  if it blocked, suspend until the end posts its completion event.
+    template <typename End>
+    class CopyAwaiter : public SuspendingAwaiter
+    {
+    public:
+        bool await_ready() const
+        {
+            return result_ != BLOCKED || end_->has_pending_event();
+        }
+
+        template <typename P>
+        bool await_suspend(std::coroutine_handle<P> h)
+        {
+            auto *end = end_.get();
+            CMCPP_SCHED_RECORD(record_suspend(std::is_same_v<End, ReadableFutureEnd> ? SuspendReason::FutureWait : SuspendReason::StreamWait);)
+            return park(
+                h, [end]()
+                { return end->has_pending_event(); },
+                false, [end](const ThreadWaker &waker)
+                { end->add_waker(waker); });
+        }
+
+        uint32_t await_resume()
+        {
+            if (result_ == BLOCKED)
+            {
+                result_ = end_->get_pending_event(trap_).payload;
+            }
+            return result_;
+        }
+
+    protected:
+        explicit CopyAwaiter(HostTrap trap) : trap_(std::move(trap)) {}
+
+        static void require_async(const std::shared_ptr<LiftLowerContext> &cx, const HostTrap &trap)
+        {
+            auto trap_cx = make_trap_context(trap);
+            trap_if(trap_cx, !cx, "lift/lower context required");
+            trap_if(trap_cx, cx->is_sync(), "coroutine copy requires async canonical options");
+        }
+
+        std::shared_ptr<End> end_;
+        uint32_t result_ = BLOCKED;
+        HostTrap trap_;
+    };
+
+    class StreamReadAwaiter : public CopyAwaiter<ReadableStreamEnd>
+    {
+    public:
+        StreamReadAwaiter(ComponentInstance &inst, const StreamDescriptor &descriptor, uint32_t readable_index, const std::shared_ptr<LiftLowerContext> &cx, uint32_t ptr, uint32_t n, HostTrap trap)
+            : CopyAwaiter(std::move(trap))
+        {
+            require_async(cx, trap_);
+            result_ = canon_stream_read(inst, descriptor, readable_index, cx, ptr, n, false, trap_);
+            end_ = inst.table.get<ReadableStreamEnd>(readable_index, trap_);
+        }
+    };
+
+    class StreamWriteAwaiter : public CopyAwaiter<WritableStreamEnd>
+    {
+    public:
+        StreamWriteAwaiter(ComponentInstance &inst, const StreamDescriptor &descriptor, uint32_t writable_index, const std::shared_ptr<LiftLowerContext> &cx, uint32_t ptr, uint32_t n, HostTrap trap)
+            : CopyAwaiter(std::move(trap))
+        {
+            require_async(cx, trap_);
+            result_ = canon_stream_write(inst, descriptor, writable_index, cx, ptr, n, trap_);
+            end_ = inst.table.get<WritableStreamEnd>(writable_index, trap_);
+        }
+    };
+
+    class FutureReadAwaiter : public CopyAwaiter<ReadableFutureEnd>
+    {
+    public:
+        FutureReadAwaiter(ComponentInstance &inst, const FutureDescriptor &descriptor, uint32_t readable_index, const std::shared_ptr<LiftLowerContext> &cx, uint32_t ptr, HostTrap trap)
+            : CopyAwaiter(std::move(trap))
+        {
+            require_async(cx, trap_);
+            result_ = canon_future_read(inst, descriptor, readable_index, cx, ptr, false, trap_);
+            end_ = inst.table.get<ReadableFutureEnd>(readable_index, trap_);
+        }
+    };
+
+    //  co_await await_stream_read(...) ~ canon_stream_read; yields the packed copy result.
+    inline StreamReadAwaiter await_stream_read(ComponentInstance &inst, const StreamDescriptor &descriptor, uint32_t readable_index, const std::shared_ptr<LiftLowerContext> &cx, uint32_t ptr, uint32_t n, HostTrap trap)
+    {
+        return StreamReadAwaiter(inst, descriptor, readable_index, cx, ptr, n, std::move(trap));
+    }
+
+    //  co_await await_stream_write(...) ~ canon_stream_write; yields the packed copy result.
+    inline StreamWriteAwaiter await_stream_write(ComponentInstance &inst, const StreamDescriptor &descriptor, uint32_t writable_index, const std::shared_ptr<LiftLowerContext> &cx, uint32_t ptr, uint32_t n, HostTrap trap)
+    {
+        return StreamWriteAwaiter(inst, descriptor, writable_index, cx, ptr, n, std::move(trap));
+    }
+
+    //  co_await await_future_read(...) ~ canon_future_read; yields the CopyResult code.
+    inline FutureReadAwaiter await_future_read(ComponentInstance &inst, const FutureDescriptor &descriptor, uint32_t readable_index, const std::shared_ptr<LiftLowerContext> &cx, uint32_t ptr, HostTrap trap)
+    {
+        return FutureReadAwaiter(inst, descriptor, readable_index, cx, ptr, std::move(trap));
+    }
+}
+
+#endif
@@ -7,11 +7,13 @@
 
 namespace cmcpp
 {
-    class ErrorContext : public TableEntry
+    class ErrorContext final : public TableEntry
     {
     public:
+        static constexpr EntryKind KIND = EntryKind::ErrorContext;
+
         explicit ErrorContext(string_t message)
-            : debug_message_(std::move(message))
+            : TableEntry(KIND), debug_message_(std::move(message))
         {
         }
 
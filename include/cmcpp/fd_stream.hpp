@@ -0,0 +1,174 @@
+#ifndef CMCPP_FD_STREAM_HPP
+#define CMCPP_FD_STREAM_HPP
+
+#include "host_stream.hpp"
+#include "reactor.hpp"
+
+#include <fcntl.h>
+
+//  Host stream endpoints that connect a stream<u8> to a file descriptor.
+//
+//  fd_stream_sink() gives the guest a writable end whose copies go out with
+//  write(2) straight from guest linear memory; fd_stream_source() gives it a
+//  readable end filled with read(2) straight into the guest buffer.  No bytes
+//  are staged on the host.  When a non-blocking descriptor would block, the
+//  endpoint arms itself one-shot on the Reactor and the guest copy stays
+//  parked until the Store's poll finds the descriptor ready.  With a reactor
+//  the descriptor must be O_NONBLOCK: copies run under the stream's mutex, so
+//  a blocking one would stall the Store.  Blocking descriptors only suit
+//  regular files, which never wait and take a null reactor.  With an offset
+//  the copies use pread/pwrite from that position instead of the
+//  descriptor's own.
+//  Writing to a pipe whose reader has gone raises SIGPIPE unless the host
+//  ignores it; the failed write then ends the stream.
+
+#if defined(CMCPP_HAS_REACTOR)
+#define CMCPP_HAS_FD_STREAM 1
+
+namespace cmcpp
+{
+    class FdStreamEndpoint : public HostStreamEndpoint, public ReactorSource
+    {
+    public:
+        //  reactor may be null for regular files, which never return EAGAIN.
+        FdStreamEndpoint(const std::shared_ptr<SharedStreamState> &shared, std::shared_ptr<Reactor> reactor, int fd, off_t offset)
+            : ReactorSource(std::move(reactor), fd), shared_(shared), offset_(offset)
+        {
+        }
+
+        //  End of file (source) or a failed copy; error() is 0 on end of file.
+        bool finished() const override
+        {
+            return finished_;
+        }
+
+        int error() const
+        {
+            return error_;
+        }
+
+        //  Next file position used by pread/pwrite, or -1.
+        off_t offset() const
+        {
+            return offset_;
+        }
+
+        void set_waiting(bool) override {}
+
+        void peer_dropped() override {}
+
+    protected:
+        //  Copies through io until it makes progress, would block or fails.
+        template <typename Io>
+        uint32_t io_transfer(BufferGuestImpl &guest, uint32_t interest, Io io)
+        {
+            auto window = guest.remaining_bytes();
+            if (finished_ || window.empty())
+            {
+                return 0;
+            }
+            ssize_t n;
+            do
+            {
+                n = io(window);
+            } while (n < 0 && errno == EINTR);
+            if (n > 0)
+            {
+                if (offset_ >= 0)
+                {
+                    offset_ += n;
+                }
+                guest.advance(static_cast<uint32_t>(n));
+                return static_cast<uint32_t>(n);
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && reactor_)
+            {
+                if (!armed())
+                {
+                    arm_events(interest);
+                }
+                return 0;
+            }
+            finished_ = true;
+            error_ = n < 0 ? errno : 0;
+            return 0;
+        }
+
+    private:
+        //  Runs on the thread polling the reactor.
+        void dispatch(uint32_t) override
+        {
+            if (auto shared = shared_.lock())
+            {
+                std::scoped_lock<std::mutex> lock(shared->mu);
+                shared->pump_host_locked();
+            }
+        }
+
+        std::weak_ptr<SharedStreamState> shared_;
+        off_t offset_;
+        bool finished_ = false;
+        int error_ = 0;
+    };
+
+    //  Drains guest writes into fd.
+    class FdStreamSink final : public FdStreamEndpoint
+    {
+    public:
+        using FdStreamEndpoint::FdStreamEndpoint;
+
+        uint32_t transfer(BufferGuestImpl &guest) override
+        {
+            return io_transfer(guest, EPOLLOUT, [this](std::span<uint8_t> bytes)
+                               { return offset() >= 0 ? ::pwrite(fd(), bytes.data(), bytes.size(), offset())
+                                                      : ::write(fd(), bytes.data(), bytes.size()); });
+        }
+    };
+
+    //  Fills guest reads from fd; end of file drops the stream.
+    class FdStreamSource final : public FdStreamEndpoint
+    {
+    public:
+        using FdStreamEndpoint::FdStreamEndpoint;
+
+        uint32_t transfer(BufferGuestImpl &guest) override
+        {
+            return io_transfer(guest, EPOLLIN, [this](std::span<uint8_t> bytes)
+                               { return offset() >= 0 ? ::pread(fd(), bytes.data(), bytes.size(), offset())
+                                                      : ::read(fd(), bytes.data(), bytes.size()); });
+        }
+    };
+
+    namespace fd_stream
+    {
+        inline void check_descriptor(const StreamDescriptor &descriptor, int fd, const Reactor *reactor, const HostTrap &trap)
+        {
+            auto trap_cx = make_trap_context(trap);
+            trap_if(trap_cx, descriptor.element_size != 1, "fd streams carry u8 elements");
+            if (reactor)
+            {
+                int flags = ::fcntl(fd, F_GETFL);
+                trap_if(trap_cx, flags < 0, "fd stream descriptor is not open");
+                trap_if(trap_cx, (flags & O_NONBLOCK) == 0, "fd stream with a reactor needs O_NONBLOCK");
+            }
+        }
+    }
+
+    //  Creates a stream the guest writes into fd; index is the guest's writable end.
+    inline HostStream<FdStreamSink> fd_stream_sink(ComponentInstance &inst, const StreamDescriptor &descriptor, int fd, std::shared_ptr<Reactor> reactor, const HostTrap &trap, off_t offset = -1)
+    {
+        fd_stream::check_descriptor(descriptor, fd, reactor.get(), trap);
+        return host_stream::open<FdStreamSink, WritableStreamEnd>(inst, descriptor, trap, std::move(reactor), fd, offset);
+    }
+
+    //  Creates a stream the guest reads from fd; index is the guest's readable end.
+    inline HostStream<FdStreamSource> fd_stream_source(ComponentInstance &inst, const StreamDescriptor &descriptor, int fd, std::shared_ptr<Reactor> reactor, const HostTrap &trap, off_t offset = -1)
+    {
+        fd_stream::check_descriptor(descriptor, fd, reactor.get(), trap);
+        return host_stream::open<FdStreamSource, ReadableStreamEnd>(inst, descriptor, trap, std::move(reactor), fd, offset);
+    }
+}
+
+#endif
+
+#endif
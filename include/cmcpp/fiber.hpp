@@ -0,0 +1,179 @@
+#ifndef CMCPP_FIBER_HPP
+#define CMCPP_FIBER_HPP
+
+#include "context.hpp"
+
+//  Stackful fiber backend for the cooperative runtime.
+//
+//  Each fiber runs ordinary synchronous code on its own stack, bound to a runtime
+//  Thread.  While it runs, a Suspender is installed so that canonical sync waits
+//  (stream/future reads and writes that cannot complete yet) park the Thread and
+//  switch back to Store::tick() instead of blocking the OS thread.  A Store that
+//  drives fibers must be ticked from a single OS thread.
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+#define CMCPP_HAS_FIBERS 1
+
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <new>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+namespace cmcpp
+{
+    class Fiber : public Suspender
+    {
+    public:
+        static constexpr std::size_t DEFAULT_STACK_SIZE = 256 * 1024;
+
+        explicit Fiber(std::function<void()> body, std::size_t stack_size = DEFAULT_STACK_SIZE) : body_(std::move(body))
+        {
+            std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+            stack_size = (stack_size + page - 1) & ~(page - 1);
+            mapped_ = stack_size + page;
+            stack_ = ::mmap(nullptr, mapped_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+            if (stack_ == MAP_FAILED)
+            {
+                throw std::bad_alloc();
+            }
+            //  Guard page below the stack turns an overflow into a fault.
+            ::mprotect(stack_, page, PROT_NONE);
+
+            ::getcontext(&context_);
+            context_.uc_stack.ss_sp = static_cast<char *>(stack_) + page;
+            context_.uc_stack.ss_size = stack_size;
+            context_.uc_link = &caller_;
+            auto bits = reinterpret_cast<std::uintptr_t>(this);
+            ::makecontext(&context_, reinterpret_cast<void (*)()>(&Fiber::entry), 2,
+                          static_cast<unsigned>(bits & 0xFFFF'FFFFu), static_cast<unsigned>(bits >> 32));
+        }
+
+        Fiber(const Fiber &) = delete;
+        Fiber &operator=(const Fiber &) = delete;
+
+        //  A fiber dropped while suspended does not unwind its stack.
+        ~Fiber()
+        {
+            ::munmap(stack_, mapped_);
+        }
+
+        void bind(Thread *thread)
+        {
+            thread_ = thread;
+        }
+
+        //  Runs the fiber until it finishes or parks in wait_until().  Returns true
+        //  while the fiber still has work left.
+        bool resume()
+        {
+            auto *outer = current_suspender();
+            current_suspender() = this;
+            ::swapcontext(&caller_, &context_);
+            current_suspender() = outer;
+            if (finished_ && exception_)
+            {
+                std::rethrow_exception(std::exchange(exception_, nullptr));
+            }
+            return !finished_;
+        }
+
+        bool finished() const
+        {
+            return finished_;
+        }
+
+        void wait_until(Thread::ReadyFn ready) override
+        {
+            if (thread_->suspend_until(std::move(ready), false))
+            {
+                return;
+            }
+            ::swapcontext(&context_, &caller_);
+        }
+
+        void park_until(Thread::ReadyFn ready, const std::function<void(const ThreadWaker &)> &subscribe) override
+        {
+            while (!ready())
+            {
+                auto waker = thread_->park(false);
+                subscribe(waker);
+                if (ready())
+                {
+                    waker();
+                }
+                ::swapcontext(&context_, &caller_);
+            }
+        }
+
+    private:
+        static void entry(unsigned lo, unsigned hi)
+        {
+            auto *self = reinterpret_cast<Fiber *>(static_cast<std::uintptr_t>(lo) | (static_cast<std::uintptr_t>(hi) << 32));
+            try
+            {
+                self->body_();
+            }
+            catch (...)
+            {
+                self->exception_ = std::current_exception();
+            }
+            self->body_ = nullptr;
+            self->finished_ = true;
+        }
+
+        std::function<void()> body_;
+        ucontext_t context_{};
+        ucontext_t caller_{};
+        void *stack_ = nullptr;
+        std::size_t mapped_ = 0;
+        Thread *thread_ = nullptr;
+        bool finished_ = false;
+        std::exception_ptr exception_;
+    };
+
+    //  Starts body on a new fiber-backed runtime Thread.
+    inline std::shared_ptr<Thread> spawn_fiber(Store &store, std::function<void()> body, std::size_t stack_size = Fiber::DEFAULT_STACK_SIZE)
+    {
+        auto fiber = std::make_unique<Fiber>(std::move(body), stack_size);
+        auto *raw = fiber.get();
+        auto thread = Thread::create(
+            store,
+            nullptr,
+            [fiber = std::move(fiber)](bool) mutable
+            {
+                return fiber->resume();
+            });
+        raw->bind(thread.get());
+        return thread;
+    }
+
+    //  Wraps a synchronous body as a FuncInst running on its own fiber.  Returning
+    //  std::nullopt resolves the call as cancelled, mirroring OnResolve.
+    template <typename F>
+    FuncInst make_fiber_func(F body, std::size_t stack_size = Fiber::DEFAULT_STACK_SIZE)
+    {
+        return [body = std::move(body), stack_size](Store &store, SupertaskPtr caller, OnStart on_start, OnResolve on_resolve) -> Call
+        {
+            auto args = on_start ? on_start() : std::vector<std::any>{};
+            auto thread = spawn_fiber(
+                store,
+                [&store, body, caller = std::move(caller), args = std::move(args), on_resolve = std::move(on_resolve)]() mutable
+                {
+                    auto result = body(store, std::move(caller), std::move(args));
+                    if (on_resolve)
+                    {
+                        on_resolve(std::move(result));
+                    }
+                },
+                stack_size);
+            return Call::from_thread(thread);
+        };
+    }
+}
+
+#endif
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef CMCPP_HANDLE_HPP
+#define CMCPP_HANDLE_HPP
+
+#include <cstring>
+
+#include "context.hpp"
+#include "util.hpp"
+
+namespace cmcpp
+{
+    namespace handle
+    {
+        inline ComponentInstance &instance(const LiftLowerContext &cx)
+        {
+            trap_if(cx, cx.inst == nullptr, "handle transfer requires a component instance");
+            return *cx.inst;
+        }
+
+        //  Takes the handle out of the instance's table; the host now owns rep.
+        template <Own T>
+        T lift_own(const LiftLowerContext &cx, uint32_t index)
+        {
+            auto &rt = ValTrait<T>::inner_type::resource_type();
+            auto element = instance(cx).handles.remove(rt, index, cx.trap);
+            trap_if(cx, element.lend_count != 0, "resource has outstanding lends");
+            trap_if(cx, !element.own, "own handle expected");
+            return T{element.rep};
+        }
+
+        //  Borrowing an owned handle lends it for the duration of the call.
+        template <Borrow T>
+        T lift_borrow(const LiftLowerContext &cx, uint32_t index)
+        {
+            auto &rt = ValTrait<T>::inner_type::resource_type();
+            auto &table = instance(cx).handles.table(rt);
+            auto element = table.get(index, cx.trap);
+            if (element.own)
+            {
+                cx.track_owning_lend(table, index);
+            }
+            return T{element.rep};
+        }
+
+        template <Own T>
+        uint32_t lower_own(LiftLowerContext &cx, const T &v)
+        {
+            auto &rt = ValTrait<T>::inner_type::resource_type();
+            HandleElement element;
+            element.rep = v.rep;
+            element.own = true;
+            return instance(cx).handles.add(rt, element, cx.trap);
+        }
+
+        //  A borrow lowered into the instance that implements the resource is
+        //  passed as the rep itself; no handle is created.
+        template <Borrow T>
+        uint32_t lower_borrow(LiftLowerContext &cx, const T &v)
+        {
+            auto &rt = ValTrait<T>::inner_type::resource_type();
+            auto &inst = instance(cx);
+            if (&inst == rt.impl)
+            {
+                return v.rep;
+            }
+            HandleElement element;
+            element.rep = v.rep;
+            element.scope = &cx;
+            uint32_t index = inst.handles.add(rt, element, cx.trap);
+            cx.borrow_count += 1;
+            return index;
+        }
+
+        inline uint32_t load_index(const LiftLowerContext &cx, uint32_t ptr)
+        {
+            uint32_t index;
+            std::memcpy(&index, &cx.opts.memory[ptr], sizeof(index));
+            return index;
+        }
+
+        inline void store_index(LiftLowerContext &cx, uint32_t index, uint32_t ptr)
+        {
+            std::memcpy(&cx.opts.memory[ptr], &index, sizeof(index));
+        }
+    }
+
+    template <Own T>
+    inline void store(LiftLowerContext &cx, const T &v, uint32_t ptr)
+    {
+        handle::store_index(cx, handle::lower_own(cx, v), ptr);
+    }
+
+    template <Own T>
+    inline WasmValVector lower_flat(LiftLowerContext &cx, const T &v)
+    {
+        return {static_cast<int32_t>(handle::lower_own(cx, v))};
+    }
+
+    template <Own T>
+    inline T load(const LiftLowerContext &cx, uint32_t ptr)
+    {
+        return handle::lift_own<T>(cx, handle::load_index(cx, ptr));
+    }
+
+    template <Own T>
+    inline T lift_flat(const LiftLowerContext &cx, const CoreValueIter &vi)
+    {
+        return handle::lift_own<T>(cx, static_cast<uint32_t>(vi.next<int32_t>()));
+    }
+
+    template <Borrow T>
+    inline void store(LiftLowerContext &cx, const T &v, uint32_t ptr)
+    {
+        handle::store_index(cx, handle::lower_borrow(cx, v), ptr);
+    }
+
+    template <Borrow T>
+    inline WasmValVector lower_flat(LiftLowerContext &cx, const T &v)
+    {
+        return {static_cast<int32_t>(handle::lower_borrow(cx, v))};
+    }
+
+    template <Borrow T>
+    inline T load(const LiftLowerContext &cx, uint32_t ptr)
+    {
+        return handle::lift_borrow<T>(cx, handle::load_index(cx, ptr));
+    }
+
+    template <Borrow T>
+    inline T lift_flat(const LiftLowerContext &cx, const CoreValueIter &vi)
+    {
+        return handle::lift_borrow<T>(cx, static_cast<uint32_t>(vi.next<int32_t>()));
+    }
+}
+
+#endif
@@ -0,0 +1,189 @@
+#ifndef CMCPP_HOST_RESOURCE_HPP
+#define CMCPP_HOST_RESOURCE_HPP
+
+#include "context.hpp"
+
+//  Typed registry for host-implemented resources.
+//
+//  HostResource<T> owns a ResourceType and the T objects behind its handles.
+//  Objects live in fixed-size slabs and the slab index is the resource's rep,
+//  so resolving a handle is a table lookup plus an array index, and dropping
+//  the last own handle runs ~T through the type's destructor.  Slabs never
+//  move, so a T& stays valid until its resource is destroyed.  A HostResource
+//  must outlive the handles create() made: drop them or reset their instances
+//  first.  Handle tables find the type by id, so a table outliving it skips
+//  the destructor rather than calling into a freed HostResource.
+
+#include <cassert>
+#include <new>
+
+namespace cmcpp
+{
+    template <typename T>
+    class HostResource
+    {
+    public:
+        static constexpr uint32_t SLAB_BITS = 8;
+        static constexpr uint32_t SLAB_SIZE = 1u << SLAB_BITS;
+
+        explicit HostResource(ComponentInstance &impl) : type_(impl)
+        {
+            type_.dtor = [this](uint32_t rep)
+            {
+                destroy(rep);
+            };
+            type_.dtor_batch = [this](std::span<const uint32_t> reps)
+            {
+                for (uint32_t rep : reps)
+                {
+                    destroy(rep);
+                }
+            };
+        }
+
+        //  The ResourceType callbacks refer to this object.
+        HostResource(const HostResource &) = delete;
+        HostResource &operator=(const HostResource &) = delete;
+
+        ~HostResource()
+        {
+            for (uint32_t rep = 0; rep < live_.size(); ++rep)
+            {
+                if (live_[rep])
+                {
+                    assert(!(live_[rep] & HANDLED) && "HostResource destroyed while a handle to it is live");
+                    cell(rep)->~T();
+                }
+            }
+        }
+
+        ResourceType &type()
+        {
+            return type_;
+        }
+
+        //  Constructs a T and returns its rep without creating a handle.
+        template <typename... Args>
+        uint32_t allocate(Args &&...args)
+        {
+            uint32_t rep;
+            if (!free_.empty())
+            {
+                rep = free_.back();
+                free_.pop_back();
+            }
+            else
+            {
+                rep = static_cast<uint32_t>(live_.size());
+                if ((rep & (SLAB_SIZE - 1)) == 0)
+                {
+                    slabs_.push_back(std::make_unique<Cell[]>(SLAB_SIZE));
+                }
+                live_.push_back(0);
+            }
+            try
+            {
+                ::new (static_cast<void *>(cell(rep))) T(std::forward<Args>(args)...);
+            }
+            catch (...)
+            {
+                free_.push_back(rep);
+                throw;
+            }
+            live_[rep] = LIVE;
+            count_ += 1;
+            return rep;
+        }
+
+        //  Constructs a T and returns a new own handle to it in inst.
+        template <typename... Args>
+        uint32_t create(ComponentInstance &inst, const HostTrap &trap, Args &&...args)
+        {
+            uint32_t rep = allocate(std::forward<Args>(args)...);
+            try
+            {
+                uint32_t handle = canon_resource_new(inst, type_, rep, trap);
+                live_[rep] |= HANDLED;
+                return handle;
+            }
+            catch (...)
+            {
+                destroy(rep);
+                throw;
+            }
+        }
+
+        //  Resolves a handle of this type in inst.
+        T &get(const ComponentInstance &inst, uint32_t handle, const HostTrap &trap)
+        {
+            return at(inst.handles.rep(type_, handle, trap), trap);
+        }
+
+        void drop(ComponentInstance &inst, uint32_t handle, const HostTrap &trap)
+        {
+            canon_resource_drop(inst, type_, handle, trap);
+        }
+
+        T &at(uint32_t rep, const HostTrap &trap)
+        {
+            auto *object = find(rep);
+            if (!object)
+            {
+                auto trap_cx = make_trap_context(trap);
+                trap_if(trap_cx, true, "host resource rep invalid");
+                throw std::logic_error("host resource rep invalid");
+            }
+            return *object;
+        }
+
+        T *find(uint32_t rep)
+        {
+            return rep < live_.size() && live_[rep] ? cell(rep) : nullptr;
+        }
+
+        void destroy(uint32_t rep)
+        {
+            if (rep >= live_.size() || !live_[rep])
+            {
+                return;
+            }
+            live_[rep] = 0;
+            count_ -= 1;
+            free_.push_back(rep);
+            cell(rep)->~T();
+        }
+
+        std::size_t size() const
+        {
+            return count_;
+        }
+
+        std::size_t capacity() const
+        {
+            return slabs_.size() * SLAB_SIZE;
+        }
+
+    private:
+        static constexpr uint8_t LIVE = 1;
+        //  create() made an own handle that has not been dropped yet.
+        static constexpr uint8_t HANDLED = 2;
+
+        struct Cell
+        {
+            alignas(T) std::byte bytes[sizeof(T)];
+        };
+
+        T *cell(uint32_t rep)
+        {
+            return std::launder(reinterpret_cast<T *>(slabs_[rep >> SLAB_BITS][rep & (SLAB_SIZE - 1)].bytes));
+        }
+
+        ResourceType type_;
+        std::vector<std::unique_ptr<Cell[]>> slabs_;
+        std::vector<uint8_t> live_;
+        std::vector<uint32_t> free_;
+        std::size_t count_ = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,374 @@
+#ifndef CMCPP_HOST_STREAM_HPP
+#define CMCPP_HOST_STREAM_HPP
+
+#include "context.hpp"
+
+//  Host-side stream endpoints backed by a single-producer/single-consumer ring.
+//
+//  host_stream_source() creates a stream whose readable end goes to the guest
+//  and whose writable end is a HostReadableBuffer: the host pushes batches of
+//  element bytes into the ring and guest reads copy straight out of it into
+//  guest memory.  host_stream_sink() is the mirror: guest writes land in a
+//  HostWritableBuffer's ring and the host pops them.  The host side needs no
+//  LiftLowerContext and takes no lock while the ring has room (or data).  The
+//  host thread only ever touches the ring: when a guest copy is parked on it,
+//  a host batch posts the guest-side copy and its completion to the
+//  instance's Store (or wakes a guest blocked in a sync copy to do it), so
+//  guest readiness events fire once per batch rather than once per element.
+//  Without a Store the completion runs on the host's thread, which is only
+//  safe when that is also the thread running the guest.  Each ring has one
+//  host thread at a time.
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+
+namespace cmcpp
+{
+    //  Lock-free ring of fixed-size elements; the capacity is rounded up to a
+    //  power of two.  push() and pop() each belong to a single thread.
+    class SpscRing
+    {
+    public:
+        SpscRing(uint32_t elem_size, std::size_t capacity)
+            : elem_size_(elem_size),
+              capacity_(std::bit_ceil(std::max<std::size_t>(capacity, 1))),
+              bytes_(std::make_unique<uint8_t[]>(capacity_ * elem_size))
+        {
+        }
+
+        //  Copies up to n elements in; returns the count accepted.
+        std::size_t push(const uint8_t *src, std::size_t n)
+        {
+            uint64_t tail = tail_.load(std::memory_order_relaxed);
+            uint64_t head = head_.load(std::memory_order_acquire);
+            n = std::min<std::size_t>(n, capacity_ - static_cast<std::size_t>(tail - head));
+            if (n > 0)
+            {
+                copy_in(static_cast<std::size_t>(tail) & (capacity_ - 1), src, n);
+                tail_.store(tail + n, std::memory_order_release);
+            }
+            return n;
+        }
+
+        //  Copies up to n elements out; returns the count taken.
+        std::size_t pop(uint8_t *dst, std::size_t n)
+        {
+            uint64_t head = head_.load(std::memory_order_relaxed);
+            uint64_t tail = tail_.load(std::memory_order_acquire);
+            n = std::min<std::size_t>(n, static_cast<std::size_t>(tail - head));
+            if (n > 0)
+            {
+                copy_out(static_cast<std::size_t>(head) & (capacity_ - 1), dst, n);
+                head_.store(head + n, std::memory_order_release);
+            }
+            return n;
+        }
+
+        std::size_t size() const
+        {
+            return static_cast<std::size_t>(tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire));
+        }
+
+        std::size_t capacity() const
+        {
+            return capacity_;
+        }
+
+        uint32_t elem_size() const
+        {
+            return elem_size_;
+        }
+
+    private:
+        //  At most two memcpys: up to the end of the storage, then from the start.
+        void copy_in(std::size_t at, const uint8_t *src, std::size_t n)
+        {
+            std::size_t first = std::min(n, capacity_ - at);
+            std::memcpy(&bytes_[at * elem_size_], src, first * elem_size_);
+            std::memcpy(&bytes_[0], src + first * elem_size_, (n - first) * elem_size_);
+        }
+
+        void copy_out(std::size_t at, uint8_t *dst, std::size_t n)
+        {
+            std::size_t first = std::min(n, capacity_ - at);
+            std::memcpy(dst, &bytes_[at * elem_size_], first * elem_size_);
+            std::memcpy(dst + first * elem_size_, &bytes_[0], (n - first) * elem_size_);
+        }
+
+        static constexpr std::size_t LINE = 64;
+
+        uint32_t elem_size_;
+        std::size_t capacity_;
+        std::unique_ptr<uint8_t[]> bytes_;
+        alignas(LINE) std::atomic<uint64_t> head_{0};
+        alignas(LINE) std::atomic<uint64_t> tail_{0};
+    };
+
+    //  State shared by every host end: close flags and the handshake that lets
+    //  a host batch find a parked guest copy without taking the lock.
+    class HostStreamPort : public HostStreamEndpoint
+    {
+    public:
+        using ReadyFn = std::function<void()>;
+
+        explicit HostStreamPort(const std::shared_ptr<SharedStreamState> &shared) : shared_(shared) {}
+
+        //  Called once per guest batch, on the guest's thread after the stream
+        //  mutex is released: space was freed (source) or elements arrived
+        //  (sink).  It may push or pop.
+        void set_on_ready(ReadyFn on_ready)
+        {
+            on_ready_ = std::move(on_ready);
+        }
+
+        //  Ends the stream from the host side; a guest copy parked on the ring
+        //  completes once the remaining elements are drained.
+        void close()
+        {
+            closed_.store(true, std::memory_order_release);
+            kick();
+        }
+
+        bool closed() const
+        {
+            return closed_.load(std::memory_order_acquire);
+        }
+
+        //  The guest dropped its end; later host batches are refused.
+        bool guest_dropped() const
+        {
+            return guest_dropped_.load(std::memory_order_acquire);
+        }
+
+        void set_waiting(bool waiting) override
+        {
+            waiting_.store(waiting, std::memory_order_relaxed);
+            //  Pairs with the fence in kick(): either the guest sees the
+            //  host's batch or the host sees the guest waiting.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+        void peer_dropped() override
+        {
+            guest_dropped_.store(true, std::memory_order_release);
+        }
+
+        void flush() override
+        {
+            if (ready_due_.exchange(false, std::memory_order_acq_rel) && on_ready_)
+            {
+                on_ready_();
+            }
+        }
+
+    protected:
+        //  After each host batch: have a parked guest copy, if any, completed.
+        void kick()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!waiting_.load(std::memory_order_relaxed))
+            {
+                return;
+            }
+            auto shared = shared_.lock();
+            if (!shared)
+            {
+                return;
+            }
+            if (!shared->host_store)
+            {
+                {
+                    std::scoped_lock<std::mutex> lock(shared->mu);
+                    shared->pump_host_locked();
+                }
+                shared->flush_host();
+                return;
+            }
+            //  One pump in flight covers every batch pushed before it runs.
+            if (!posted_.exchange(true, std::memory_order_acq_rel))
+            {
+                //  shared->host owns this port, so it lives as long as shared.
+                shared->host_store->post_completion([this, weak = shared_]()
+                                                    {
+                                                        if (auto shared = weak.lock())
+                                                        {
+                                                            posted_.store(false, std::memory_order_release);
+                                                            {
+                                                                std::scoped_lock<std::mutex> lock(shared->mu);
+                                                                shared->pump_host_locked();
+                                                            }
+                                                            shared->flush_host();
+                                                        } });
+            }
+            std::scoped_lock<std::mutex> lock(shared->mu);
+            shared->notify_all();
+        }
+
+        //  Runs under the stream mutex, where a push or pop would kick() and
+        //  retake it, so the callback waits for flush().
+        void ready()
+        {
+            ready_due_.store(true, std::memory_order_release);
+        }
+
+        std::weak_ptr<SharedStreamState> shared_;
+        ReadyFn on_ready_;
+        std::atomic<bool> waiting_{false};
+        std::atomic<bool> closed_{false};
+        std::atomic<bool> guest_dropped_{false};
+        std::atomic<bool> posted_{false};
+        std::atomic<bool> ready_due_{false};
+    };
+
+    class HostStreamRing : public HostStreamPort
+    {
+    public:
+        HostStreamRing(const std::shared_ptr<SharedStreamState> &shared, std::size_t capacity)
+            : HostStreamPort(shared), ring_(shared->descriptor.element_size, capacity)
+        {
+        }
+
+        std::size_t size() const
+        {
+            return ring_.size();
+        }
+
+        std::size_t capacity() const
+        {
+            return ring_.capacity();
+        }
+
+        uint32_t elem_size() const
+        {
+            return ring_.elem_size();
+        }
+
+    protected:
+        SpscRing ring_;
+    };
+
+    //  Host-written end of a stream the guest reads.
+    class HostReadableBuffer final : public HostStreamRing
+    {
+    public:
+        using HostStreamRing::HostStreamRing;
+
+        //  Pushes whole elements from bytes; returns the count accepted, which
+        //  is short when the ring is full.  Nothing is accepted after close()
+        //  or once the guest has dropped its end.
+        std::size_t push(std::span<const uint8_t> bytes)
+        {
+            if (closed() || guest_dropped())
+            {
+                return 0;
+            }
+            std::size_t pushed = ring_.push(bytes.data(), bytes.size() / ring_.elem_size());
+            if (pushed > 0)
+            {
+                kick();
+            }
+            return pushed;
+        }
+
+        uint32_t transfer(BufferGuestImpl &guest) override
+        {
+            auto window = guest.remaining_bytes();
+            auto moved = static_cast<uint32_t>(ring_.pop(window.data(), window.size() / ring_.elem_size()));
+            if (moved > 0)
+            {
+                guest.advance(moved);
+                ready();
+            }
+            return moved;
+        }
+
+        bool finished() const override
+        {
+            return closed() && ring_.size() == 0;
+        }
+    };
+
+    //  Host-read end of a stream the guest writes.
+    class HostWritableBuffer final : public HostStreamRing
+    {
+    public:
+        using HostStreamRing::HostStreamRing;
+
+        //  Pops up to dst.size() bytes of whole elements; returns the count taken.
+        std::size_t pop(std::span<uint8_t> dst)
+        {
+            std::size_t popped = ring_.pop(dst.data(), dst.size() / ring_.elem_size());
+            if (popped > 0)
+            {
+                kick();
+            }
+            return popped;
+        }
+
+        //  The guest dropped its end and every element it wrote has been popped.
+        bool drained() const
+        {
+            return guest_dropped() && ring_.size() == 0;
+        }
+
+        uint32_t transfer(BufferGuestImpl &guest) override
+        {
+            auto window = guest.remaining_bytes();
+            auto moved = static_cast<uint32_t>(ring_.push(window.data(), window.size() / ring_.elem_size()));
+            if (moved > 0)
+            {
+                guest.advance(moved);
+                ready();
+            }
+            return moved;
+        }
+
+        bool finished() const override
+        {
+            return closed();
+        }
+    };
+
+    template <typename Buffer>
+    struct HostStream
+    {
+        uint32_t index = 0;
+        std::shared_ptr<Buffer> buffer;
+    };
+
+    namespace host_stream
+    {
+        //  Creates a stream whose End goes to the guest and whose other end is a
+        //  Buffer constructed from (shared state, args...).
+        template <typename Buffer, typename End, typename... Args>
+        HostStream<Buffer> open(ComponentInstance &inst, const StreamDescriptor &descriptor, const HostTrap &trap, Args &&...args)
+        {
+            ensure_may_leave(inst, trap);
+            auto trap_cx = make_trap_context(trap);
+            trap_if(trap_cx, descriptor.element_size == 0, "stream descriptor invalid");
+            auto shared = std::make_shared<SharedStreamState>(descriptor);
+            auto buffer = std::make_shared<Buffer>(shared, std::forward<Args>(args)...);
+            shared->host = buffer;
+            shared->host_store = inst.store;
+            return {inst.table.add(std::make_shared<End>(shared), trap), std::move(buffer)};
+        }
+    }
+
+    //  Creates a stream the host writes through the returned ring; index is
+    //  the guest's readable end.
+    inline HostStream<HostReadableBuffer> host_stream_source(ComponentInstance &inst, const StreamDescriptor &descriptor, std::size_t capacity, const HostTrap &trap)
+    {
+        return host_stream::open<HostReadableBuffer, ReadableStreamEnd>(inst, descriptor, trap, capacity);
+    }
+
+    //  Creates a stream the host reads through the returned ring; index is
+    //  the guest's writable end.
+    inline HostStream<HostWritableBuffer> host_stream_sink(ComponentInstance &inst, const StreamDescriptor &descriptor, std::size_t capacity, const HostTrap &trap)
+    {
+        return host_stream::open<HostWritableBuffer, WritableStreamEnd>(inst, descriptor, trap, capacity);
+    }
+}
+
+#endif
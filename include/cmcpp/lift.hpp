@@ -43,6 +43,12 @@ namespace cmcpp
     template <Option T>
     inline T lift_flat(const LiftLowerContext &cx, const CoreValueIter &vi);
 
+    template <Own T>
+    inline T lift_flat(const LiftLowerContext &cx, const CoreValueIter &vi);
+
+    template <Borrow T>
+    inline T lift_flat(const LiftLowerContext &cx, const CoreValueIter &vi);
+
     template <Field T>
     inline T lift_heap_values(const LiftLowerContext &cx, const CoreValueIter &vi)
     {
@@ -37,6 +37,12 @@ namespace cmcpp
 
     template <Option T>
     inline T load(const LiftLowerContext &cx, uint32_t ptr);
+
+    template <Own T>
+    inline T load(const LiftLowerContext &cx, uint32_t ptr);
+
+    template <Borrow T>
+    inline T load(const LiftLowerContext &cx, uint32_t ptr);
 }
 
 #include "string.hpp"
@@ -8,6 +8,7 @@
 #include "list.hpp"
 #include "map.hpp"
 #include "flags.hpp"
+#include "handle.hpp"
 #include "tuple.hpp"
 #include "func.hpp"
 #include "util.hpp"
@@ -53,6 +54,12 @@ namespace cmcpp
     template <Option T>
     inline WasmValVector lower_flat(LiftLowerContext &cx, const T &v);
 
+    template <Own T>
+    inline WasmValVector lower_flat(LiftLowerContext &cx, const T &v);
+
+    template <Borrow T>
+    inline WasmValVector lower_flat(LiftLowerContext &cx, const T &v);
+
     template <Field... Ts>
     inline WasmValVector lower_heap_values(LiftLowerContext &cx, uint32_t *out_param, Ts &&...vs)
     {
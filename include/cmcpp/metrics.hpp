@@ -0,0 +1,173 @@
+#ifndef CMCPP_METRICS_HPP
+#define CMCPP_METRICS_HPP
+
+#include "timer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+
+//  Scheduler instrumentation, compiled in only when CMCPP_SCHED_METRICS is
+//  defined (CMake option CMCPP_SCHED_METRICS).  Without it the recording macro
+//  expands to nothing and none of the types below are declared.
+
+#ifdef CMCPP_SCHED_METRICS
+#define CMCPP_SCHED_RECORD(...) __VA_ARGS__
+#else
+#define CMCPP_SCHED_RECORD(...)
+#endif
+
+#ifdef CMCPP_SCHED_METRICS
+
+namespace cmcpp
+{
+    enum class SuspendReason : uint8_t
+    {
+        Backpressure = 0,
+        StreamWait,
+        FutureWait,
+        Yield,
+        WaitableSetWait,
+        Sleep,
+        COUNT
+    };
+
+    constexpr std::size_t SUSPEND_REASONS = static_cast<std::size_t>(SuspendReason::COUNT);
+
+    struct HistogramSnapshot
+    {
+        static constexpr std::size_t BUCKETS = 65;
+
+        //  Bucket i counts values in [2^(i-1), 2^i); bucket 0 counts zeros.
+        std::array<uint64_t, BUCKETS> buckets{};
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+
+        //  Upper bound of the bucket holding the q-quantile (0 < q <= 1).
+        uint64_t percentile(double q) const
+        {
+            if (count == 0)
+            {
+                return 0;
+            }
+            auto rank = static_cast<uint64_t>(q * static_cast<double>(count));
+            rank = rank == 0 ? 1 : rank;
+            uint64_t seen = 0;
+            for (std::size_t i = 0; i < BUCKETS; ++i)
+            {
+                seen += buckets[i];
+                if (seen >= rank)
+                {
+                    return i == 0 ? 0 : std::min(max, i >= 64 ? UINT64_MAX : (uint64_t{1} << i) - 1);
+                }
+            }
+            return max;
+        }
+
+        double mean() const
+        {
+            return count == 0 ? 0.0 : static_cast<double>(sum) / static_cast<double>(count);
+        }
+    };
+
+    //  Lock-free log2 histogram; record() is a handful of relaxed atomics.
+    class Histogram
+    {
+    public:
+        void record(uint64_t value)
+        {
+            buckets_[std::bit_width(value)].fetch_add(1, std::memory_order_relaxed);
+            count_.fetch_add(1, std::memory_order_relaxed);
+            sum_.fetch_add(value, std::memory_order_relaxed);
+            uint64_t prev = max_.load(std::memory_order_relaxed);
+            while (value > prev && !max_.compare_exchange_weak(prev, value, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        HistogramSnapshot snapshot() const
+        {
+            HistogramSnapshot snap;
+            for (std::size_t i = 0; i < HistogramSnapshot::BUCKETS; ++i)
+            {
+                snap.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+            }
+            snap.count = count_.load(std::memory_order_relaxed);
+            snap.sum = sum_.load(std::memory_order_relaxed);
+            snap.max = max_.load(std::memory_order_relaxed);
+            return snap;
+        }
+
+    private:
+        std::array<std::atomic<uint64_t>, HistogramSnapshot::BUCKETS> buckets_{};
+        std::atomic<uint64_t> count_{0};
+        std::atomic<uint64_t> sum_{0};
+        std::atomic<uint64_t> max_{0};
+    };
+
+    struct SchedulerSnapshot
+    {
+        //  Time from a thread being queued as pending to being resumed.
+        HistogramSnapshot queue_latency_ns;
+        HistogramSnapshot run_slice_ns;
+        //  Pending-queue length sampled once per tick.
+        HistogramSnapshot pending_depth;
+        std::array<uint64_t, SUSPEND_REASONS> suspensions{};
+        uint64_t ticks = 0;
+        uint64_t idle_ticks = 0;
+        uint64_t microtasks = 0;
+        uint64_t timers_fired = 0;
+
+        uint64_t suspended(SuspendReason reason) const
+        {
+            return suspensions[static_cast<std::size_t>(reason)];
+        }
+    };
+
+    class SchedulerMetrics
+    {
+    public:
+        Histogram queue_latency_ns;
+        Histogram run_slice_ns;
+        Histogram pending_depth;
+        std::array<std::atomic<uint64_t>, SUSPEND_REASONS> suspensions{};
+        std::atomic<uint64_t> ticks{0};
+        std::atomic<uint64_t> idle_ticks{0};
+        std::atomic<uint64_t> microtasks{0};
+        std::atomic<uint64_t> timers_fired{0};
+
+        void record_suspend(SuspendReason reason)
+        {
+            suspensions[static_cast<std::size_t>(reason)].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        SchedulerSnapshot snapshot() const
+        {
+            SchedulerSnapshot snap;
+            snap.queue_latency_ns = queue_latency_ns.snapshot();
+            snap.run_slice_ns = run_slice_ns.snapshot();
+            snap.pending_depth = pending_depth.snapshot();
+            for (std::size_t i = 0; i < SUSPEND_REASONS; ++i)
+            {
+                snap.suspensions[i] = suspensions[i].load(std::memory_order_relaxed);
+            }
+            snap.ticks = ticks.load(std::memory_order_relaxed);
+            snap.idle_ticks = idle_ticks.load(std::memory_order_relaxed);
+            snap.microtasks = microtasks.load(std::memory_order_relaxed);
+            snap.timers_fired = timers_fired.load(std::memory_order_relaxed);
+            return snap;
+        }
+    };
+
+    inline uint64_t metrics_now_ns()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count());
+    }
+}
+
+#endif
+
+#endif
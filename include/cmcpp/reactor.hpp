@@ -0,0 +1,229 @@
+#ifndef CMCPP_REACTOR_HPP
+#define CMCPP_REACTOR_HPP
+
+#include "context.hpp"
+
+//  epoll-backed host waitables.
+//
+//  A Reactor is installed on a Store with Store::set_poller and drained with a
+//  single epoll_wait at the start of every tick.  FdWaitable wraps a file
+//  descriptor (socket, pipe, eventfd, ...) registered one-shot with the reactor;
+//  readiness sets the waitable's pending event, which wakes any thread parked on
+//  its WaitableSet directly.  Regular files are not pollable through epoll.
+//  The reactor is wakeable: Store::run blocks in epoll_wait and an eventfd
+//  interrupts it when another OS thread posts work to the Store.  Anything
+//  else driven by descriptor readiness derives from ReactorSource.
+
+#if defined(__linux__)
+#define CMCPP_HAS_REACTOR 1
+
+#include <array>
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace cmcpp
+{
+    class ReactorSource;
+
+    class Reactor : public Poller
+    {
+    public:
+        static constexpr std::size_t MAX_EVENTS = 64;
+
+        Reactor() : epfd_(::epoll_create1(EPOLL_CLOEXEC))
+        {
+            if (epfd_ < 0)
+            {
+                throw std::system_error(errno, std::generic_category(), "epoll_create1");
+            }
+            wakefd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+            if (wakefd_ < 0)
+            {
+                int error = errno;
+                ::close(epfd_);
+                throw std::system_error(error, std::generic_category(), "eventfd");
+            }
+            //  A null data pointer marks the wake eventfd.
+            control(EPOLL_CTL_ADD, wakefd_, EPOLLIN, nullptr);
+        }
+
+        Reactor(const Reactor &) = delete;
+        Reactor &operator=(const Reactor &) = delete;
+
+        ~Reactor() override
+        {
+            ::close(wakefd_);
+            ::close(epfd_);
+        }
+
+        std::size_t poll(int timeout_ms) override;
+
+        bool wakeable() const override
+        {
+            return true;
+        }
+
+        void wake() override
+        {
+            uint64_t one = 1;
+            [[maybe_unused]] auto written = ::write(wakefd_, &one, sizeof(one));
+        }
+
+        std::size_t registered() const
+        {
+            return registered_;
+        }
+
+        int fd() const
+        {
+            return epfd_;
+        }
+
+    private:
+        friend class ReactorSource;
+
+        void control(int op, int fd, uint32_t events, void *data)
+        {
+            epoll_event ev{};
+            ev.events = events;
+            ev.data.ptr = data;
+            if (::epoll_ctl(epfd_, op, fd, &ev) != 0)
+            {
+                throw std::system_error(errno, std::generic_category(), "epoll_ctl");
+            }
+        }
+
+        int epfd_;
+        int wakefd_ = -1;
+        std::size_t registered_ = 0;
+        std::array<epoll_event, MAX_EVENTS> events_{};
+    };
+
+    //  A descriptor registered one-shot with a reactor.  The descriptor stays
+    //  owned by the host.  Each arm() delivers at most one dispatch(); re-arm
+    //  after consuming it.
+    class ReactorSource
+    {
+    public:
+        ReactorSource(std::shared_ptr<Reactor> reactor, int fd) : reactor_(std::move(reactor)), fd_(fd) {}
+
+        ReactorSource(const ReactorSource &) = delete;
+        ReactorSource &operator=(const ReactorSource &) = delete;
+
+        virtual ~ReactorSource()
+        {
+            if (added_)
+            {
+                ::epoll_ctl(reactor_->epfd_, EPOLL_CTL_DEL, fd_, nullptr);
+                reactor_->registered_ -= 1;
+            }
+        }
+
+        bool armed() const
+        {
+            return armed_;
+        }
+
+        int fd() const
+        {
+            return fd_;
+        }
+
+    protected:
+        void arm_events(uint32_t interest)
+        {
+            uint32_t events = interest | EPOLLONESHOT;
+            if (!added_)
+            {
+                reactor_->control(EPOLL_CTL_ADD, fd_, events, this);
+                added_ = true;
+                reactor_->registered_ += 1;
+            }
+            else
+            {
+                reactor_->control(EPOLL_CTL_MOD, fd_, events, this);
+            }
+            armed_ = true;
+        }
+
+        virtual void dispatch(uint32_t events) = 0;
+
+        std::shared_ptr<Reactor> reactor_;
+        int fd_;
+
+    private:
+        friend class Reactor;
+
+        void fire(uint32_t events)
+        {
+            armed_ = false;
+            dispatch(events);
+        }
+
+        bool added_ = false;
+        bool armed_ = false;
+    };
+
+    class FdWaitable : public Waitable, public ReactorSource
+    {
+    public:
+        //  Maps the ready epoll event mask to the event reported to the guest.
+        using EventFn = std::function<Event(uint32_t events)>;
+
+        FdWaitable(std::shared_ptr<Reactor> reactor, int fd, uint32_t interest, EventFn on_ready)
+            : ReactorSource(std::move(reactor), fd), interest_(interest), on_ready_(std::move(on_ready))
+        {
+        }
+
+        void arm()
+        {
+            arm_events(interest_);
+        }
+
+    private:
+        void dispatch(uint32_t events) override
+        {
+            set_pending_event(on_ready_(events));
+        }
+
+        uint32_t interest_;
+        EventFn on_ready_;
+    };
+
+    inline std::size_t Reactor::poll(int timeout_ms)
+    {
+        if (registered_ == 0 && timeout_ms == 0)
+        {
+            return 0;
+        }
+        std::size_t dispatched = 0;
+        int n;
+        do
+        {
+            n = ::epoll_wait(epfd_, events_.data(), static_cast<int>(events_.size()), timeout_ms);
+        } while (n < 0 && errno == EINTR);
+        if (n < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "epoll_wait");
+        }
+        for (int i = 0; i < n; ++i)
+        {
+            if (!events_[i].data.ptr)
+            {
+                uint64_t count;
+                [[maybe_unused]] auto drained = ::read(wakefd_, &count, sizeof(count));
+                continue;
+            }
+            static_cast<ReactorSource *>(events_[i].data.ptr)->fire(events_[i].events);
+            dispatched += 1;
+        }
+        return dispatched;
+    }
+}
+
+#endif
+
+#endif
@@ -1,16 +1,26 @@
 #ifndef CMCPP_RUNTIME_HPP
 #define CMCPP_RUNTIME_HPP
 
+#include "alloc.hpp"
+#include "metrics.hpp"
+#include "timer.hpp"
+
 #include <algorithm>
 #include <any>
 #include <array>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <deque>
+#include <exception>
 #include <functional>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <stdexcept>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -52,15 +62,175 @@ namespace cmcpp
     using OnStart = std::function<std::vector<std::any>()>;
     using OnResolve = std::function<void(std::optional<std::vector<std::any>>)>;
 
+    //  Typed counterparts of OnStart/OnResolve.  Params and Results are tuples;
+    //  values move through the runtime unboxed.
+    template <typename Params>
+    using TypedOnStart = std::function<Params()>;
+    template <typename Results>
+    using TypedOnResolve = std::function<void(std::optional<Results>)>;
+
+    //  Boxes each tuple element into a std::any, for the type-erased API.
+    template <typename Tuple>
+    std::vector<std::any> to_any_values(Tuple &&values)
+    {
+        return std::apply([](auto &&...elems)
+                          {
+                              std::vector<std::any> out;
+                              out.reserve(sizeof...(elems));
+                              (out.emplace_back(std::forward<decltype(elems)>(elems)), ...);
+                              return out; },
+                          std::forward<Tuple>(values));
+    }
+
+    //  Unboxes values into Tuple; throws std::bad_any_cast on a type mismatch
+    //  and std::invalid_argument on an arity mismatch.
+    template <typename Tuple>
+    Tuple from_any_values(std::vector<std::any> values)
+    {
+        constexpr std::size_t N = std::tuple_size_v<Tuple>;
+        if (values.size() != N)
+        {
+            throw std::invalid_argument("value count does not match tuple arity");
+        }
+        return [&]<std::size_t... I>(std::index_sequence<I...>)
+        {
+            return Tuple{std::any_cast<std::tuple_element_t<I, Tuple>>(std::move(values[I]))...};
+        }(std::make_index_sequence<N>{});
+    }
+
+    class Thread;
+
+    enum class PriorityClass : uint8_t
+    {
+        Interactive = 0,
+        Normal = 1,
+        Batch = 2
+    };
+
+    struct SchedulingStats
+    {
+        uint64_t resumes = 0;
+        uint64_t charged_ns = 0;
+        //  Ticks in which the group had a ready thread but another group ran.
+        uint64_t starved_ticks = 0;
+        uint64_t max_starved_streak = 0;
+        //  Resumes granted by starvation protection rather than by priority.
+        uint64_t boosts = 0;
+    };
+
+    //  Threads sharing a SchedulingGroup (typically all threads of one
+    //  ComponentInstance) are scheduled as one unit.  The Store always prefers
+    //  the highest ready priority class and shares time within a class by weight
+    //  (weighted-fair virtual runtime); a group passed over for
+    //  SchedulerOptions::starvation_limit consecutive ticks runs next regardless
+    //  of class.
+    class SchedulingGroup
+    {
+    public:
+        static constexpr uint32_t DEFAULT_WEIGHT = 100;
+
+        explicit SchedulingGroup(PriorityClass priority = PriorityClass::Normal, uint32_t weight = DEFAULT_WEIGHT)
+            : priority_(priority), weight_(weight == 0 ? 1 : weight) {}
+
+        PriorityClass priority() const
+        {
+            return priority_;
+        }
+
+        uint32_t weight() const
+        {
+            return weight_;
+        }
+
+        SchedulingStats stats() const
+        {
+            SchedulingStats stats;
+            stats.resumes = resumes_.load(std::memory_order_relaxed);
+            stats.charged_ns = charged_ns_.load(std::memory_order_relaxed);
+            stats.starved_ticks = starved_ticks_.load(std::memory_order_relaxed);
+            stats.max_starved_streak = max_starved_streak_.load(std::memory_order_relaxed);
+            stats.boosts = boosts_.load(std::memory_order_relaxed);
+            return stats;
+        }
+
+    private:
+        friend class Store;
+
+        const PriorityClass priority_;
+        const uint32_t weight_;
+        //  Guarded by the owning Store's mutex.
+        uint64_t vruntime_ = 0;
+        uint32_t starved_streak_ = 0;
+        std::atomic<uint64_t> resumes_{0};
+        std::atomic<uint64_t> charged_ns_{0};
+        std::atomic<uint64_t> starved_ticks_{0};
+        std::atomic<uint64_t> max_starved_streak_{0};
+        std::atomic<uint64_t> boosts_{0};
+    };
+
+    struct SchedulerOptions
+    {
+        //  Minimum run time charged per resume, so cheap yields still consume
+        //  their group's share.
+        Clock::duration quantum = std::chrono::microseconds(50);
+        uint32_t starvation_limit = 32;
+        //  How long Store::run sleeps before re-evaluating the readiness
+        //  predicates of pending threads that nothing else will wake.
+        Clock::duration predicate_poll = std::chrono::milliseconds(1);
+    };
+
+    //  Wakes one particular park of a Thread; stale wakers are ignored.
+    struct ThreadWaker
+    {
+        std::weak_ptr<Thread> thread;
+        uint32_t generation = 0;
+
+        void operator()() const;
+        //  The park this waker targets has already ended.
+        bool expired() const;
+    };
+
+    //  External event source drained at the start of every Store::tick (e.g. an
+    //  epoll reactor).  poll() dispatches whatever is ready, waiting at most
+    //  timeout_ms, and returns the number of events handled.
+    class Poller
+    {
+    public:
+        virtual ~Poller() = default;
+        virtual std::size_t poll(int timeout_ms) = 0;
+
+        //  A wakeable poller lets Store::run block in poll(); wake() must then
+        //  interrupt it from any OS thread.
+        virtual bool wakeable() const
+        {
+            return false;
+        }
+
+        virtual void wake() {}
+    };
+
+    //  Runs shared-thread bodies on host OS threads, outside Store::tick (e.g. a
+    //  ThreadPool).  submit() may be called from the ticking thread only.
+    class Executor
+    {
+    public:
+        virtual ~Executor() = default;
+        virtual void submit(std::function<void()> job) = 0;
+        virtual std::size_t concurrency() const = 0;
+    };
+
     class Thread : public std::enable_shared_from_this<Thread>
     {
     public:
-        using ReadyFn = std::function<bool()>;
-        using ResumeFn = std::function<bool(bool)>;
-        using CancelFn = std::function<void()>;
+        using ReadyFn = InlineFunction<bool()>;
+        using ResumeFn = InlineFunction<bool(bool)>;
+        using CancelFn = InlineFunction<void()>;
 
         static std::shared_ptr<Thread> create(Store &store, ReadyFn ready, ResumeFn resume, bool cancellable = false, CancelFn on_cancel = {});
         static std::shared_ptr<Thread> create_suspended(Store &store, ResumeFn resume, bool cancellable = false, CancelFn on_cancel = {});
+        //  Suspended, cancellable thread whose body runs on the store's shared
+        //  executor, or inline on the tick when none is installed at first resume.
+        static std::shared_ptr<Thread> create_shared(Store &store, std::function<void()> body);
 
         Thread(Store &store, ReadyFn ready, ResumeFn resume, bool cancellable, CancelFn on_cancel);
 
@@ -78,6 +248,21 @@ namespace cmcpp
         void resume_later();
 
         bool suspend_until(ReadyFn ready, bool cancellable, bool force_yield = false);
+        bool suspend_until_deadline(TimePoint deadline, bool cancellable);
+        ThreadWaker park(bool cancellable, ReadyFn ready = nullptr);
+        ThreadWaker waker();
+        bool parked() const;
+
+        void set_group(std::shared_ptr<SchedulingGroup> group);
+        std::shared_ptr<SchedulingGroup> group() const;
+
+#ifdef CMCPP_SCHED_METRICS
+        //  Total time spent inside resume().
+        Clock::duration run_time() const
+        {
+            return std::chrono::nanoseconds(run_ns_.load(std::memory_order_relaxed));
+        }
+#endif
         void set_ready(ReadyFn ready);
         void set_allow_cancellation(bool allow);
         bool allow_cancellation() const;
@@ -94,32 +279,106 @@ namespace cmcpp
             return context_;
         }
 
+        Store &store() const
+        {
+            return *store_;
+        }
+
     private:
-        enum class State
+        //  All mutable scheduling state lives in one atomic word so accessors never
+        //  take a lock.  ready_ is only replaced while the thread is not queued
+        //  (running, suspended or not yet scheduled), so the Store can evaluate it
+        //  without further synchronisation.
+        enum class State : uint32_t
         {
-            Suspended,
-            Pending,
-            Running,
-            Completed
+            Suspended = 0,
+            Pending = 1,
+            Running = 2,
+            Completed = 3
         };
 
+        static constexpr uint32_t STATE_MASK = 0x3;
+        static constexpr uint32_t ALLOW_CANCELLATION = 1u << 2;
+        static constexpr uint32_t CANCELLABLE = 1u << 3;
+        static constexpr uint32_t CANCELLED = 1u << 4;
+        static constexpr uint32_t IN_EVENT_LOOP = 1u << 5;
+        static constexpr uint32_t FORCE_YIELD = 1u << 6;
+        static constexpr uint32_t RESCHEDULE = 1u << 7;
+        static constexpr uint32_t PARKED = 1u << 8;
+        static constexpr uint32_t NO_INDEX = 0xFFFF'FFFFu;
+
+        static State state_of(uint32_t word)
+        {
+            return static_cast<State>(word & STATE_MASK);
+        }
+
+        static uint32_t with_state(uint32_t word, State state)
+        {
+            return (word & ~STATE_MASK) | static_cast<uint32_t>(state);
+        }
+
+        bool has(uint32_t flag) const
+        {
+            return (word_.load(std::memory_order_acquire) & flag) != 0;
+        }
+
+        void set_flag(uint32_t flag, bool value)
+        {
+            if (value)
+            {
+                word_.fetch_or(flag, std::memory_order_acq_rel);
+            }
+            else
+            {
+                word_.fetch_and(~flag, std::memory_order_acq_rel);
+            }
+        }
+
         void set_pending(bool pending_again, const std::shared_ptr<Thread> &self);
+        friend struct ThreadWaker;
+        friend class Store;
+        void wake(uint32_t generation);
 
         Store *store_;
         ReadyFn ready_;
         ResumeFn resume_;
         CancelFn on_cancel_;
-        bool allow_cancellation_;
-        bool cancellable_;
-        bool cancelled_;
-        bool in_event_loop_;
         ContextLocalStorage context_{};
-        std::optional<uint32_t> index_;
-        mutable std::mutex mutex_;
-        State state_;
-        std::atomic<bool> reschedule_requested_{false};
+        mutable std::atomic<uint32_t> word_;
+        std::atomic<uint32_t> index_{NO_INDEX};
+        std::atomic<TimerId> timer_{0};
+        std::atomic<uint32_t> park_generation_{0};
+        std::shared_ptr<SchedulingGroup> group_;
+#ifdef CMCPP_SCHED_METRICS
+        std::atomic<uint64_t> queued_ns_{0};
+        std::atomic<uint64_t> run_ns_{0};
+#endif
     };
 
+    //  Cooperative wait hook.  While a Suspender is installed on the calling OS
+    //  thread (e.g. by a fiber), canonical sync waits park the current runtime
+    //  Thread until ready() holds instead of blocking the OS thread.
+    class Suspender
+    {
+    public:
+        virtual ~Suspender() = default;
+        virtual void wait_until(Thread::ReadyFn ready) = 0;
+
+        //  Like wait_until, but the Thread is parked rather than polled:
+        //  subscribe hands its waker to whatever will make ready() hold.
+        virtual void park_until(Thread::ReadyFn ready, const std::function<void(const ThreadWaker &)> &subscribe)
+        {
+            (void)subscribe;
+            wait_until(std::move(ready));
+        }
+    };
+
+    inline Suspender *&current_suspender()
+    {
+        thread_local Suspender *suspender = nullptr;
+        return suspender;
+    }
+
     class Call
     {
     public:
@@ -148,51 +407,299 @@ namespace cmcpp
 
         static Call from_thread(const std::shared_ptr<Thread> &thread);
 
+        //  Request scope of a call made with a deadline (see Store::invoke).
+        const SupertaskPtr &scope() const
+        {
+            return scope_;
+        }
+
     private:
+        friend class Store;
+
         CancelRequest request_cancellation_;
         bool cancellable_ = false;
+        SupertaskPtr scope_;
     };
 
+    //  Why a subtask was cancelled by cancel_subtree.
+    enum class CutOff : uint8_t
+    {
+        None,
+        Cancelled,
+        DeadlineExpired
+    };
+
+    //  A node in the tree of tasks and request scopes.  Deadlines are inherited
+    //  from the parent (the earliest wins) and cancellation flows down through
+    //  children; see attach_subtask and cancel_subtree.
     struct Supertask
     {
         SupertaskPtr parent;
         std::weak_ptr<Thread> thread;
         ComponentInstance *instance = nullptr;
+
+        std::optional<TimePoint> deadline;
+        CutOff cut_off = CutOff::None;
+        //  Cancels the work this node represents; falls back to the thread.
+        Call call;
+        std::vector<std::weak_ptr<Supertask>> children;
+        Store *store = nullptr;
+        TimerId deadline_timer = 0;
+
+        Supertask() = default;
+        Supertask(const Supertask &) = delete;
+        Supertask &operator=(const Supertask &) = delete;
+        ~Supertask();
     };
 
+    void attach_subtask(const SupertaskPtr &parent, const SupertaskPtr &child);
+    void cancel_subtree(const SupertaskPtr &root, CutOff reason = CutOff::Cancelled);
+    std::vector<SupertaskPtr> cut_off_subtasks(const SupertaskPtr &root);
+
     using FuncInst = std::function<Call(Store &, SupertaskPtr, OnStart, OnResolve)>;
 
+    template <typename Params, typename Results>
+    using TypedFuncInst = std::function<Call(Store &, SupertaskPtr, TypedOnStart<Params>, TypedOnResolve<Results>)>;
+
+    //  Adapts a typed function to the std::any FuncInst API.
+    template <typename Params, typename Results>
+    FuncInst erase_func(TypedFuncInst<Params, Results> func)
+    {
+        return [func = std::move(func)](Store &store, SupertaskPtr caller, OnStart on_start, OnResolve on_resolve) -> Call
+        {
+            TypedOnStart<Params> typed_start;
+            if (on_start)
+            {
+                typed_start = [on_start = std::move(on_start)]()
+                {
+                    return from_any_values<Params>(on_start());
+                };
+            }
+            TypedOnResolve<Results> typed_resolve;
+            if (on_resolve)
+            {
+                typed_resolve = [on_resolve = std::move(on_resolve)](std::optional<Results> results)
+                {
+                    if (!results)
+                    {
+                        on_resolve(std::nullopt);
+                        return;
+                    }
+                    on_resolve(to_any_values(std::move(*results)));
+                };
+            }
+            return func(store, std::move(caller), std::move(typed_start), std::move(typed_resolve));
+        };
+    }
+
     class Store
     {
     public:
         Call invoke(const FuncInst &func, SupertaskPtr caller, OnStart on_start, OnResolve on_resolve);
-        void tick();
+        //  Runs func inside a new request scope that is cancelled as a whole,
+        //  including every subtask spawned beneath it, once deadline passes.
+        Call invoke(const FuncInst &func, SupertaskPtr caller, OnStart on_start, OnResolve on_resolve, TimePoint deadline);
+        //  Opens a request scope under parent; its effective deadline is the
+        //  earlier of deadline and the parent's.
+        SupertaskPtr open_scope(SupertaskPtr parent, std::optional<TimePoint> deadline = std::nullopt);
+        template <typename Params, typename Results>
+        Call invoke_typed(const TypedFuncInst<Params, Results> &func, SupertaskPtr caller, TypedOnStart<Params> on_start, TypedOnResolve<Results> on_resolve)
+        {
+            if (!func)
+            {
+                return Call();
+            }
+            return func(*this, std::move(caller), std::move(on_start), std::move(on_resolve));
+        }
+        //  Returns false when there was nothing to do.
+        bool tick();
         void schedule(const std::shared_ptr<Thread> &thread);
         std::size_t pending_size() const;
         void enqueue(std::function<void()> microtask);
 
+        //  Thread-safe: queues completion to run on the driver thread and wakes a
+        //  sleeping run().
+        void post_completion(std::function<void()> completion);
+
+        //  Ticks until stop() is called or until() holds, sleeping whenever there
+        //  is nothing to do.  Sleeps end on a post, schedule or stop, on the next
+        //  timer deadline, or on poller readiness when the poller is wakeable.
+        void run(std::function<bool()> until = {});
+        void stop();
+
+        //  Timed microtasks run at the start of the first tick() at or after their
+        //  deadline.
+        TimerId enqueue_at(TimePoint deadline, std::function<void()> microtask);
+        TimerId enqueue_after(Clock::duration delay, std::function<void()> microtask);
+        bool cancel_timer(TimerId timer);
+        std::optional<TimePoint> next_deadline() const;
+        std::size_t timer_count() const;
+
+        //  The poller is drained (without blocking) at the start of every tick.
+        void set_poller(std::shared_ptr<Poller> poller);
+        const std::shared_ptr<Poller> &poller() const
+        {
+            return poller_;
+        }
+
+        //  Threads made with Thread::create_shared run their bodies here.  Without an
+        //  executor, shared threads run cooperatively like any other.
+        void set_shared_executor(std::shared_ptr<Executor> executor);
+        const std::shared_ptr<Executor> &shared_executor() const
+        {
+            return executor_;
+        }
+
+        //  Scheduling groups are opt-in: until a thread is given one, tick()
+        //  resumes the first ready thread in FIFO order.
+        void set_scheduler_options(SchedulerOptions options);
+        SchedulerOptions scheduler_options() const;
+        const std::shared_ptr<SchedulingGroup> &default_group() const
+        {
+            return default_group_;
+        }
+
+#ifdef CMCPP_SCHED_METRICS
+        const SchedulerMetrics &metrics() const
+        {
+            return metrics_;
+        }
+
+        SchedulerMetrics &metrics()
+        {
+            return metrics_;
+        }
+
+        //  Calls exporter with a fresh snapshot every interval (from tick()).
+        void set_metrics_exporter(std::function<void(const SchedulerSnapshot &)> exporter, Clock::duration interval);
+        void export_metrics();
+#endif
+
+        //  Defaults to Clock::now(); hosts may substitute a virtual clock.
+        TimePoint now() const;
+        void set_clock(std::function<TimePoint()> clock);
+
+        // Threads are co-allocated with their control block from this pool.
+        const std::shared_ptr<SlabPool> &thread_pool() const
+        {
+            return thread_pool_;
+        }
+
     private:
         friend class Thread;
 
+        std::vector<std::shared_ptr<Thread>>::iterator select_grouped(SchedulingGroup *&boosted);
+        void notify_locked();
+        void charge(SchedulingGroup &group, Clock::duration elapsed);
+
+        std::shared_ptr<SlabPool> thread_pool_ = std::make_shared<SlabPool>();
         mutable std::mutex mutex_;
         std::vector<std::shared_ptr<Thread>> pending_;
         std::deque<std::function<void()>> microtasks_;
+        std::function<TimePoint()> clock_;
+        TimerWheel timers_{Clock::now()};
+        std::shared_ptr<Poller> poller_;
+        std::shared_ptr<Executor> executor_;
+        std::condition_variable idle_cv_;
+        bool sleeping_ = false;
+        bool notified_ = false;
+        bool stopping_ = false;
+        bool grouped_ = false;
+        SchedulerOptions sched_options_;
+        std::shared_ptr<SchedulingGroup> default_group_ = std::make_shared<SchedulingGroup>();
+        std::array<uint64_t, 3> min_vruntime_{};
+#ifdef CMCPP_SCHED_METRICS
+        SchedulerMetrics metrics_;
+        std::function<void(const SchedulerSnapshot &)> exporter_;
+        Clock::duration export_interval_{};
+        TimerId export_timer_ = 0;
+#endif
     };
 
+#ifdef CMCPP_SCHED_METRICS
+    //  The Store whose tick() is running on this OS thread, so that suspension
+    //  points without a Store reference can attribute their counts.
+    inline Store *&current_store()
+    {
+        thread_local Store *store = nullptr;
+        return store;
+    }
+
+    inline void record_suspend(SuspendReason reason);
+#endif
+
     inline std::shared_ptr<Thread> Thread::create(Store &store, ReadyFn ready, ResumeFn resume, bool cancellable, CancelFn on_cancel)
     {
-        auto thread = std::shared_ptr<Thread>(new Thread(store, std::move(ready), std::move(resume), cancellable, std::move(on_cancel)));
+        auto thread = std::allocate_shared<Thread>(PoolAllocator<Thread>(store.thread_pool_), store, std::move(ready), std::move(resume), cancellable, std::move(on_cancel));
         store.schedule(thread);
         return thread;
     }
 
     inline std::shared_ptr<Thread> Thread::create_suspended(Store &store, ResumeFn resume, bool cancellable, CancelFn on_cancel)
     {
-        auto thread = std::shared_ptr<Thread>(new Thread(store, nullptr, std::move(resume), cancellable, std::move(on_cancel)));
+        auto thread = std::allocate_shared<Thread>(PoolAllocator<Thread>(store.thread_pool_), store, nullptr, std::move(resume), cancellable, std::move(on_cancel));
+        thread->word_.store(with_state(thread->word_.load(std::memory_order_relaxed), State::Suspended), std::memory_order_release);
+        return thread;
+    }
+
+    //  The first resume() submits body to the executor and parks; the job's
+    //  completion wakes the thread, which then completes on the ticking thread
+    //  (rethrowing anything body threw).  The body cannot be cancelled once
+    //  submitted.
+    inline std::shared_ptr<Thread> Thread::create_shared(Store &store, std::function<void()> body)
+    {
+        struct SharedJob
         {
-            std::lock_guard lock(thread->mutex_);
-            thread->state_ = State::Suspended;
-        }
+            std::function<void()> body;
+            std::weak_ptr<Thread> thread;
+            std::exception_ptr error;
+            bool submitted = false;
+        };
+        auto job = std::make_shared<SharedJob>();
+        job->body = std::move(body);
+        auto thread = create_suspended(
+            store,
+            [job](bool) -> bool
+            {
+                if (job->submitted)
+                {
+                    if (job->error)
+                    {
+                        std::rethrow_exception(std::exchange(job->error, nullptr));
+                    }
+                    return false;
+                }
+                job->submitted = true;
+                auto self = job->thread.lock();
+                //  The executor may be gone by the first resume; the body then
+                //  runs cooperatively like any other thread's.
+                auto executor = self->store().shared_executor();
+                if (!executor)
+                {
+                    job->body();
+                    job->body = nullptr;
+                    return false;
+                }
+                auto waker = self->park(false);
+                executor->submit(
+                    [job, waker]()
+                    {
+                        try
+                        {
+                            job->body();
+                        }
+                        catch (...)
+                        {
+                            job->error = std::current_exception();
+                        }
+                        job->body = nullptr;
+                        waker();
+                    });
+                return false;
+            },
+            true,
+            {});
+        job->thread = thread;
         return thread;
     }
 
@@ -201,25 +708,25 @@ namespace cmcpp
           ready_(std::move(ready)),
           resume_(std::move(resume)),
           on_cancel_(std::move(on_cancel)),
-          allow_cancellation_(cancellable),
-          cancellable_(cancellable),
-          cancelled_(false),
-          in_event_loop_(false),
-          state_(State::Pending)
+          word_(static_cast<uint32_t>(State::Pending) | (cancellable ? (ALLOW_CANCELLATION | CANCELLABLE) : 0u))
     {
     }
 
     inline bool Thread::ready() const
     {
-        std::lock_guard lock(mutex_);
-        if (state_ != State::Pending)
+        uint32_t word = word_.load(std::memory_order_acquire);
+        if (state_of(word) != State::Pending)
         {
             return false;
         }
-        if (cancelled_ && cancellable_)
+        if ((word & CANCELLED) && (word & CANCELLABLE))
         {
             return true;
         }
+        if ((word & FORCE_YIELD) && (word_.fetch_and(~FORCE_YIELD, std::memory_order_acq_rel) & FORCE_YIELD))
+        {
+            return false;
+        }
         if (!ready_)
         {
             return true;
@@ -230,190 +737,299 @@ namespace cmcpp
     inline void Thread::resume()
     {
         auto self = shared_from_this();
-        ResumeFn resume;
-        bool was_cancelled = false;
 
+        uint32_t word = word_.load(std::memory_order_acquire);
+        do
         {
-            std::lock_guard lock(mutex_);
-            if (state_ != State::Pending && state_ != State::Suspended)
+            auto state = state_of(word);
+            if (state != State::Pending && state != State::Suspended)
             {
                 return;
             }
-            state_ = State::Running;
-            resume = resume_;
-            was_cancelled = cancelled_;
-            cancelled_ = false;
-        }
+        } while (!word_.compare_exchange_weak(word, with_state(word, State::Running) & ~CANCELLED, std::memory_order_acq_rel));
+        bool was_cancelled = (word & CANCELLED) != 0;
 
         bool keep_pending = false;
-        if (resume)
+        if (resume_)
         {
-            keep_pending = resume(was_cancelled);
+            keep_pending = resume_(was_cancelled);
         }
 
-        bool requested = reschedule_requested_.exchange(false, std::memory_order_relaxed);
+        bool requested = (word_.fetch_and(~RESCHEDULE, std::memory_order_acq_rel) & RESCHEDULE) != 0;
         set_pending(keep_pending || requested, self);
     }
 
     inline void Thread::request_cancellation()
     {
-        CancelFn cancel;
+        uint32_t word = word_.load(std::memory_order_acquire);
+        do
         {
-            std::lock_guard lock(mutex_);
-            if (!allow_cancellation_ || cancelled_)
+            if (!(word & ALLOW_CANCELLATION) || (word & CANCELLED))
             {
                 return;
             }
-            cancelled_ = true;
-            cancel = on_cancel_;
-        }
+        } while (!word_.compare_exchange_weak(word, word | CANCELLED, std::memory_order_acq_rel));
 
-        if (cancel)
+        if ((word & CANCELLABLE) && (word & PARKED))
+        {
+            wake(park_generation_.load(std::memory_order_acquire));
+        }
+        if (on_cancel_)
         {
-            cancel();
+            on_cancel_();
         }
     }
 
     inline bool Thread::cancellable() const
     {
-        std::lock_guard lock(mutex_);
-        return cancellable_;
+        return has(CANCELLABLE);
     }
 
     inline bool Thread::cancelled() const
     {
-        std::lock_guard lock(mutex_);
-        return cancelled_;
+        return has(CANCELLED);
     }
 
     inline bool Thread::completed() const
     {
-        std::lock_guard lock(mutex_);
-        return state_ == State::Completed;
+        return state_of(word_.load(std::memory_order_acquire)) == State::Completed;
     }
 
     inline void Thread::set_index(uint32_t index)
     {
-        std::lock_guard lock(mutex_);
-        index_ = index;
+        index_.store(index, std::memory_order_release);
     }
 
     inline std::optional<uint32_t> Thread::index() const
     {
-        std::lock_guard lock(mutex_);
-        return index_;
+        uint32_t index = index_.load(std::memory_order_acquire);
+        if (index == NO_INDEX)
+        {
+            return std::nullopt;
+        }
+        return index;
     }
 
     inline bool Thread::suspended() const
     {
-        std::lock_guard lock(mutex_);
-        return state_ == State::Suspended;
+        return state_of(word_.load(std::memory_order_acquire)) == State::Suspended;
     }
 
     inline void Thread::resume_later()
     {
         auto self = shared_from_this();
+        uint32_t word = word_.load(std::memory_order_acquire);
+        if (state_of(word) != State::Suspended)
         {
-            std::lock_guard lock(mutex_);
-            if (state_ != State::Suspended)
+            return;
+        }
+        ready_ = nullptr;
+        while (!word_.compare_exchange_weak(word, with_state(word, State::Pending) & ~(CANCELLABLE | CANCELLED | FORCE_YIELD | PARKED), std::memory_order_acq_rel))
+        {
+            if (state_of(word) != State::Suspended)
             {
                 return;
             }
-            ready_ = []()
-            {
-                return true;
-            };
-            cancellable_ = false;
-            cancelled_ = false;
-            state_ = State::Pending;
+        }
+        if (auto timer = timer_.exchange(0, std::memory_order_acq_rel))
+        {
+            store_->cancel_timer(timer);
         }
         store_->schedule(self);
     }
 
     inline bool Thread::suspend_until(ReadyFn ready, bool cancellable, bool force_yield)
     {
-        bool ready_now = false;
-        if (ready && !force_yield)
+        if (ready && !force_yield && ready())
         {
-            ready_now = ready();
+            return true;
         }
 
-        if (ready_now)
+        ready_ = std::move(ready);
+        uint32_t word = word_.load(std::memory_order_acquire);
+        uint32_t next;
+        do
+        {
+            next = word & ~(CANCELLABLE | FORCE_YIELD);
+            if ((word & ALLOW_CANCELLATION) && cancellable)
+            {
+                next |= CANCELLABLE;
+            }
+            if (force_yield)
+            {
+                next |= FORCE_YIELD;
+            }
+            next |= RESCHEDULE;
+        } while (!word_.compare_exchange_weak(word, next, std::memory_order_acq_rel));
+        return false;
+    }
+
+    //  Parks the thread off the pending list until the returned waker runs (or,
+    //  when cancellable, until cancellation is requested); no readiness predicate
+    //  is evaluated in the meantime.  A ready predicate, if given, is checked
+    //  once woken, so a wake whose event another waiter consumed first leaves
+    //  the thread pending instead of resuming it early.
+    inline ThreadWaker Thread::park(bool cancellable, ReadyFn ready)
+    {
+        ready_ = std::move(ready);
+        timer_.store(0, std::memory_order_release);
+        uint32_t generation = park_generation_.fetch_add(1, std::memory_order_acq_rel) + 1;
+        uint32_t word = word_.load(std::memory_order_acquire);
+        uint32_t next;
+        do
+        {
+            next = word & ~(CANCELLABLE | FORCE_YIELD);
+            if ((word & ALLOW_CANCELLATION) && cancellable)
+            {
+                next |= CANCELLABLE;
+            }
+            next |= RESCHEDULE;
+            //  A cancellation that already arrived will not wake us again.
+            if (!((next & CANCELLABLE) && (next & CANCELLED)))
+            {
+                next |= PARKED;
+            }
+        } while (!word_.compare_exchange_weak(word, next, std::memory_order_acq_rel));
+        return ThreadWaker{weak_from_this(), generation};
+    }
+
+    inline ThreadWaker Thread::waker()
+    {
+        return ThreadWaker{weak_from_this(), park_generation_.load(std::memory_order_acquire)};
+    }
+
+    inline bool Thread::parked() const
+    {
+        return has(PARKED);
+    }
+
+    //  park() plus a Store timer that fires the waker at the deadline.
+    inline bool Thread::suspend_until_deadline(TimePoint deadline, bool cancellable)
+    {
+        if (deadline <= store_->now())
         {
             return true;
         }
+        auto waker = park(cancellable);
+        timer_.store(store_->enqueue_at(deadline, waker), std::memory_order_release);
+        return false;
+    }
 
-        auto gate = std::make_shared<std::atomic<bool>>(false);
-        ReadyFn wrapped = [ready = std::move(ready), gate, force_yield]() mutable -> bool
+    inline void Thread::set_group(std::shared_ptr<SchedulingGroup> group)
+    {
+        std::lock_guard lock(store_->mutex_);
+        group_ = std::move(group);
+        if (group_)
         {
-            if (force_yield && !gate->exchange(true, std::memory_order_relaxed))
+            store_->grouped_ = true;
+        }
+    }
+
+    inline std::shared_ptr<SchedulingGroup> Thread::group() const
+    {
+        std::lock_guard lock(store_->mutex_);
+        return group_;
+    }
+
+    inline void ThreadWaker::operator()() const
+    {
+        if (auto locked = thread.lock())
+        {
+            locked->wake(generation);
+        }
+    }
+
+    inline bool ThreadWaker::expired() const
+    {
+        auto locked = thread.lock();
+        return !locked || locked->park_generation_.load(std::memory_order_acquire) != generation || !locked->parked();
+    }
+
+    inline void Thread::wake(uint32_t generation)
+    {
+        if (park_generation_.load(std::memory_order_acquire) != generation)
+        {
+            return;
+        }
+        uint32_t word = word_.load(std::memory_order_acquire);
+        uint32_t next;
+        do
+        {
+            if (!(word & PARKED))
             {
-                return false;
+                return;
             }
-            if (!ready)
+            next = word & ~PARKED;
+            if (state_of(word) == State::Suspended)
             {
-                return true;
+                next = with_state(next, State::Pending);
             }
-            return ready();
-        };
+        } while (!word_.compare_exchange_weak(word, next, std::memory_order_acq_rel));
 
+        if (auto timer = timer_.exchange(0, std::memory_order_acq_rel))
         {
-            std::lock_guard lock(mutex_);
-            ready_ = std::move(wrapped);
-            cancellable_ = allow_cancellation_ && cancellable;
+            store_->cancel_timer(timer);
+        }
+        if (state_of(word) == State::Suspended)
+        {
+            store_->schedule(shared_from_this());
         }
-
-        reschedule_requested_.store(true, std::memory_order_relaxed);
-        return false;
     }
 
     inline void Thread::set_ready(ReadyFn ready)
     {
-        std::lock_guard lock(mutex_);
         ready_ = std::move(ready);
+        set_flag(FORCE_YIELD, false);
     }
 
     inline void Thread::set_allow_cancellation(bool allow)
     {
-        std::lock_guard lock(mutex_);
-        allow_cancellation_ = allow;
-        if (!allow)
+        if (allow)
         {
-            cancellable_ = false;
+            set_flag(ALLOW_CANCELLATION, true);
+        }
+        else
+        {
+            set_flag(ALLOW_CANCELLATION | CANCELLABLE, false);
         }
     }
 
     inline bool Thread::allow_cancellation() const
     {
-        std::lock_guard lock(mutex_);
-        return allow_cancellation_;
+        return has(ALLOW_CANCELLATION);
     }
 
     inline void Thread::set_in_event_loop(bool value)
     {
-        std::lock_guard lock(mutex_);
-        in_event_loop_ = value;
+        set_flag(IN_EVENT_LOOP, value);
     }
 
     inline bool Thread::in_event_loop() const
     {
-        std::lock_guard lock(mutex_);
-        return in_event_loop_;
+        return has(IN_EVENT_LOOP);
     }
 
     inline void Thread::set_pending(bool pending_again, const std::shared_ptr<Thread> &self)
     {
+        if (!pending_again)
+        {
+            ready_ = nullptr;
+        }
+        uint32_t word = word_.load(std::memory_order_acquire);
+        uint32_t next;
+        do
         {
-            std::lock_guard lock(mutex_);
-            state_ = pending_again ? State::Pending : State::Completed;
             if (!pending_again)
             {
-                ready_ = nullptr;
-                cancellable_ = false;
+                next = with_state(word, State::Completed) & ~(CANCELLABLE | FORCE_YIELD | PARKED);
             }
-        }
+            else
+            {
+                next = with_state(word, (word & PARKED) ? State::Suspended : State::Pending);
+            }
+        } while (!word_.compare_exchange_weak(word, next, std::memory_order_acq_rel));
 
-        if (pending_again)
+        if (state_of(next) == State::Pending)
         {
             store_->schedule(self);
         }
@@ -437,6 +1053,128 @@ namespace cmcpp
             thread->allow_cancellation());
     }
 
+    inline Supertask::~Supertask()
+    {
+        if (store && deadline_timer)
+        {
+            store->cancel_timer(deadline_timer);
+        }
+    }
+
+    inline void attach_subtask(const SupertaskPtr &parent, const SupertaskPtr &child)
+    {
+        child->parent = parent;
+        if (!parent)
+        {
+            return;
+        }
+        if (parent->deadline && (!child->deadline || *parent->deadline < *child->deadline))
+        {
+            child->deadline = parent->deadline;
+        }
+        std::erase_if(parent->children, [](const std::weak_ptr<Supertask> &weak)
+                      { return weak.expired(); });
+        parent->children.push_back(child);
+        if (parent->cut_off != CutOff::None)
+        {
+            cancel_subtree(child, parent->cut_off);
+        }
+    }
+
+    //  Marks root and its live descendants as cut off and requests cancellation
+    //  of each.  Nodes already cut off (and so their subtrees) are skipped.
+    inline void cancel_subtree(const SupertaskPtr &root, CutOff reason)
+    {
+        std::vector<SupertaskPtr> stack{root};
+        while (!stack.empty())
+        {
+            auto node = std::move(stack.back());
+            stack.pop_back();
+            if (!node || node->cut_off != CutOff::None)
+            {
+                continue;
+            }
+            node->cut_off = reason;
+            for (const auto &weak : node->children)
+            {
+                if (auto child = weak.lock())
+                {
+                    stack.push_back(std::move(child));
+                }
+            }
+            if (node->call.cancellable())
+            {
+                node->call.request_cancellation();
+            }
+            else if (auto thread = node->thread.lock())
+            {
+                thread->request_cancellation();
+            }
+        }
+    }
+
+    inline std::vector<SupertaskPtr> cut_off_subtasks(const SupertaskPtr &root)
+    {
+        std::vector<SupertaskPtr> out;
+        std::vector<SupertaskPtr> stack;
+        if (root)
+        {
+            stack.push_back(root);
+        }
+        while (!stack.empty())
+        {
+            auto node = std::move(stack.back());
+            stack.pop_back();
+            for (const auto &weak : node->children)
+            {
+                if (auto child = weak.lock())
+                {
+                    if (child->cut_off != CutOff::None)
+                    {
+                        out.push_back(child);
+                    }
+                    stack.push_back(std::move(child));
+                }
+            }
+        }
+        return out;
+    }
+
+    inline SupertaskPtr Store::open_scope(SupertaskPtr parent, std::optional<TimePoint> deadline)
+    {
+        auto scope = std::make_shared<Supertask>();
+        scope->deadline = deadline;
+        attach_subtask(parent, scope);
+        scope->store = this;
+        //  An inherited deadline is already enforced by the ancestor's timer.
+        bool inherited = parent && parent->deadline && scope->deadline == parent->deadline;
+        if (scope->deadline && !inherited && scope->cut_off == CutOff::None)
+        {
+            std::weak_ptr<Supertask> weak = scope;
+            scope->deadline_timer = enqueue_at(*scope->deadline, [weak]()
+                                               {
+                                                   if (auto locked = weak.lock())
+                                                   {
+                                                       locked->deadline_timer = 0;
+                                                       cancel_subtree(locked, CutOff::DeadlineExpired);
+                                                   } });
+        }
+        return scope;
+    }
+
+    inline Call Store::invoke(const FuncInst &func, SupertaskPtr caller, OnStart on_start, OnResolve on_resolve, TimePoint deadline)
+    {
+        auto scope = open_scope(std::move(caller), deadline);
+        auto call = invoke(func, scope, std::move(on_start), std::move(on_resolve));
+        scope->call = call;
+        if (scope->cut_off != CutOff::None)
+        {
+            call.request_cancellation();
+        }
+        call.scope_ = std::move(scope);
+        return call;
+    }
+
     inline Call Store::invoke(const FuncInst &func, SupertaskPtr caller, OnStart on_start, OnResolve on_resolve)
     {
         if (!func)
@@ -446,13 +1184,36 @@ namespace cmcpp
         return func(*this, std::move(caller), std::move(on_start), std::move(on_resolve));
     }
 
-    inline void Store::tick()
+    inline bool Store::tick()
     {
         std::function<void()> microtask;
         std::shared_ptr<Thread> selected;
+        std::shared_ptr<SchedulingGroup> group;
+        SchedulingGroup *boosted = nullptr;
+        std::vector<TimerWheel::Callback> expired;
+        CMCPP_SCHED_RECORD(metrics_.ticks.fetch_add(1, std::memory_order_relaxed);)
+
+        std::size_t polled = 0;
+        if (poller_)
+        {
+            polled = poller_->poll(0);
+        }
+        {
+            std::lock_guard lock(mutex_);
+            if (!timers_.empty())
+            {
+                timers_.advance(now(), expired);
+            }
+        }
+        for (auto &callback : expired)
+        {
+            callback();
+        }
+        CMCPP_SCHED_RECORD(metrics_.timers_fired.fetch_add(expired.size(), std::memory_order_relaxed);)
 
         {
             std::lock_guard lock(mutex_);
+            CMCPP_SCHED_RECORD(metrics_.pending_depth.record(pending_.size());)
             if (!microtasks_.empty())
             {
                 microtask = std::move(microtasks_.front());
@@ -460,27 +1221,156 @@ namespace cmcpp
             }
             else
             {
-                auto it = std::find_if(pending_.begin(), pending_.end(), [](const std::shared_ptr<Thread> &thread)
-                                       { return thread && thread->ready(); });
+                auto it = grouped_ ? select_grouped(boosted)
+                                   : std::find_if(pending_.begin(), pending_.end(), [](const std::shared_ptr<Thread> &thread)
+                                                  { return thread && thread->ready(); });
                 if (it == pending_.end())
                 {
-                    return;
+                    CMCPP_SCHED_RECORD(metrics_.idle_ticks.fetch_add(1, std::memory_order_relaxed);)
+                    return polled > 0 || !expired.empty();
                 }
                 selected = *it;
                 pending_.erase(it);
+                if (grouped_)
+                {
+                    group = selected->group_ ? selected->group_ : default_group_;
+                }
             }
         }
 
         if (microtask)
         {
+            CMCPP_SCHED_RECORD(metrics_.microtasks.fetch_add(1, std::memory_order_relaxed);)
             microtask();
-            return;
+            return true;
         }
 
-        if (selected)
+#ifdef CMCPP_SCHED_METRICS
+        auto *outer_store = std::exchange(current_store(), this);
+        uint64_t resumed_ns = metrics_now_ns();
+        uint64_t queued_ns = selected->queued_ns_.load(std::memory_order_relaxed);
+        metrics_.queue_latency_ns.record(resumed_ns > queued_ns ? resumed_ns - queued_ns : 0);
+        struct SliceRecorder
         {
+            Store *store;
+            Store *outer;
+            Thread *thread;
+            uint64_t start;
+            ~SliceRecorder()
+            {
+                uint64_t slice = metrics_now_ns() - start;
+                store->metrics_.run_slice_ns.record(slice);
+                thread->run_ns_.fetch_add(slice, std::memory_order_relaxed);
+                current_store() = outer;
+            }
+        } slice_recorder{this, outer_store, selected.get(), resumed_ns};
+#endif
+
+        if (group)
+        {
+            auto start = Clock::now();
             selected->resume();
+            charge(*group, Clock::now() - start);
+            if (group.get() == boosted)
+            {
+                group->boosts_.fetch_add(1, std::memory_order_relaxed);
+            }
         }
+        else if (selected)
+        {
+            selected->resume();
+        }
+        return true;
+    }
+
+    //  Considers the first ready thread of each group (FIFO within a group), so
+    //  each tick evaluates at most one readiness predicate per group that has a
+    //  ready thread.
+    inline std::vector<std::shared_ptr<Thread>>::iterator Store::select_grouped(SchedulingGroup *&boosted)
+    {
+        struct Candidate
+        {
+            SchedulingGroup *group;
+            std::vector<std::shared_ptr<Thread>>::iterator it;
+        };
+        std::vector<Candidate> candidates;
+        for (auto it = pending_.begin(); it != pending_.end(); ++it)
+        {
+            if (!*it)
+            {
+                continue;
+            }
+            auto *group = (*it)->group_ ? (*it)->group_.get() : default_group_.get();
+            if (std::any_of(candidates.begin(), candidates.end(), [group](const Candidate &c)
+                            { return c.group == group; }))
+            {
+                continue;
+            }
+            if ((*it)->ready())
+            {
+                candidates.push_back({group, it});
+            }
+        }
+        if (candidates.empty())
+        {
+            return pending_.end();
+        }
+
+        const Candidate *best = nullptr;
+        for (const auto &c : candidates)
+        {
+            if (c.group->starved_streak_ >= sched_options_.starvation_limit &&
+                (!best || c.group->starved_streak_ > best->group->starved_streak_))
+            {
+                best = &c;
+            }
+        }
+        boosted = best ? best->group : nullptr;
+        if (!best)
+        {
+            for (const auto &c : candidates)
+            {
+                auto cls = static_cast<std::size_t>(c.group->priority_);
+                auto vruntime = std::max(c.group->vruntime_, min_vruntime_[cls]);
+                if (!best || c.group->priority_ < best->group->priority_ ||
+                    (c.group->priority_ == best->group->priority_ &&
+                     vruntime < std::max(best->group->vruntime_, min_vruntime_[static_cast<std::size_t>(best->group->priority_)])))
+                {
+                    best = &c;
+                }
+            }
+        }
+
+        for (const auto &c : candidates)
+        {
+            auto *group = c.group;
+            if (&c == best)
+            {
+                group->starved_streak_ = 0;
+                continue;
+            }
+            group->starved_streak_ += 1;
+            group->starved_ticks_.fetch_add(1, std::memory_order_relaxed);
+            if (group->starved_streak_ > group->max_starved_streak_.load(std::memory_order_relaxed))
+            {
+                group->max_starved_streak_.store(group->starved_streak_, std::memory_order_relaxed);
+            }
+        }
+        return best->it;
+    }
+
+    inline void Store::charge(SchedulingGroup &group, Clock::duration elapsed)
+    {
+        auto ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::max(elapsed, sched_options_.quantum)).count());
+        std::lock_guard lock(mutex_);
+        auto cls = static_cast<std::size_t>(group.priority_);
+        //  A group returning from idle resumes at the class minimum rather than
+        //  cashing in the time it did not use.
+        uint64_t base = std::max(group.vruntime_, min_vruntime_[cls]);
+        min_vruntime_[cls] = base;
+        group.vruntime_ = base + ns * SchedulingGroup::DEFAULT_WEIGHT / group.weight_;
+        group.resumes_.fetch_add(1, std::memory_order_relaxed);
+        group.charged_ns_.fetch_add(ns, std::memory_order_relaxed);
     }
 
     inline void Store::schedule(const std::shared_ptr<Thread> &thread)
@@ -489,8 +1379,10 @@ namespace cmcpp
         {
             return;
         }
+        CMCPP_SCHED_RECORD(thread->queued_ns_.store(metrics_now_ns(), std::memory_order_relaxed);)
         std::lock_guard lock(mutex_);
         pending_.push_back(thread);
+        notify_locked();
     }
 
     inline std::size_t Store::pending_size() const
@@ -507,6 +1399,212 @@ namespace cmcpp
         }
         std::lock_guard lock(mutex_);
         microtasks_.push_back(std::move(microtask));
+        notify_locked();
+    }
+
+    inline void Store::post_completion(std::function<void()> completion)
+    {
+        enqueue(std::move(completion));
+    }
+
+    inline void Store::stop()
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+        notify_locked();
+    }
+
+    inline void Store::notify_locked()
+    {
+        notified_ = true;
+        if (!sleeping_)
+        {
+            return;
+        }
+        if (poller_ && poller_->wakeable())
+        {
+            poller_->wake();
+        }
+        else
+        {
+            idle_cv_.notify_all();
+        }
+    }
+
+    inline void Store::run(std::function<bool()> until)
+    {
+        for (;;)
+        {
+            if (until && until())
+            {
+                return;
+            }
+            bool worked = tick();
+
+            std::unique_lock lock(mutex_);
+            if (stopping_)
+            {
+                stopping_ = false;
+                return;
+            }
+            if (worked || notified_ || !microtasks_.empty())
+            {
+                notified_ = false;
+                continue;
+            }
+
+            std::optional<TimePoint> wake_at = timers_.empty() ? std::nullopt : timers_.next_deadline();
+            if (!pending_.empty())
+            {
+                auto recheck = now() + sched_options_.predicate_poll;
+                wake_at = wake_at ? std::min(*wake_at, recheck) : recheck;
+            }
+            auto timeout = wake_at ? std::max(*wake_at - now(), Clock::duration::zero()) : Clock::duration::max();
+
+            sleeping_ = true;
+            if (poller_ && poller_->wakeable())
+            {
+                int timeout_ms = -1;
+                if (wake_at)
+                {
+                    auto ms = std::chrono::ceil<std::chrono::milliseconds>(timeout).count();
+                    timeout_ms = static_cast<int>(std::min<decltype(ms)>(ms, std::numeric_limits<int>::max()));
+                }
+                lock.unlock();
+                poller_->poll(timeout_ms);
+                lock.lock();
+            }
+            else if (wake_at)
+            {
+                idle_cv_.wait_for(lock, timeout, [this]()
+                                  { return notified_; });
+            }
+            else
+            {
+                idle_cv_.wait(lock, [this]()
+                              { return notified_; });
+            }
+            sleeping_ = false;
+            notified_ = false;
+        }
+    }
+
+    inline TimerId Store::enqueue_at(TimePoint deadline, std::function<void()> microtask)
+    {
+        if (!microtask)
+        {
+            return 0;
+        }
+        std::lock_guard lock(mutex_);
+        if (timers_.empty())
+        {
+            //  Catch the idle wheel up in one step rather than tick by tick later.
+            std::vector<TimerWheel::Callback> none;
+            timers_.advance(now(), none);
+        }
+        auto id = timers_.add(deadline, std::move(microtask));
+        //  A sleeping run() must recompute its timeout.
+        notify_locked();
+        return id;
+    }
+
+    inline TimerId Store::enqueue_after(Clock::duration delay, std::function<void()> microtask)
+    {
+        return enqueue_at(now() + delay, std::move(microtask));
+    }
+
+    inline bool Store::cancel_timer(TimerId timer)
+    {
+        std::lock_guard lock(mutex_);
+        return timers_.cancel(timer);
+    }
+
+    inline std::optional<TimePoint> Store::next_deadline() const
+    {
+        std::lock_guard lock(mutex_);
+        return timers_.next_deadline();
+    }
+
+    inline std::size_t Store::timer_count() const
+    {
+        std::lock_guard lock(mutex_);
+        return timers_.size();
+    }
+
+    inline void Store::set_scheduler_options(SchedulerOptions options)
+    {
+        std::lock_guard lock(mutex_);
+        sched_options_ = options;
+    }
+
+    inline SchedulerOptions Store::scheduler_options() const
+    {
+        std::lock_guard lock(mutex_);
+        return sched_options_;
+    }
+
+    inline void Store::set_poller(std::shared_ptr<Poller> poller)
+    {
+        poller_ = std::move(poller);
+    }
+
+    inline void Store::set_shared_executor(std::shared_ptr<Executor> executor)
+    {
+        executor_ = std::move(executor);
+    }
+
+#ifdef CMCPP_SCHED_METRICS
+    inline void Store::set_metrics_exporter(std::function<void(const SchedulerSnapshot &)> exporter, Clock::duration interval)
+    {
+        if (export_timer_)
+        {
+            cancel_timer(std::exchange(export_timer_, 0));
+        }
+        exporter_ = std::move(exporter);
+        export_interval_ = interval;
+        if (exporter_ && interval > Clock::duration::zero())
+        {
+            export_timer_ = enqueue_after(interval, [this]()
+                                          {
+                                              export_timer_ = 0;
+                                              export_metrics();
+                                              if (exporter_)
+                                              {
+                                                  set_metrics_exporter(std::move(exporter_), export_interval_);
+                                              } });
+        }
+    }
+
+    inline void Store::export_metrics()
+    {
+        if (exporter_)
+        {
+            exporter_(metrics_.snapshot());
+        }
+    }
+
+    inline void record_suspend(SuspendReason reason)
+    {
+        if (auto *store = current_store())
+        {
+            store->metrics().record_suspend(reason);
+        }
+    }
+#endif
+
+    inline TimePoint Store::now() const
+    {
+        return clock_ ? clock_() : Clock::now();
+    }
+
+    inline void Store::set_clock(std::function<TimePoint()> clock)
+    {
+        std::lock_guard lock(mutex_);
+        clock_ = std::move(clock);
+        if (timers_.empty())
+        {
+            timers_ = TimerWheel(now());
+        }
     }
 }
 
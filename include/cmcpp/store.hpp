@@ -38,6 +38,12 @@ namespace cmcpp
     template <Option T>
     inline void store(LiftLowerContext &cx, const T &v, uint32_t ptr);
 
+    template <Own T>
+    inline void store(LiftLowerContext &cx, const T &v, uint32_t ptr);
+
+    template <Borrow T>
+    inline void store(LiftLowerContext &cx, const T &v, uint32_t ptr);
+
 }
 
 #endif
@@ -0,0 +1,159 @@
+#ifndef CMCPP_STREAM_ADAPTER_HPP
+#define CMCPP_STREAM_ADAPTER_HPP
+
+#include "host_stream.hpp"
+#include "lower.hpp"
+#include "lift.hpp"
+
+//  Typed host stream ends.
+//
+//  The byte rings in host_stream.hpp move raw element bytes, which is only
+//  meaningful for flat element types.  HostStreamReader<T> and
+//  HostStreamWriter<T> instead lift or lower each guest batch through
+//  ValTrait<T>, the way a list<T> of the same length would be, so
+//  stream<string>, stream<record> and friends reach the host as T values.
+//  Lowering may call the guest's realloc, so unlike the byte rings these
+//  adapters belong to the thread that runs the guest.
+
+#include <deque>
+#include <iterator>
+
+namespace cmcpp
+{
+    //  Host-read end of a stream<T> the guest writes.
+    template <typename T>
+    class HostStreamReader final : public HostStreamPort
+    {
+    public:
+        HostStreamReader(const std::shared_ptr<SharedStreamState> &shared, std::size_t capacity)
+            : HostStreamPort(shared), capacity_(std::max<std::size_t>(capacity, 1))
+        {
+        }
+
+        //  Appends up to max lifted elements to out; returns the count moved.
+        std::size_t read(std::vector<T> &out, std::size_t max = SIZE_MAX)
+        {
+            std::size_t n = std::min(max, queue_.size());
+            auto end = queue_.begin() + static_cast<std::ptrdiff_t>(n);
+            out.insert(out.end(), std::make_move_iterator(queue_.begin()), std::make_move_iterator(end));
+            queue_.erase(queue_.begin(), end);
+            if (n > 0)
+            {
+                kick();
+            }
+            return n;
+        }
+
+        std::size_t size() const
+        {
+            return queue_.size();
+        }
+
+        //  The guest dropped its end and every element it wrote has been read.
+        bool drained() const
+        {
+            return guest_dropped() && queue_.empty();
+        }
+
+        uint32_t transfer(BufferGuestImpl &guest) override
+        {
+            auto n = static_cast<uint32_t>(std::min<std::size_t>(guest.remain(), capacity_ - queue_.size()));
+            if (n == 0)
+            {
+                return 0;
+            }
+            auto batch = list::load_from_range<T>(guest.cx(), guest.position(), n);
+            queue_.insert(queue_.end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+            guest.advance(n);
+            ready();
+            return n;
+        }
+
+        bool finished() const override
+        {
+            return closed();
+        }
+
+    private:
+        std::size_t capacity_;
+        std::deque<T> queue_;
+    };
+
+    //  Host-written end of a stream<T> the guest reads.
+    template <typename T>
+    class HostStreamWriter final : public HostStreamPort
+    {
+    public:
+        HostStreamWriter(const std::shared_ptr<SharedStreamState> &shared, std::size_t capacity)
+            : HostStreamPort(shared), capacity_(std::max<std::size_t>(capacity, 1))
+        {
+        }
+
+        //  Queues values from the front of values; returns the count accepted,
+        //  which is short when the queue is full.  Nothing is accepted after
+        //  close() or once the guest has dropped its end.
+        std::size_t write(std::vector<T> values)
+        {
+            if (closed() || guest_dropped())
+            {
+                return 0;
+            }
+            std::size_t n = std::min(values.size(), capacity_ - queue_.size());
+            queue_.insert(queue_.end(), std::make_move_iterator(values.begin()), std::make_move_iterator(values.begin() + static_cast<std::ptrdiff_t>(n)));
+            if (n > 0)
+            {
+                kick();
+            }
+            return n;
+        }
+
+        std::size_t size() const
+        {
+            return queue_.size();
+        }
+
+        uint32_t transfer(BufferGuestImpl &guest) override
+        {
+            auto n = static_cast<uint32_t>(std::min<std::size_t>(guest.remain(), queue_.size()));
+            if (n == 0)
+            {
+                return 0;
+            }
+            auto &cx = guest.cx();
+            uint32_t ptr = guest.position();
+            for (uint32_t i = 0; i < n; ++i)
+            {
+                cmcpp::store<T>(cx, queue_[i], ptr + i * ValTrait<T>::size);
+            }
+            queue_.erase(queue_.begin(), queue_.begin() + n);
+            guest.advance(n);
+            ready();
+            return n;
+        }
+
+        bool finished() const override
+        {
+            return closed() && queue_.empty();
+        }
+
+    private:
+        std::size_t capacity_;
+        std::deque<T> queue_;
+    };
+
+    //  Creates a stream<T> the host reads; index is the guest's writable end.
+    template <typename T>
+    HostStream<HostStreamReader<T>> host_stream_reader(ComponentInstance &inst, std::size_t capacity, const HostTrap &trap)
+    {
+        return host_stream::open<HostStreamReader<T>, WritableStreamEnd>(inst, make_stream_descriptor<T>(), trap, capacity);
+    }
+
+    //  Creates a stream<T> the host writes; index is the guest's readable end.
+    template <typename T>
+    HostStream<HostStreamWriter<T>> host_stream_writer(ComponentInstance &inst, std::size_t capacity, const HostTrap &trap)
+    {
+        return host_stream::open<HostStreamWriter<T>, ReadableStreamEnd>(inst, make_stream_descriptor<T>(), trap, capacity);
+    }
+}
+
+#endif
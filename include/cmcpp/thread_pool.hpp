@@ -0,0 +1,106 @@
+#ifndef CMCPP_THREAD_POOL_HPP
+#define CMCPP_THREAD_POOL_HPP
+
+#include "runtime.hpp"
+
+//  Fixed-size host thread pool for shared runtime threads.
+//
+//  Installed with Store::set_shared_executor, it runs the bodies of threads
+//  created by canon_thread_spawn_ref/spawn_indirect (shared = true) in
+//  parallel, while their Thread handles stay owned by the Store.  Bodies run
+//  outside Store::tick and so may only touch state that is safe to share
+//  (shared linear memory, atomics); per-worker on_start/on_stop hooks let an
+//  embedder set up thread-local engine state, such as a WAMR thread env.
+
+#include <condition_variable>
+#include <thread>
+
+namespace cmcpp
+{
+    class ThreadPool : public Executor
+    {
+    public:
+        using Hook = std::function<void()>;
+
+        explicit ThreadPool(std::size_t threads = std::thread::hardware_concurrency(), Hook on_start = {}, Hook on_stop = {})
+        {
+            threads = threads == 0 ? 1 : threads;
+            workers_.reserve(threads);
+            for (std::size_t i = 0; i < threads; ++i)
+            {
+                workers_.emplace_back([this, on_start, on_stop]()
+                                      {
+                                          if (on_start)
+                                          {
+                                              on_start();
+                                          }
+                                          run();
+                                          if (on_stop)
+                                          {
+                                              on_stop();
+                                          }
+                                      });
+            }
+        }
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        //  Finishes every queued job before joining the workers.
+        ~ThreadPool() override
+        {
+            {
+                std::lock_guard lock(mutex_);
+                stopping_ = true;
+            }
+            ready_.notify_all();
+            for (auto &worker : workers_)
+            {
+                worker.join();
+            }
+        }
+
+        void submit(std::function<void()> job) override
+        {
+            {
+                std::lock_guard lock(mutex_);
+                jobs_.push_back(std::move(job));
+            }
+            ready_.notify_one();
+        }
+
+        std::size_t concurrency() const override
+        {
+            return workers_.size();
+        }
+
+    private:
+        void run()
+        {
+            for (;;)
+            {
+                std::function<void()> job;
+                {
+                    std::unique_lock lock(mutex_);
+                    ready_.wait(lock, [this]()
+                                { return stopping_ || !jobs_.empty(); });
+                    if (jobs_.empty())
+                    {
+                        return;
+                    }
+                    job = std::move(jobs_.front());
+                    jobs_.pop_front();
+                }
+                job();
+            }
+        }
+
+        std::mutex mutex_;
+        std::condition_variable ready_;
+        std::deque<std::function<void()>> jobs_;
+        bool stopping_ = false;
+        std::vector<std::thread> workers_;
+    };
+}
+
+#endif
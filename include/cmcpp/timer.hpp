@@ -0,0 +1,274 @@
+#ifndef CMCPP_TIMER_HPP
+#define CMCPP_TIMER_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cmcpp
+{
+    using Clock = std::chrono::steady_clock;
+    using TimePoint = Clock::time_point;
+    using TimerId = uint64_t;
+
+    //  Hierarchical timer wheel ---
+    //  Four levels of 64 slots at millisecond resolution cover ~4.6 hours; later
+    //  deadlines park in the top level and are re-placed each time it cascades.
+    //  Deadlines round up to the next millisecond so timers never fire early.
+    //  Cancelled timers are dropped lazily when their slot is visited.  A 64-bit
+    //  occupancy mask per level lets advance() jump straight to the next tick
+    //  that has work, and next_deadline() look only at the next occupied slots.
+    class TimerWheel
+    {
+    public:
+        using Callback = std::function<void()>;
+
+        static constexpr uint32_t SLOT_BITS = 6;
+        static constexpr uint32_t SLOTS = 1u << SLOT_BITS;
+        static constexpr uint32_t LEVELS = 4;
+
+        explicit TimerWheel(TimePoint origin = Clock::now()) : origin_(origin) {}
+
+        TimerId add(TimePoint deadline, Callback callback)
+        {
+            TimerId id = next_id_++;
+            uint64_t expiry = ticks_ceil(deadline);
+            timers_.emplace(id, Entry{expiry, std::move(callback)});
+            if (expiry <= current_)
+            {
+                due_.push_back(id);
+            }
+            else
+            {
+                place(id, expiry);
+            }
+            return id;
+        }
+
+        bool cancel(TimerId id)
+        {
+            return timers_.erase(id) > 0;
+        }
+
+        std::size_t size() const
+        {
+            return timers_.size();
+        }
+
+        bool empty() const
+        {
+            return timers_.empty();
+        }
+
+        //  Moves every callback whose deadline is at or before now into expired.
+        void advance(TimePoint now, std::vector<Callback> &expired)
+        {
+            collect(due_, expired);
+            uint64_t target = ticks_floor(now);
+            while (!timers_.empty())
+            {
+                uint64_t tick = next_event();
+                if (tick > target)
+                {
+                    break;
+                }
+                current_ = tick;
+                uint32_t top = 0;
+                while (top + 1 < LEVELS && (current_ & ((uint64_t{1} << (SLOT_BITS * (top + 1))) - 1)) == 0)
+                {
+                    top += 1;
+                }
+                for (uint32_t level = top; level > 0; --level)
+                {
+                    cascade(level);
+                }
+                uint32_t slot = current_ & (SLOTS - 1);
+                occupied_[0] &= ~(uint64_t{1} << slot);
+                collect(wheel_[0][slot], expired);
+            }
+            if (timers_.empty())
+            {
+                clear_slots();
+            }
+            current_ = std::max(current_, target);
+        }
+
+        std::optional<TimePoint> next_deadline() const
+        {
+            if (timers_.empty())
+            {
+                return std::nullopt;
+            }
+            if (!due_.empty())
+            {
+                return origin_ + std::chrono::milliseconds(current_);
+            }
+            std::optional<uint64_t> earliest;
+            for (uint32_t level = 0; level < LEVELS; ++level)
+            {
+                uint64_t position;
+                if (!next_occupied(level, position))
+                {
+                    continue;
+                }
+                //  A slot covers the ticks up to the next slot's boundary.  The
+                //  top level also holds wrapped, later entries, and a slot may
+                //  hold only cancelled ones; both fall back to the boundary.
+                uint32_t shift = SLOT_BITS * level;
+                uint64_t boundary = position << shift;
+                uint64_t end = boundary + (uint64_t{1} << shift);
+                uint64_t at = end;
+                for (TimerId id : wheel_[level][position & (SLOTS - 1)])
+                {
+                    auto it = timers_.find(id);
+                    if (it != timers_.end() && it->second.expiry < at)
+                    {
+                        at = it->second.expiry;
+                    }
+                }
+                at = at < end ? std::max(at, boundary) : boundary;
+                if (!earliest || at < *earliest)
+                {
+                    earliest = at;
+                }
+            }
+            if (!earliest)
+            {
+                return std::nullopt;
+            }
+            return origin_ + std::chrono::milliseconds(*earliest);
+        }
+
+    private:
+        struct Entry
+        {
+            uint64_t expiry;
+            Callback callback;
+        };
+
+        uint64_t ticks_ceil(TimePoint t) const
+        {
+            if (t <= origin_)
+            {
+                return 0;
+            }
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t - origin_).count();
+            return static_cast<uint64_t>((ns + 999'999) / 1'000'000);
+        }
+
+        uint64_t ticks_floor(TimePoint t) const
+        {
+            if (t <= origin_)
+            {
+                return 0;
+            }
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(t - origin_).count());
+        }
+
+        //  expiry >= current_; an entry cascading into the current tick lands in the
+        //  level-0 slot that is collected right after the cascade.
+        void place(TimerId id, uint64_t expiry)
+        {
+            uint64_t delta = expiry - current_;
+            uint32_t level = 0;
+            while (level + 1 < LEVELS && delta >= (uint64_t{1} << (SLOT_BITS * (level + 1))))
+            {
+                level += 1;
+            }
+            uint32_t slot = (expiry >> (SLOT_BITS * level)) & (SLOTS - 1);
+            wheel_[level][slot].push_back(id);
+            occupied_[level] |= uint64_t{1} << slot;
+        }
+
+        //  The slot position (tick >> level shift) of the first occupied slot
+        //  after the current one, up to a full turn ahead.
+        bool next_occupied(uint32_t level, uint64_t &position) const
+        {
+            if (occupied_[level] == 0)
+            {
+                return false;
+            }
+            uint64_t next = (current_ >> (SLOT_BITS * level)) + 1;
+            uint64_t rotated = std::rotr(occupied_[level], static_cast<int>(next & (SLOTS - 1)));
+            position = next + static_cast<uint64_t>(std::countr_zero(rotated));
+            return true;
+        }
+
+        //  The next tick at which a level-0 slot fires or an occupied slot cascades.
+        uint64_t next_event() const
+        {
+            uint64_t tick = UINT64_MAX;
+            for (uint32_t level = 0; level < LEVELS; ++level)
+            {
+                uint64_t position;
+                if (next_occupied(level, position))
+                {
+                    tick = std::min(tick, position << (SLOT_BITS * level));
+                }
+            }
+            return tick;
+        }
+
+        //  Drops ids of cancelled timers once no timer is left.
+        void clear_slots()
+        {
+            for (uint32_t level = 0; level < LEVELS; ++level)
+            {
+                for (uint64_t bits = occupied_[level]; bits != 0; bits &= bits - 1)
+                {
+                    wheel_[level][std::countr_zero(bits)].clear();
+                }
+                occupied_[level] = 0;
+            }
+        }
+
+        void cascade(uint32_t level)
+        {
+            uint32_t slot = (current_ >> (SLOT_BITS * level)) & (SLOTS - 1);
+            occupied_[level] &= ~(uint64_t{1} << slot);
+            scratch_.swap(wheel_[level][slot]);
+            for (TimerId id : scratch_)
+            {
+                auto it = timers_.find(id);
+                if (it != timers_.end())
+                {
+                    place(id, it->second.expiry);
+                }
+            }
+            scratch_.clear();
+        }
+
+        void collect(std::vector<TimerId> &slot, std::vector<Callback> &expired)
+        {
+            scratch_.swap(slot);
+            for (TimerId id : scratch_)
+            {
+                auto it = timers_.find(id);
+                if (it != timers_.end())
+                {
+                    expired.push_back(std::move(it->second.callback));
+                    timers_.erase(it);
+                }
+            }
+            scratch_.clear();
+        }
+
+        TimePoint origin_;
+        uint64_t current_ = 0;
+        TimerId next_id_ = 1;
+        std::unordered_map<TimerId, Entry> timers_;
+        std::array<std::array<std::vector<TimerId>, SLOTS>, LEVELS> wheel_{};
+        std::array<uint64_t, LEVELS> occupied_{};
+        std::vector<TimerId> due_;
+        std::vector<TimerId> scratch_;
+    };
+}
+
+#endif
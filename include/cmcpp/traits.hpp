@@ -982,6 +982,50 @@ namespace cmcpp
     template <typename T>
     using enum_t = uint32_t;
 
+    //  Own / Borrow  ------------------------------------------------------------
+    //  Host-side handle values carry the resource's rep.  R names the resource
+    //  type and provides `static ResourceType &resource_type()`; lifting and
+    //  lowering move handles through the instance's HandleTables (handle.hpp).
+    template <typename R>
+    struct own_t
+    {
+        uint32_t rep = 0;
+        bool operator==(const own_t &) const = default;
+    };
+
+    template <typename R>
+    struct borrow_t
+    {
+        uint32_t rep = 0;
+        bool operator==(const borrow_t &) const = default;
+    };
+
+    template <typename R>
+    struct ValTrait<own_t<R>>
+    {
+        static constexpr ValType type = ValType::Own;
+        using inner_type = R;
+        static constexpr uint32_t size = 4;
+        static constexpr uint32_t alignment = 4;
+        static constexpr std::array<WasmValType, 1> flat_types = {WasmValType::i32};
+    };
+
+    template <typename R>
+    struct ValTrait<borrow_t<R>>
+    {
+        static constexpr ValType type = ValType::Borrow;
+        using inner_type = R;
+        static constexpr uint32_t size = 4;
+        static constexpr uint32_t alignment = 4;
+        static constexpr std::array<WasmValType, 1> flat_types = {WasmValType::i32};
+    };
+
+    template <typename T>
+    concept Own = ValTrait<T>::type == ValType::Own;
+
+    template <typename T>
+    concept Borrow = ValTrait<T>::type == ValType::Borrow;
+
     //  Func  --------------------------------------------------------------------
     constexpr uint32_t MAX_FLAT_PARAMS = 16;
     constexpr uint32_t MAX_FLAT_RESULTS = 1;
@@ -268,6 +268,32 @@ namespace cmcpp
         return LiftLowerContext(trap, convert, opts);
     }
 
+    // Create a callee for canon_thread_spawn_ref/spawn_indirect that runs a guest
+    // thread-start function on its own spawned exec_env.  Safe to invoke from a
+    // ThreadPool worker whose on_start/on_stop hooks call
+    // wasm_runtime_init_thread_env()/wasm_runtime_destroy_thread_env().
+    // @param exec_env: WAMR execution environment the new threads are cloned from
+    // @param start_func: Guest function taking the thread's i32 closure argument
+    // @return: Callee suitable for shared threads
+    inline std::function<void(uint32_t)> create_shared_thread_callee(wasm_exec_env_t exec_env, wasm_function_inst_t start_func)
+    {
+        return [exec_env, start_func](uint32_t c)
+        {
+            wasm_exec_env_t spawned = wasm_runtime_spawn_exec_env(exec_env);
+            if (!spawned)
+            {
+                throw std::runtime_error("Failed to spawn exec_env");
+            }
+            uint32_t argv[1] = {c};
+            bool ok = wasm_runtime_call_wasm(spawned, start_func, 1, argv);
+            wasm_runtime_destroy_spawned_exec_env(spawned);
+            if (!ok)
+            {
+                throw std::runtime_error("Shared thread trapped");
+            }
+        };
+    }
+
     template <typename F>
     void export_func(wasm_exec_env_t exec_env, uint64_t *args)
     {
@@ -20,6 +20,9 @@ using namespace cmcpp;
 #include <stdexcept>
 #include <cstring>
 #include <thread>
+#if defined(__linux__)
+#include <fcntl.h>
+#endif
 // #include <fmt/core.h>
 
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
@@ -344,6 +347,56 @@ TEST_CASE("Thread suspend_until supports force yield gating")
     CHECK(thread->ready());
 }
 
+TEST_CASE("Threads are pooled per store and accept move-only callables")
+{
+    Store store;
+    auto pool = store.thread_pool();
+    REQUIRE(pool);
+
+    std::size_t resumed = 0;
+    for (int round = 0; round < 3; ++round)
+    {
+        std::vector<std::shared_ptr<Thread>> threads;
+        for (int i = 0; i < 100; ++i)
+        {
+            auto token = std::make_unique<int>(i);
+            threads.push_back(Thread::create(
+                store,
+                nullptr,
+                [token = std::move(token), &resumed](bool cancelled)
+                {
+                    CHECK_FALSE(cancelled);
+                    resumed += (*token >= 0) ? 1 : 0;
+                    return false;
+                }));
+        }
+        CHECK(pool->live() == 100);
+        while (store.pending_size() > 0)
+        {
+            store.tick();
+        }
+        for (auto &thread : threads)
+        {
+            CHECK(thread->completed());
+        }
+    }
+    CHECK(resumed == 300);
+    CHECK(pool->live() == 0);
+    // Released blocks are recycled instead of growing the pool each round.
+    CHECK(pool->capacity() == 2 * SlabPool::BLOCKS_PER_SLAB);
+
+    // A thread may outlive its store; the pool stays alive with it.
+    std::shared_ptr<Thread> survivor;
+    {
+        Store scoped;
+        survivor = Thread::create_suspended(scoped, [](bool)
+                                            { return false; });
+        survivor->set_index(7);
+    }
+    CHECK(survivor->suspended());
+    CHECK(survivor->index() == 7u);
+}
+
 TEST_CASE("Store microtasks run before pending threads")
 {
     Store store;
@@ -570,6 +623,127 @@ TEST_CASE("Waitable sets deliver events and enforce invariants")
     CHECK_THROWS(inst.table.get<WaitableSet>(waitable_index, trap));
 }
 
+TEST_CASE("Waitable sets deliver events in the order they fire")
+{
+    ComponentInstance inst;
+    HostTrap trap = [](const char *msg)
+    {
+        throw std::runtime_error(msg ? msg : "trap");
+    };
+    uint32_t set_index = canon_waitable_set_new(inst, trap);
+    auto *wset = inst.table.borrow<WaitableSet>(set_index, trap);
+
+    constexpr uint32_t COUNT = 5000;
+    std::vector<std::shared_ptr<Waitable>> waitables;
+    std::vector<uint32_t> indices;
+    for (uint32_t i = 0; i < COUNT; ++i)
+    {
+        waitables.push_back(std::make_shared<Waitable>());
+        indices.push_back(inst.table.add(waitables.back(), trap));
+        canon_waitable_join(inst, indices.back(), set_index, trap);
+    }
+    CHECK(wset->size() == COUNT);
+    CHECK_FALSE(wset->has_pending_event());
+
+    //  A member that fires again queues behind the ones already waiting.
+    auto fire = [&](uint32_t i)
+    {
+        waitables[i]->set_pending_event({EventCode::STREAM_READ, indices[i], i});
+    };
+    fire(0);
+    fire(COUNT - 1);
+    fire(7);
+    CHECK(wset->take_pending_event(trap).payload == 0);
+    fire(0);
+    fire(COUNT - 1);
+    std::vector<uint32_t> order;
+    while (wset->has_pending_event())
+    {
+        order.push_back(wset->take_pending_event(trap).payload);
+    }
+    CHECK(order == std::vector<uint32_t>{COUNT - 1, 7, 0});
+
+    //  Consuming an event directly, or leaving the set, unlinks the member.
+    fire(3);
+    fire(4);
+    waitables[3]->get_pending_event(trap);
+    canon_waitable_join(inst, indices[4], 0, trap);
+    CHECK_FALSE(wset->has_pending_event());
+    CHECK_THROWS(wset->take_pending_event(trap));
+    canon_waitable_join(inst, indices[4], set_index, trap);
+    CHECK(wset->take_pending_event(trap).payload == 4);
+
+    //  Events fired from another thread are each delivered exactly once.
+    std::thread producer([&]
+                         {
+                             for (uint32_t i = 0; i < COUNT; ++i)
+                             {
+                                 fire(i);
+                             } });
+    std::vector<bool> seen(COUNT, false);
+    uint32_t taken = 0;
+    while (taken < COUNT)
+    {
+        if (wset->has_pending_event())
+        {
+            auto payload = wset->take_pending_event(trap).payload;
+            CHECK_FALSE(seen[payload]);
+            seen[payload] = true;
+            ++taken;
+        }
+    }
+    producer.join();
+    CHECK_FALSE(wset->has_pending_event());
+
+    for (uint32_t i = 0; i < COUNT; ++i)
+    {
+        canon_waitable_join(inst, indices[i], 0, trap);
+    }
+    CHECK(wset->size() == 0);
+    canon_waitable_set_drop(inst, set_index, trap);
+}
+
+TEST_CASE("Instance table checks kinds and generations")
+{
+    ComponentInstance inst;
+    HostTrap trap = [](const char *msg)
+    {
+        throw std::runtime_error(msg ? msg : "trap");
+    };
+
+    auto wset = std::make_shared<WaitableSet>();
+    uint32_t set_index = inst.table.add(wset, trap);
+    uint32_t waitable_index = inst.table.add(std::make_shared<Waitable>(), trap);
+    CHECK(inst.table.borrow<WaitableSet>(set_index, trap) == wset.get());
+    CHECK(inst.table.get<WaitableSet>(set_index, trap) == wset);
+    CHECK(inst.table.borrow<TableEntry>(set_index, trap) == wset.get());
+    CHECK_THROWS(inst.table.borrow<Waitable>(set_index, trap));
+    CHECK_THROWS(inst.table.borrow<WaitableSet>(waitable_index, trap));
+    CHECK_THROWS(inst.table.borrow<ThreadEntry>(waitable_index, trap));
+
+    //  Stream ends are Waitables; Waitable lookups accept any derived kind.
+    StreamDescriptor descriptor{1, 1, typeid(uint8_t)};
+    auto shared = std::make_shared<SharedStreamState>(descriptor);
+    uint32_t readable_index = inst.table.add(std::make_shared<ReadableStreamEnd>(shared), trap);
+    CHECK(inst.table.borrow<Waitable>(readable_index, trap) != nullptr);
+    CHECK(inst.table.borrow<CopyEnd>(readable_index, trap) != nullptr);
+    CHECK_THROWS(inst.table.borrow<WritableStreamEnd>(readable_index, trap));
+
+    auto key = inst.table.key(set_index, trap);
+    CHECK(inst.table.borrow<WaitableSet>(key, trap) == wset.get());
+    inst.table.remove<WaitableSet>(set_index, trap);
+    CHECK_THROWS(inst.table.get_entry(set_index, trap));
+
+    //  Freed indices are reused most recent first, under a new generation.
+    uint32_t reused = inst.table.add(std::make_shared<WaitableSet>(), trap);
+    CHECK(reused == set_index);
+    CHECK_THROWS(inst.table.borrow<WaitableSet>(key, trap));
+    CHECK(inst.table.key(reused, trap).generation == key.generation + 1);
+
+    CHECK_THROWS(inst.table.get_entry(0, trap));
+    CHECK_THROWS(inst.table.get_entry(1000, trap));
+}
+
 TEST_CASE("Task yield, cancel, and return")
 {
     Store store;
@@ -1062,6 +1236,84 @@ TEST_CASE("thread.available-parallelism returns at least 1")
     CHECK(canon_thread_available_parallelism(true, task, trap) >= 1);
 }
 
+TEST_CASE("Shared threads run in parallel on the store's executor")
+{
+    Store store;
+    ComponentInstance inst;
+    inst.store = &store;
+    store.set_shared_executor(std::make_shared<ThreadPool>(2));
+
+    HostTrap trap = [](const char *msg)
+    {
+        throw std::runtime_error(msg ? msg : "trap");
+    };
+
+    CanonicalOptions async_opts;
+    async_opts.sync = false;
+    Task task(inst, async_opts);
+    CHECK(canon_thread_available_parallelism(true, task, trap) == 2);
+
+    // Each body waits for the other to arrive, which only succeeds if both run
+    // at the same time on different OS threads.
+    auto arrived = std::make_shared<std::atomic<int>>(0);
+    auto met = std::make_shared<std::atomic<int>>(0);
+    auto tick_thread = std::this_thread::get_id();
+    auto body = [arrived, met, tick_thread](uint32_t)
+    {
+        CHECK(std::this_thread::get_id() != tick_thread);
+        arrived->fetch_add(1);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (arrived->load() < 2 && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::yield();
+        }
+        if (arrived->load() == 2)
+        {
+            met->fetch_add(1);
+        }
+    };
+    std::vector<std::function<void(uint32_t)>> table{body};
+
+    std::vector<std::shared_ptr<Thread>> threads;
+    threads.push_back(inst.table.get<ThreadEntry>(canon_thread_spawn_ref(true, task, body, 1, trap), trap)->thread());
+    threads.push_back(inst.table.get<ThreadEntry>(canon_thread_spawn_indirect(true, task, table, 0, 2, trap), trap)->thread());
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!std::all_of(threads.begin(), threads.end(), [](auto &t)
+                        { return t->completed(); }) &&
+           std::chrono::steady_clock::now() < deadline)
+    {
+        store.tick();
+        std::this_thread::yield();
+    }
+    for (auto &thread : threads)
+    {
+        CHECK(thread->completed());
+    }
+    CHECK(met->load() == 2);
+
+    // Unshared threads keep running cooperatively inside tick().
+    bool on_tick_thread = false;
+    auto idx = canon_thread_spawn_ref(false, task, [&](uint32_t)
+                                      { on_tick_thread = std::this_thread::get_id() == tick_thread; }, 0, trap);
+    auto local = inst.table.get<ThreadEntry>(idx, trap)->thread();
+    store.tick();
+    CHECK(local->completed());
+    CHECK(on_tick_thread);
+
+    // A shared thread whose executor is gone by its first resume runs inline,
+    // and like an unshared one it accepts cancellation.
+    bool ran_inline = false;
+    auto late = Thread::create_shared(store, [&]()
+                                      { ran_inline = std::this_thread::get_id() == tick_thread; });
+    CHECK(late->allow_cancellation());
+    store.set_shared_executor(nullptr);
+    late->resume_later();
+    store.tick();
+    CHECK(late->completed());
+    CHECK(ran_inline);
+}
+
 TEST_CASE("thread.switch-to schedules a suspended thread")
 {
     Store store;
@@ -1167,6 +1419,130 @@ TEST_CASE("thread.index returns current thread index")
     CHECK(store.pending_size() == 0);
 }
 
+TEST_CASE("Scheduling groups prioritise, share by weight, and bound starvation")
+{
+    Store store;
+    SchedulerOptions options;
+    options.quantum = std::chrono::milliseconds(10);
+    options.starvation_limit = 1000;
+    store.set_scheduler_options(options);
+
+    auto spin = [&store](const std::shared_ptr<SchedulingGroup> &group, int &count)
+    {
+        auto thread = Thread::create(store, nullptr, [&count](bool)
+                                     {
+                                         count += 1;
+                                         return true; });
+        thread->set_group(group);
+        return thread;
+    };
+
+    auto heavy = std::make_shared<SchedulingGroup>(PriorityClass::Normal, 300);
+    auto light = std::make_shared<SchedulingGroup>(PriorityClass::Normal, 100);
+    int heavy_count = 0;
+    int light_count = 0;
+    auto heavy_thread = spin(heavy, heavy_count);
+    auto light_thread = spin(light, light_count);
+    for (int i = 0; i < 40; ++i)
+    {
+        store.tick();
+    }
+    CHECK(heavy_count == 30);
+    CHECK(light_count == 10);
+    CHECK(heavy->stats().resumes == 30);
+    CHECK(light->stats().starved_ticks == 30);
+
+    options.starvation_limit = 4;
+    store.set_scheduler_options(options);
+    auto interactive = std::make_shared<SchedulingGroup>(PriorityClass::Interactive);
+    auto batch = std::make_shared<SchedulingGroup>(PriorityClass::Batch);
+    heavy_thread->set_group(interactive);
+    light_thread->set_group(batch);
+    heavy_count = light_count = 0;
+    for (int i = 0; i < 50; ++i)
+    {
+        store.tick();
+    }
+    CHECK(heavy_count == 40);
+    CHECK(light_count == 10);
+    CHECK(batch->stats().boosts == 10);
+    CHECK(batch->stats().max_starved_streak == 4);
+    CHECK(interactive->stats().boosts == 0);
+}
+
+#ifdef CMCPP_SCHED_METRICS
+TEST_CASE("Scheduler metrics record latency, run slices and suspensions")
+{
+    Store store;
+    TimePoint now{};
+    store.set_clock([&]
+                    { return now; });
+    ComponentInstance inst;
+    inst.store = &store;
+
+    HostTrap trap = [](const char *msg)
+    {
+        throw std::runtime_error(msg ? msg : "trap");
+    };
+
+    std::vector<SchedulerSnapshot> exported;
+    store.set_metrics_exporter([&](const SchedulerSnapshot &snap)
+                               { exported.push_back(snap); },
+                               std::chrono::milliseconds(10));
+
+    CanonicalOptions async_opts;
+    async_opts.sync = false;
+    auto task = std::make_shared<Task>(inst, async_opts);
+    int resumes = 0;
+    auto thread = Thread::create(
+        store,
+        nullptr,
+        [&, task](bool)
+        {
+            resumes += 1;
+            if (resumes == 1)
+            {
+                canon_thread_suspend(false, *task, trap);
+                return true;
+            }
+            return false;
+        },
+        true);
+    task->set_thread(thread);
+    store.enqueue([] {});
+
+    for (int i = 0; i < 5; ++i)
+    {
+        store.tick();
+    }
+    CHECK(resumes == 2);
+
+    auto snap = store.metrics().snapshot();
+    CHECK(snap.ticks == 5);
+    CHECK(snap.microtasks == 1);
+    CHECK(snap.suspended(SuspendReason::Yield) == 1);
+    CHECK(snap.suspended(SuspendReason::Backpressure) == 0);
+    CHECK(snap.run_slice_ns.count == 2);
+    CHECK(snap.queue_latency_ns.count == 2);
+    CHECK(snap.pending_depth.count == 5);
+    CHECK(snap.idle_ticks == 5 - 1 - 2);
+    CHECK(snap.run_slice_ns.percentile(1.0) <= snap.run_slice_ns.max);
+
+    CHECK(exported.empty());
+    now += std::chrono::milliseconds(10);
+    store.tick();
+    REQUIRE(exported.size() == 1);
+    CHECK(exported[0].ticks == 6);
+    CHECK(exported[0].timers_fired == 0);
+    now += std::chrono::milliseconds(10);
+    store.tick();
+    CHECK(exported.size() == 2);
+    CHECK(exported[1].timers_fired == 1);
+    store.set_metrics_exporter({}, {});
+    CHECK(store.timer_count() == 0);
+}
+#endif
+
 TEST_CASE("thread.suspend forces a yield")
 {
     Store store;
@@ -1221,79 +1597,974 @@ TEST_CASE("thread.suspend forces a yield")
     CHECK(store.pending_size() == 0);
 }
 
-TEST_CASE("Canonical options control lift/lower callbacks")
+TEST_CASE("Timer wheel fires in deadline order across levels")
 {
-    SUBCASE("post_return runs once for heap spill")
+    TimePoint origin{};
+    TimerWheel wheel(origin);
+    std::vector<int> fired;
+    std::vector<TimerWheel::Callback> expired;
+    auto run = [&](TimePoint now)
     {
-        Heap heap(1024);
-        int post_return_calls = 0;
-
-        CanonicalOptions options;
-        options.post_return = GuestPostReturn([&]()
-                                              { ++post_return_calls; });
+        expired.clear();
+        wheel.advance(now, expired);
+        for (auto &callback : expired)
+        {
+            callback();
+        }
+    };
 
-        auto cx = createLiftLowerContext(&heap, std::move(options));
-        using ResultTuple = tuple_t<string_t, string_t>;
-        ResultTuple value{"alpha", "beta"};
+    wheel.add(origin + std::chrono::milliseconds(300000), [&]
+              { fired.push_back(3); });
+    wheel.add(origin + std::chrono::milliseconds(70), [&]
+              { fired.push_back(1); });
+    auto cancelled = wheel.add(origin + std::chrono::milliseconds(80), [&]
+                               { fired.push_back(-1); });
+    wheel.add(origin + std::chrono::milliseconds(4097), [&]
+              { fired.push_back(2); });
+    CHECK(wheel.cancel(cancelled));
+    CHECK(wheel.next_deadline() == origin + std::chrono::milliseconds(70));
+
+    run(origin + std::chrono::microseconds(69999));
+    CHECK(fired.empty());
+    run(origin + std::chrono::milliseconds(70));
+    CHECK(fired == std::vector<int>{1});
+    run(origin + std::chrono::milliseconds(4096));
+    CHECK(fired.size() == 1);
+    run(origin + std::chrono::milliseconds(299999));
+    CHECK(fired == std::vector<int>{1, 2});
+    run(origin + std::chrono::milliseconds(300000));
+    CHECK(fired == std::vector<int>{1, 2, 3});
+    CHECK(wheel.empty());
+
+    wheel.add(origin, [&]
+              { fired.push_back(4); });
+    run(origin + std::chrono::milliseconds(300000));
+    CHECK(fired.back() == 4);
+
+    //  Catching up hours of idle time jumps between occupied slots.
+    auto hours = origin + std::chrono::hours(3);
+    wheel.add(hours, [&]
+              { fired.push_back(5); });
+    auto late = wheel.add(hours + std::chrono::milliseconds(1), [] {});
+    CHECK(wheel.next_deadline() >= origin + std::chrono::milliseconds(300000));
+    CHECK(wheel.next_deadline() <= hours);
+    auto start = std::chrono::steady_clock::now();
+    run(hours - std::chrono::milliseconds(1));
+    CHECK(fired.back() == 4);
+    CHECK(wheel.next_deadline() == hours);
+    run(hours);
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(50));
+    CHECK(fired.back() == 5);
+    CHECK(wheel.cancel(late));
+    CHECK_FALSE(wheel.next_deadline().has_value());
+}
 
-        auto lowered = lower_flat_values<ResultTuple>(*cx, MAX_FLAT_RESULTS, nullptr, std::move(value));
-        CHECK(lowered.size() == 1);
-        CHECK(post_return_calls == 1);
-    }
+TEST_CASE("thread.sleep parks on the store timer wheel")
+{
+    Store store;
+    TimePoint now{};
+    store.set_clock([&]
+                    { return now; });
+    ComponentInstance inst;
+    inst.store = &store;
 
-    SUBCASE("post_return runs once when using provided out pointer")
+    HostTrap trap = [](const char *msg)
     {
-        Heap heap(1024);
-        int post_return_calls = 0;
+        throw std::runtime_error(msg ? msg : "trap");
+    };
 
-        CanonicalOptions options;
-        options.post_return = GuestPostReturn([&]()
-                                              { ++post_return_calls; });
+    bool microtask_ran = false;
+    store.enqueue_after(std::chrono::milliseconds(5), [&]
+                        { microtask_ran = true; });
+    store.tick();
+    CHECK_FALSE(microtask_ran);
+    now += std::chrono::milliseconds(5);
+    store.tick();
+    CHECK(microtask_ran);
 
-        auto cx = createLiftLowerContext(&heap, std::move(options));
-        using ResultTuple = tuple_t<string_t, string_t>;
-        ResultTuple value{"gamma", "delta"};
+    CanonicalOptions async_opts;
+    async_opts.sync = false;
+    auto sleeper = std::make_shared<Task>(inst, async_opts);
+    int resumes = 0;
+    auto thread = Thread::create(
+        store,
+        nullptr,
+        [&, sleeper](bool)
+        {
+            resumes += 1;
+            if (resumes == 1)
+            {
+                CHECK(canon_thread_sleep_until(false, *sleeper, now + std::chrono::milliseconds(10), trap) == static_cast<uint32_t>(SuspendResult::NOT_CANCELLED));
+                return true;
+            }
+            return false;
+        },
+        true);
+    sleeper->set_thread(thread);
 
-        uint32_t out_ptr = align_to(32u, ValTrait<ResultTuple>::alignment);
-        auto lowered = lower_flat_values<ResultTuple>(*cx, MAX_FLAT_RESULTS, &out_ptr, std::move(value));
-        CHECK(lowered.empty());
-        CHECK(post_return_calls == 1);
-    }
+    store.tick();
+    CHECK(resumes == 1);
+    CHECK(store.pending_size() == 0);
+    CHECK(store.timer_count() == 1);
+    CHECK(store.next_deadline() == now + std::chrono::milliseconds(10));
+    now += std::chrono::milliseconds(9);
+    store.tick();
+    CHECK(resumes == 1);
+    now += std::chrono::milliseconds(1);
+    store.tick();
+    CHECK(resumes == 2);
+    CHECK(thread->completed());
 
-    SUBCASE("sync context traps on async lowering")
+    auto cancellable = std::make_shared<Task>(inst, async_opts);
+    std::optional<bool> woke_cancelled;
+    auto long_sleep = Thread::create(
+        store,
+        nullptr,
+        [&, cancellable](bool cancelled)
+        {
+            if (!woke_cancelled && store.timer_count() == 0)
+            {
+                cancellable->suspend_until_deadline(now + std::chrono::hours(1), true);
+                woke_cancelled = false;
+                return true;
+            }
+            woke_cancelled = cancelled;
+            return false;
+        },
+        true);
+    cancellable->set_thread(long_sleep);
+    store.tick();
+    CHECK(store.timer_count() == 1);
+    CHECK(long_sleep->suspended());
+    long_sleep->request_cancellation();
+    CHECK(store.timer_count() == 0);
+    store.tick();
+    REQUIRE(woke_cancelled.has_value());
+    CHECK(*woke_cancelled);
+
+    uint32_t wset = canon_waitable_set_new(inst, trap);
+    Heap heap(64);
+    GuestMemory mem(heap.memory.data(), heap.memory.size());
+    auto waiter = std::make_shared<Task>(inst, async_opts);
+    std::vector<uint32_t> codes;
+    auto deadline = now + std::chrono::milliseconds(3);
+    auto wait_thread = Thread::create(
+        store,
+        nullptr,
+        [&, waiter](bool)
+        {
+            codes.push_back(canon_waitable_set_wait_until(false, mem, *waiter, wset, 0, deadline, trap));
+            return codes.back() == BLOCKED;
+        },
+        true);
+    waiter->set_thread(wait_thread);
+    store.tick();
+    store.tick();
+    CHECK(codes == std::vector<uint32_t>{BLOCKED});
+    now += std::chrono::milliseconds(3);
+    store.tick();
+    store.tick();
+    CHECK(codes == std::vector<uint32_t>{BLOCKED, static_cast<uint32_t>(EventCode::NONE)});
+
+    //  Timed-out waits on a quiet set do not accumulate wakers.
+    auto *quiet = inst.table.borrow<WaitableSet>(wset, trap);
+    for (int round = 0; round < 5; ++round)
     {
-        Heap heap(1024);
-        CanonicalOptions options;
-        auto cx = createLiftLowerContext(&heap, std::move(options));
-        using ResultTuple = tuple_t<string_t, string_t>;
-        CHECK_THROWS(lower_flat_values<ResultTuple>(*cx, 0, nullptr, ResultTuple{"omega", "sigma"}));
+        codes.clear();
+        deadline = now + std::chrono::milliseconds(1);
+        auto again = Thread::create(
+            store,
+            nullptr,
+            [&, waiter](bool)
+            {
+                codes.push_back(canon_waitable_set_wait_until(false, mem, *waiter, wset, 0, deadline, trap));
+                return codes.back() == BLOCKED;
+            },
+            true);
+        waiter->set_thread(again);
+        store.tick();
+        now += std::chrono::milliseconds(1);
+        store.tick();
+        store.tick();
+        CHECK(codes == std::vector<uint32_t>{BLOCKED, static_cast<uint32_t>(EventCode::NONE)});
+        CHECK(quiet->waker_count() <= 1);
     }
+}
 
-    SUBCASE("async callback fires for stream completion")
+#ifdef CMCPP_HAS_REACTOR
+TEST_CASE("Reactor readiness wakes a thread parked on a waitable set")
+{
+    Store store;
+    auto reactor = std::make_shared<Reactor>();
+    store.set_poller(reactor);
+    ComponentInstance inst;
+    inst.store = &store;
+
+    HostTrap trap = [](const char *msg)
     {
-        Heap heap(1024);
-        bool callback_called = false;
-        EventCode observed_code = EventCode::NONE;
-        uint32_t observed_index = 0;
-        uint32_t observed_payload = 0;
+        throw std::runtime_error(msg ? msg : "trap");
+    };
 
-        CanonicalOptions options;
-        options.sync = false;
-        options.callback = GuestCallback([&](EventCode code, uint32_t index, uint32_t payload)
-                                         {
-                                             callback_called = true;
-                                             observed_code = code;
-                                             observed_index = index;
-                                             observed_payload = payload; });
+    int fds[2];
+    REQUIRE(::pipe(fds) == 0);
 
-        auto cx_unique = createLiftLowerContext(&heap, options);
-        std::shared_ptr<LiftLowerContext> cx(cx_unique.release(), [](LiftLowerContext *ptr)
-                                             { delete ptr; });
+    uint32_t index = 0;
+    auto waitable = std::make_shared<FdWaitable>(reactor, fds[0], EPOLLIN, [&index](uint32_t events)
+                                                 { return Event{EventCode::FUTURE_READ, index, events}; });
+    index = inst.table.add(waitable, trap);
+    uint32_t wset = canon_waitable_set_new(inst, trap);
+    canon_waitable_join(inst, index, wset, trap);
+    waitable->arm();
+    CHECK(reactor->registered() == 1);
 
-        HostTrap trap = [](const char *msg)
-        {
-            throw std::runtime_error(msg ? msg : "trap");
-        };
+    Heap heap(64);
+    GuestMemory mem(heap.memory.data(), heap.memory.size());
+    CanonicalOptions async_opts;
+    async_opts.sync = false;
+    auto task = std::make_shared<Task>(inst, async_opts);
+    auto deadline = store.now() + std::chrono::hours(1);
+    std::vector<uint32_t> codes;
+    auto thread = Thread::create(
+        store,
+        nullptr,
+        [&, task](bool)
+        {
+            codes.push_back(canon_waitable_set_wait_until(false, mem, *task, wset, 0, deadline, trap));
+            return codes.back() == BLOCKED;
+        },
+        true);
+    task->set_thread(thread);
+
+    store.tick();
+    store.tick();
+    CHECK(codes == std::vector<uint32_t>{BLOCKED});
+    CHECK(store.pending_size() == 0);
+    CHECK(thread->parked());
+
+    char byte = 'x';
+    REQUIRE(::write(fds[1], &byte, 1) == 1);
+    store.tick();
+    REQUIRE(codes.size() == 2);
+    CHECK(codes[1] == static_cast<uint32_t>(EventCode::FUTURE_READ));
+    uint32_t reported[2];
+    std::memcpy(reported, heap.memory.data(), sizeof(reported));
+    CHECK(reported[0] == index);
+    CHECK((reported[1] & EPOLLIN) != 0);
+    CHECK(thread->completed());
+    CHECK(store.timer_count() == 0);
+    CHECK_FALSE(waitable->armed());
+
+    canon_waitable_join(inst, index, 0, trap);
+    inst.table.remove<FdWaitable>(index, trap);
+    waitable.reset();
+    CHECK(reactor->registered() == 0);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+#endif
+
+#ifdef CMCPP_HAS_FD_STREAM
+TEST_CASE("fd stream endpoints copy between descriptors and guest memory")
+{
+    Store store;
+    auto reactor = std::make_shared<Reactor>();
+    store.set_poller(reactor);
+    ComponentInstance inst;
+    inst.store = &store;
+    HostTrap trap = [](const char *msg)
+    {
+        throw std::runtime_error(msg ? msg : "trap");
+    };
+    Heap heap(256 * 1024);
+    CanonicalOptions options;
+    options.sync = false;
+    auto cx = std::shared_ptr<LiftLowerContext>(createLiftLowerContext(&heap, options).release());
+    auto descriptor = make_stream_descriptor<uint8_t>();
+    CHECK_THROWS(fd_stream_sink(inst, make_stream_descriptor<uint32_t>(), 1, reactor, trap));
+
+    //  A blocking descriptor would stall the Store under the stream mutex.
+    int blocking[2];
+    REQUIRE(::pipe(blocking) == 0);
+    CHECK_THROWS(fd_stream_sink(inst, descriptor, blocking[1], reactor, trap));
+    CHECK_THROWS(fd_stream_source(inst, descriptor, blocking[0], reactor, trap));
+    CHECK(reactor->registered() == 0);
+    ::close(blocking[0]);
+    ::close(blocking[1]);
+
+    //  Guest writes leave through write(2); a full pipe parks the writer
+    //  until the Store's reactor poll sees it writable again.
+    int out[2];
+    REQUIRE(::pipe2(out, O_NONBLOCK) == 0);
+    auto sink = fd_stream_sink(inst, descriptor, out[1], reactor, trap);
+    std::memcpy(heap.memory.data(), "hello", 5);
+    CHECK(canon_stream_write(inst, descriptor, sink.index, cx, 0, 5, trap) == pack_copy_result(CopyResult::Completed, 5));
+    char text[8] = {};
+    CHECK(::read(out[0], text, sizeof(text)) == 5);
+    CHECK(std::string(text) == "hello");
+
+    uint32_t big = 200 * 1024;
+    uint32_t first = canon_stream_write(inst, descriptor, sink.index, cx, 0, big, trap);
+    REQUIRE((first & 0xF) == static_cast<uint32_t>(CopyResult::Completed));
+    uint32_t written = first >> 4;
+    CHECK(written < big);
+    CHECK(canon_stream_write(inst, descriptor, sink.index, cx, written, big - written, trap) == BLOCKED);
+    CHECK(sink.buffer->armed());
+    std::vector<char> drain(big);
+    std::size_t drained = 0;
+    auto *writable = inst.table.borrow<WritableStreamEnd>(sink.index, trap);
+    while (!writable->has_pending_event())
+    {
+        auto n = ::read(out[0], drain.data(), drain.size());
+        drained += n > 0 ? static_cast<std::size_t>(n) : 0;
+        store.tick();
+    }
+    auto event = writable->get_pending_event(trap);
+    CHECK((event.payload & 0xF) == static_cast<uint32_t>(CopyResult::Completed));
+    CHECK((event.payload >> 4) > 0);
+    canon_stream_drop_writable(inst, sink.index, trap);
+
+    //  Reads fill guest memory from read(2); end of file drops the stream.
+    int in[2];
+    REQUIRE(::pipe2(in, O_NONBLOCK) == 0);
+    auto source = fd_stream_source(inst, descriptor, in[0], reactor, trap);
+    CHECK(canon_stream_read(inst, descriptor, source.index, cx, 1024, 64, false, trap) == BLOCKED);
+    REQUIRE(::write(in[1], "abc", 3) == 3);
+    store.tick();
+    auto *readable = inst.table.borrow<ReadableStreamEnd>(source.index, trap);
+    REQUIRE(readable->has_pending_event());
+    CHECK(readable->get_pending_event(trap).payload == pack_copy_result(CopyResult::Completed, 3));
+    CHECK(std::memcmp(heap.memory.data() + 1024, "abc", 3) == 0);
+    ::close(in[1]);
+    CHECK(canon_stream_read(inst, descriptor, source.index, cx, 1024, 64, false, trap) == pack_copy_result(CopyResult::Dropped, 0));
+    CHECK(source.buffer->finished());
+    CHECK(source.buffer->error() == 0);
+    canon_stream_drop_readable(inst, source.index, trap);
+
+    //  Regular files need no reactor and can be read from an offset.
+    FILE *file = std::tmpfile();
+    REQUIRE(file);
+    std::fputs("0123456789", file);
+    std::fflush(file);
+    auto ranged = fd_stream_source(inst, descriptor, ::fileno(file), nullptr, trap, 4);
+    CHECK(canon_stream_read(inst, descriptor, ranged.index, cx, 0, 4, false, trap) == pack_copy_result(CopyResult::Completed, 4));
+    CHECK(std::memcmp(heap.memory.data(), "4567", 4) == 0);
+    CHECK(ranged.buffer->offset() == 8);
+    canon_stream_drop_readable(inst, ranged.index, trap);
+    std::fclose(file);
+
+    sink.buffer.reset();
+    source.buffer.reset();
+    ranged.buffer.reset();
+    CHECK(reactor->registered() == 0);
+    ::close(out[0]);
+    ::close(out[1]);
+    ::close(in[0]);
+}
+#endif
+
+TEST_CASE("Request deadlines cancel whole Supertask subtrees")
+{
+    Store store;
+    auto now = store.now();
+    store.set_clock([&now]()
+                    { return now; });
+    ComponentInstance inst;
+    inst.store = &store;
+
+    CanonicalOptions async_opts;
+    async_opts.sync = false;
+
+    std::vector<std::shared_ptr<Task>> tasks;
+    std::vector<std::string> cancelled;
+    auto start_task = [&](SupertaskPtr parent, std::string name) -> std::shared_ptr<Task>
+    {
+        auto task = std::make_shared<Task>(inst, async_opts, std::move(parent));
+        auto thread = Thread::create(
+            store,
+            []()
+            { return false; },
+            [&cancelled, name](bool was_cancelled)
+            {
+                if (was_cancelled)
+                {
+                    cancelled.push_back(name);
+                }
+                return false;
+            },
+            true);
+        task->set_thread(thread);
+        tasks.push_back(task);
+        return task;
+    };
+
+    FuncInst fan_out = [&](Store &, SupertaskPtr caller, OnStart, OnResolve) -> Call
+    {
+        auto a = start_task(caller, "a");
+        start_task(a->supertask(), "a.1");
+        start_task(caller, "b");
+        return Call::from_thread(a->thread());
+    };
+
+    auto deadline = now + std::chrono::milliseconds(10);
+    auto call = store.invoke(fan_out, nullptr, {}, {}, deadline);
+    REQUIRE(call.scope());
+    CHECK(tasks[1]->deadline() == deadline);
+    store.tick();
+    CHECK(cancelled.empty());
+    CHECK(cut_off_subtasks(call.scope()).empty());
+
+    now += std::chrono::milliseconds(10);
+    for (int i = 0; i < 4; ++i)
+    {
+        store.tick();
+    }
+    std::sort(cancelled.begin(), cancelled.end());
+    CHECK(cancelled == std::vector<std::string>{"a", "a.1", "b"});
+    auto cut = cut_off_subtasks(call.scope());
+    CHECK(cut.size() == 3);
+    for (const auto &node : cut)
+    {
+        CHECK(node->cut_off == CutOff::DeadlineExpired);
+    }
+
+    // Subtasks attached under a cut-off scope are cancelled straight away.
+    cancelled.clear();
+    start_task(call.scope(), "late");
+    store.tick();
+    CHECK(cancelled == std::vector<std::string>{"late"});
+
+    // A nested scope with an earlier deadline, and explicit bulk cancellation.
+    tasks.clear();
+    cancelled.clear();
+    auto outer = store.open_scope(nullptr, now + std::chrono::hours(1));
+    auto inner = store.open_scope(outer, now + std::chrono::milliseconds(5));
+    auto keep = store.open_scope(outer, now + std::chrono::hours(2));
+    CHECK(keep->deadline == outer->deadline);
+    start_task(inner, "inner");
+    start_task(keep, "keep");
+    now += std::chrono::milliseconds(5);
+    store.tick();
+    store.tick();
+    CHECK(cancelled == std::vector<std::string>{"inner"});
+    CHECK(inner->cut_off == CutOff::DeadlineExpired);
+    CHECK(keep->cut_off == CutOff::None);
+
+    cancel_subtree(outer);
+    store.tick();
+    CHECK(cancelled == std::vector<std::string>{"inner", "keep"});
+    CHECK(keep->cut_off == CutOff::Cancelled);
+    CHECK(inner->cut_off == CutOff::DeadlineExpired);
+}
+
+TEST_CASE("Store::run sleeps until posts, timers or stop wake it")
+{
+    auto exercise = [](Store &store)
+    {
+        // A completion posted from another OS thread wakes the idle driver.
+        std::atomic<bool> completed = false;
+        std::thread worker([&]()
+                           {
+                               std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                               store.post_completion([&]()
+                                                     { completed = true; }); });
+#ifdef CMCPP_SCHED_METRICS
+        auto idle_before = store.metrics().idle_ticks.load();
+#endif
+        store.run([&]()
+                  { return completed.load(); });
+        worker.join();
+        CHECK(completed);
+#ifdef CMCPP_SCHED_METRICS
+        // The driver slept instead of spinning while it waited.
+        CHECK(store.metrics().idle_ticks.load() - idle_before < 10);
+#endif
+
+        // Timer deadlines bound the sleep.
+        bool fired = false;
+        auto start = Clock::now();
+        store.enqueue_after(std::chrono::milliseconds(5), [&]()
+                            { fired = true; });
+        store.run([&]()
+                  { return fired; });
+        CHECK(fired);
+        CHECK(Clock::now() - start >= std::chrono::milliseconds(5));
+
+        // stop() ends run() from another thread.
+        std::thread stopper([&]()
+                            {
+                                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                                store.stop(); });
+        store.run();
+        stopper.join();
+    };
+
+    Store plain;
+    exercise(plain);
+
+#ifdef CMCPP_HAS_REACTOR
+    Store polled;
+    polled.set_poller(std::make_shared<Reactor>());
+    exercise(polled);
+#endif
+}
+
+TEST_CASE("Store::run sleeps while coroutines wait on waitables")
+{
+    Store store;
+    SchedulerOptions options;
+    // A polled wait would not be noticed before this elapses.
+    options.predicate_poll = std::chrono::seconds(10);
+    store.set_scheduler_options(options);
+    ComponentInstance inst;
+    inst.store = &store;
+    HostTrap trap = [](const char *msg)
+    {
+        throw std::runtime_error(msg ? msg : "trap");
+    };
+
+    uint32_t wset = canon_waitable_set_new(inst, trap);
+    auto waitable = std::make_shared<Waitable>();
+    uint32_t index = inst.table.add(waitable, trap);
+    canon_waitable_join(inst, index, wset, trap);
+
+    Event event{};
+    auto waiter = [](ComponentInstance &inst, uint32_t wset, HostTrap trap, Event &out) -> task<void>
+    {
+        out = co_await await_waitable_set(inst, wset, false, trap);
+    };
+    auto thread = spawn(store, waiter(inst, wset, trap, event));
+    store.tick();
+    CHECK_FALSE(thread->completed());
+
+    // The event fires on another OS thread; its waker ends run()'s sleep.
+    auto start = Clock::now();
+    std::thread worker([&]()
+                       {
+                           std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                           waitable->set_pending_event({EventCode::STREAM_READ, index, 7}); });
+    store.run([&]()
+              { return thread->completed(); });
+    worker.join();
+    CHECK(Clock::now() - start < std::chrono::seconds(5));
+    CHECK(event.code == EventCode::STREAM_READ);
+    CHECK(event.payload == 7);
+
+    canon_waitable_join(inst, index, 0, trap);
+    canon_waitable_set_drop(inst, wset, trap);
+}
+
+TEST_CASE("Coroutine tasks yield, nest, and respect backpressure")
+{
+    Store store;
+    ComponentInstance inst;
+    inst.store = &store;
+
+    HostTrap trap = [](const char *msg)
+    {
+        throw std::runtime_error(msg ? msg : "trap");
+    };
+
+    std::vector<std::string> log;
+
+    auto child = [](std::vector<std::string> &log, int value) -> task<int>
+    {
+        log.push_back("child");
+        co_await await_yield();
+        co_return value * 2;
+    };
+
+    auto parent = [child](std::vector<std::string> &log) -> task<void>
+    {
+        log.push_back("parent");
+        int doubled = co_await child(log, 21);
+        log.push_back("doubled " + std::to_string(doubled));
+    };
+
+    auto thread = spawn(store, parent(log));
+    CHECK(log.empty());
+    store.tick();
+    CHECK(log == std::vector<std::string>{"parent", "child"});
+    CHECK_FALSE(thread->completed());
+    // A forced yield sits out one scan before it is resumed.
+    store.tick();
+    CHECK_FALSE(thread->completed());
+    store.tick();
+    CHECK(log.back() == "doubled 42");
+    CHECK(thread->completed());
+    CHECK(store.pending_size() == 0);
+
+    // Backpressure entry suspends until the instance is released.
+    CanonicalOptions async_opts;
+    async_opts.sync = false;
+    auto t = std::make_shared<Task>(inst, async_opts);
+    bool entered = false;
+    auto body = [](std::shared_ptr<Task> t, HostTrap trap, bool &entered) -> task<void>
+    {
+        entered = co_await await_enter(*t, trap);
+        t->exit();
+    };
+    canon_backpressure_set(inst, true);
+    auto waiter = spawn(store, body(t, trap, entered), true);
+    t->set_thread(waiter);
+    store.tick();
+    store.tick();
+    CHECK_FALSE(entered);
+    CHECK_FALSE(waiter->ready());
+    canon_backpressure_set(inst, false);
+    CHECK(waiter->ready());
+    store.tick();
+    CHECK(entered);
+    CHECK(waiter->completed());
+
+    // Coroutine bodies plug into Store::invoke as a FuncInst.
+    auto func = make_coroutine_func([](Store &, SupertaskPtr, std::vector<std::any> args) -> task<std::optional<std::vector<std::any>>>
+                                    {
+                                        co_await await_yield();
+                                        co_return std::vector<std::any>{std::any_cast<int32_t>(args[0]) + 1}; });
+    std::optional<std::vector<std::any>> resolved;
+    store.invoke(
+        func, nullptr, []()
+        { return std::vector<std::any>{int32_t(9)}; },
+        [&](std::optional<std::vector<std::any>> values)
+        { resolved = std::move(values); });
+    while (store.pending_size() > 0)
+    {
+        store.tick();
+    }
+    REQUIRE(resolved.has_value());
+    CHECK(std::any_cast<int32_t>((*resolved)[0]) == 10);
+
+    // Exceptions escaping a spawned task surface from tick().
+    spawn(store, []() -> task<void>
+          {
+              co_await await_yield();
+              throw std::runtime_error("boom"); }());
+    store.tick();
+    store.tick();
+    CHECK_THROWS(store.tick());
+}
+
+TEST_CASE("Typed calls and tasks move values without std::any")
+{
+    Store store;
+    ComponentInstance inst;
+    inst.store = &store;
+
+    HostTrap trap = [](const char *msg)
+    {
+        throw std::runtime_error(msg ? msg : "trap");
+    };
+
+    using Params = std::tuple<int32_t, std::string>;
+    using Results = std::tuple<std::string>;
+    auto func = make_typed_coroutine_func<Params, Results>([](Store &, SupertaskPtr, Params args) -> task<std::optional<Results>>
+                                                           {
+                                                               co_await await_yield();
+                                                               auto &[n, s] = args;
+                                                               co_return Results{s + std::to_string(n)}; });
+
+    std::optional<Results> typed;
+    store.invoke_typed<Params, Results>(
+        func, nullptr, []()
+        { return Params{7, "x"}; },
+        [&](std::optional<Results> values)
+        { typed = std::move(values); });
+    while (store.pending_size() > 0)
+    {
+        store.tick();
+    }
+    REQUIRE(typed.has_value());
+    CHECK(std::get<0>(*typed) == "x7");
+
+    // The std::any API stays available through erase_func.
+    std::optional<std::vector<std::any>> erased;
+    store.invoke(
+        erase_func<Params, Results>(func), nullptr, []()
+        { return std::vector<std::any>{int32_t(3), std::string("y")}; },
+        [&](std::optional<std::vector<std::any>> values)
+        { erased = std::move(values); });
+    while (store.pending_size() > 0)
+    {
+        store.tick();
+    }
+    REQUIRE(erased.has_value());
+    REQUIRE(erased->size() == 1);
+    CHECK(std::any_cast<std::string>((*erased)[0]) == "y3");
+
+    CanonicalOptions async_opts;
+    async_opts.sync = false;
+    std::vector<std::optional<Results>> resolved;
+    auto record = [&](std::optional<Results> values)
+    {
+        resolved.push_back(std::move(values));
+    };
+
+    TypedTask<Params, Results> direct(inst, async_opts, {}, record);
+    canon_task_return(direct, Results{"direct"}, trap);
+    CHECK_THROWS(canon_task_return(direct, Results{"again"}, trap));
+
+    TypedTask<Params, Results> boxed(inst, async_opts, {}, record);
+    canon_task_return(static_cast<Task &>(boxed), std::vector<std::any>{std::string("boxed")}, trap);
+
+    REQUIRE(resolved.size() == 2);
+    CHECK(std::get<0>(*resolved[0]) == "direct");
+    CHECK(std::get<0>(*resolved[1]) == "boxed");
+}
+
+TEST_CASE("Backpressure admits queued tasks in FIFO order")
+{
+    Store store;
+    ComponentInstance inst;
+    inst.store = &store;
+
+    HostTrap trap = [](const char *msg)
+    {
+        throw std::runtime_error(msg ? msg : "trap");
+    };
+
+    std::vector<int> order;
+    auto body = [](std::shared_ptr<Task> t, HostTrap trap, std::vector<int> &order, int id) -> task<void>
+    {
+        if (co_await await_enter(*t, trap))
+        {
+            order.push_back(id);
+            co_await await_yield();
+            t->exit();
+        }
+    };
+
+    CanonicalOptions async_opts;
+    async_opts.sync = false;
+    CanonicalOptions sync_opts;
+    sync_opts.sync = true;
+
+    canon_backpressure_set(inst, true);
+    std::vector<std::shared_ptr<Thread>> threads;
+    std::vector<std::shared_ptr<Task>> tasks;
+    auto start = [&](const CanonicalOptions &opts, int id)
+    {
+        auto t = std::make_shared<Task>(inst, opts);
+        auto thread = spawn(store, body(t, trap, order, id), true);
+        t->set_thread(thread);
+        tasks.push_back(t);
+        threads.push_back(thread);
+        store.tick();
+    };
+    start(async_opts, 0);
+    start(sync_opts, 1);
+    start(async_opts, 2);
+    CHECK(inst.admission.size() == 3);
+    CHECK(inst.num_waiting_to_enter == 3);
+    for (auto &thread : threads)
+    {
+        CHECK_FALSE(thread->ready());
+    }
+
+    // Releasing backpressure wakes the leading async task and the exclusive one
+    // behind it, but nothing past the exclusive task.
+    canon_backpressure_set(inst, false);
+    CHECK(threads[0]->ready());
+    CHECK(threads[1]->ready());
+    CHECK_FALSE(threads[2]->ready());
+    CHECK(inst.admission.size() == 1);
+
+    // A late arrival queues behind the existing waiters rather than barging in
+    // ahead of the blocked exclusive task.
+    start(async_opts, 3);
+
+    for (int i = 0; i < 32 && !std::all_of(threads.begin(), threads.end(), [](auto &t)
+                                           { return t->completed(); });
+         ++i)
+    {
+        store.tick();
+    }
+    CHECK(order == std::vector<int>{0, 1, 2, 3});
+    CHECK(inst.admission.size() == 0);
+    CHECK(inst.admission.in_flight() == 0);
+    CHECK(inst.num_waiting_to_enter == 0);
+    CHECK_FALSE(inst.exclusive);
+
+    const auto &stats = inst.admission.stats();
+    CHECK(stats.queued_total == 4);
+    CHECK(stats.admitted == 4);
+    CHECK(stats.max_length == 3);
+    CHECK(stats.max_wait >= Clock::duration::zero());
+}
+
+TEST_CASE("Coroutine awaiters drive streams, futures, and waitable sets")
+{
+    Store store;
+    ComponentInstance inst;
+    inst.store = &store;
+
+    HostTrap trap = [](const char *msg)
+    {
+        throw std::runtime_error(msg ? msg : "trap");
+    };
+
+    Heap heap(256);
+    CanonicalOptions options;
+    options.sync = false;
+    auto cx = std::shared_ptr<LiftLowerContext>(createLiftLowerContext(&heap, options).release());
+
+    auto desc = make_stream_descriptor<int32_t>();
+    uint64_t handles = canon_stream_new(inst, desc, trap);
+    uint32_t readable = static_cast<uint32_t>(handles & 0xFFFFFFFFu);
+    uint32_t writable = static_cast<uint32_t>(handles >> 32);
+
+    uint32_t read_payload = 0;
+    auto reader = [](ComponentInstance &inst, StreamDescriptor desc, uint32_t readable, std::shared_ptr<LiftLowerContext> cx, HostTrap trap, uint32_t &out) -> task<void>
+    {
+        out = co_await await_stream_read(inst, desc, readable, cx, 0, 2, trap);
+    };
+    auto thread = spawn(store, reader(inst, desc, readable, cx, trap, read_payload));
+    store.tick();
+    CHECK_FALSE(thread->completed());
+    store.tick();
+    CHECK(read_payload == 0);
+
+    int32_t to_write[2] = {5, 6};
+    std::memcpy(heap.memory.data() + 32, to_write, sizeof(to_write));
+    uint32_t write_payload = 0;
+    auto writer = [](ComponentInstance &inst, StreamDescriptor desc, uint32_t writable, std::shared_ptr<LiftLowerContext> cx, HostTrap trap, uint32_t &out) -> task<void>
+    {
+        out = co_await await_stream_write(inst, desc, writable, cx, 32, 2, trap);
+    };
+    spawn(store, writer(inst, desc, writable, cx, trap, write_payload));
+    while (store.pending_size() > 0)
+    {
+        store.tick();
+    }
+    CHECK(write_payload == pack_copy_result(CopyResult::Completed, 2));
+    CHECK(read_payload == pack_copy_result(CopyResult::Completed, 2));
+    int32_t read_values[2] = {};
+    std::memcpy(read_values, heap.memory.data(), sizeof(read_values));
+    CHECK(read_values[0] == 5);
+    CHECK(read_values[1] == 6);
+
+    // Futures: the reader completes once the writer posts its value.
+    auto fdesc = make_future_descriptor<int32_t>();
+    uint64_t fhandles = canon_future_new(inst, fdesc, trap);
+    uint32_t freadable = static_cast<uint32_t>(fhandles & 0xFFFFFFFFu);
+    uint32_t fwritable = static_cast<uint32_t>(fhandles >> 32);
+    uint32_t future_result = 0xFF;
+    auto future_reader = [](ComponentInstance &inst, FutureDescriptor desc, uint32_t readable, std::shared_ptr<LiftLowerContext> cx, HostTrap trap, uint32_t &out) -> task<void>
+    {
+        out = co_await await_future_read(inst, desc, readable, cx, 64, trap);
+    };
+    auto future_thread = spawn(store, future_reader(inst, fdesc, freadable, cx, trap, future_result));
+    store.tick();
+    CHECK(future_result == 0xFF);
+    int32_t future_value = 77;
+    std::memcpy(heap.memory.data() + 96, &future_value, sizeof(future_value));
+    canon_future_write(inst, fdesc, fwritable, cx, 96, trap);
+    store.tick();
+    CHECK(future_thread->completed());
+    CHECK(future_result == static_cast<uint32_t>(CopyResult::Completed));
+    int32_t future_read = 0;
+    std::memcpy(&future_read, heap.memory.data() + 64, sizeof(future_read));
+    CHECK(future_read == 77);
+
+    // Waitable sets: wake on the first joined event; cancellation yields TASK_CANCELLED.
+    uint32_t wset = canon_waitable_set_new(inst, trap);
+    canon_waitable_join(inst, readable, wset, trap);
+    Event event{};
+    auto waiter = [](ComponentInstance &inst, uint32_t wset, HostTrap trap, Event &out) -> task<void>
+    {
+        out = co_await await_waitable_set(inst, wset, true, trap);
+    };
+    auto wait_thread = spawn(store, waiter(inst, wset, trap, event), true);
+    store.tick();
+    CHECK(event.code == EventCode::NONE);
+    CHECK(canon_stream_read(inst, desc, readable, cx, 0, 1, false, trap) == BLOCKED);
+    std::memcpy(heap.memory.data() + 32, to_write, sizeof(to_write));
+    canon_stream_write(inst, desc, writable, cx, 32, 1, trap);
+    store.tick();
+    CHECK(wait_thread->completed());
+    CHECK(event.code == EventCode::STREAM_READ);
+    CHECK(event.index == readable);
+
+    auto cancelled_thread = spawn(store, waiter(inst, wset, trap, event), true);
+    store.tick();
+    Call::from_thread(cancelled_thread).request_cancellation();
+    store.tick();
+    CHECK(cancelled_thread->completed());
+    CHECK(event.code == EventCode::TASK_CANCELLED);
+}
+
+TEST_CASE("Canonical options control lift/lower callbacks")
+{
+    SUBCASE("post_return runs once for heap spill")
+    {
+        Heap heap(1024);
+        int post_return_calls = 0;
+
+        CanonicalOptions options;
+        options.post_return = GuestPostReturn([&]()
+                                              { ++post_return_calls; });
+
+        auto cx = createLiftLowerContext(&heap, std::move(options));
+        using ResultTuple = tuple_t<string_t, string_t>;
+        ResultTuple value{"alpha", "beta"};
+
+        auto lowered = lower_flat_values<ResultTuple>(*cx, MAX_FLAT_RESULTS, nullptr, std::move(value));
+        CHECK(lowered.size() == 1);
+        CHECK(post_return_calls == 1);
+    }
+
+    SUBCASE("post_return runs once when using provided out pointer")
+    {
+        Heap heap(1024);
+        int post_return_calls = 0;
+
+        CanonicalOptions options;
+        options.post_return = GuestPostReturn([&]()
+                                              { ++post_return_calls; });
+
+        auto cx = createLiftLowerContext(&heap, std::move(options));
+        using ResultTuple = tuple_t<string_t, string_t>;
+        ResultTuple value{"gamma", "delta"};
+
+        uint32_t out_ptr = align_to(32u, ValTrait<ResultTuple>::alignment);
+        auto lowered = lower_flat_values<ResultTuple>(*cx, MAX_FLAT_RESULTS, &out_ptr, std::move(value));
+        CHECK(lowered.empty());
+        CHECK(post_return_calls == 1);
+    }
+
+    SUBCASE("sync context traps on async lowering")
+    {
+        Heap heap(1024);
+        CanonicalOptions options;
+        auto cx = createLiftLowerContext(&heap, std::move(options));
+        using ResultTuple = tuple_t<string_t, string_t>;
+        CHECK_THROWS(lower_flat_values<ResultTuple>(*cx, 0, nullptr, ResultTuple{"omega", "sigma"}));
+    }
+
+    SUBCASE("async callback fires for stream completion")
+    {
+        Heap heap(1024);
+        bool callback_called = false;
+        EventCode observed_code = EventCode::NONE;
+        uint32_t observed_index = 0;
+        uint32_t observed_payload = 0;
+
+        CanonicalOptions options;
+        options.sync = false;
+        options.callback = GuestCallback([&](EventCode code, uint32_t index, uint32_t payload)
+                                         {
+                                             callback_called = true;
+                                             observed_code = code;
+                                             observed_index = index;
+                                             observed_payload = payload; });
+
+        auto cx_unique = createLiftLowerContext(&heap, options);
+        std::shared_ptr<LiftLowerContext> cx(cx_unique.release(), [](LiftLowerContext *ptr)
+                                             { delete ptr; });
+
+        HostTrap trap = [](const char *msg)
+        {
+            throw std::runtime_error(msg ? msg : "trap");
+        };
 
         auto descriptor = make_stream_descriptor<uint8_t>();
         auto shared_state = std::make_shared<SharedStreamState>(descriptor);
@@ -1318,6 +2589,56 @@ TEST_CASE("Canonical options control lift/lower callbacks")
     }
 }
 
+TEST_CASE("Async call objects are recycled through instance pools")
+{
+    Store store;
+    ComponentInstance inst;
+    inst.store = &store;
+    Heap heap(256);
+
+    HostTrap trap = [](const char *msg)
+    {
+        throw std::runtime_error(msg ? msg : "trap");
+    };
+
+    auto realloc_fn = [&](int ptr, int old_size, int align, int new_size)
+    {
+        return heap.realloc(ptr, static_cast<size_t>(old_size), static_cast<uint32_t>(align), static_cast<size_t>(new_size));
+    };
+    auto icx = createInstanceContext(trap, convert, realloc_fn);
+
+    CanonicalOptions options;
+    options.memory = GuestMemory(heap.memory.data(), heap.memory.size());
+    options.sync = false;
+
+    auto desc = make_stream_descriptor<int32_t>();
+    for (int i = 0; i < 200; ++i)
+    {
+        auto cx = icx->createCallContext(inst, options);
+        CHECK(cx->inst == &inst);
+
+        auto task = std::make_shared<Task>(inst, options);
+        task->set_thread(Thread::create_suspended(store, [](bool)
+                                                  { return false; }));
+
+        uint64_t handles = canon_stream_new(inst, desc, trap);
+        uint32_t readable = static_cast<uint32_t>(handles & 0xFFFF'FFFFu);
+        uint32_t writable = static_cast<uint32_t>(handles >> 32);
+        CHECK(canon_stream_read(inst, desc, readable, cx, 0, 2, false, trap) == BLOCKED);
+        CHECK(canon_stream_write(inst, desc, writable, cx, 64, 2, trap) == pack_copy_result(CopyResult::Completed, 2));
+        inst.table.get<Waitable>(readable, trap)->get_pending_event(trap);
+        canon_stream_drop_readable(inst, readable, trap);
+        canon_stream_drop_writable(inst, writable, trap);
+    }
+
+    // Every call released its objects, and each pool never needed a second slab.
+    for (const auto &pool : {inst.pools.supertasks, inst.pools.buffers, inst.pools.contexts})
+    {
+        CHECK(pool->live() == 0);
+        CHECK(pool->capacity() == SlabPool::BLOCKS_PER_SLAB);
+    }
+}
+
 TEST_CASE("InstanceContext wires canonical options")
 {
     Heap heap(512);
@@ -1613,6 +2934,330 @@ TEST_CASE("context.hpp: SharedStreamState branch coverage")
     }
 }
 
+TEST_CASE("Stream copies move guest bytes directly between memories")
+{
+    HostTrap host_trap = [](const char *msg)
+    {
+        throw std::runtime_error(msg ? msg : "trap");
+    };
+    Heap writer_heap(4096);
+    Heap reader_heap(4096);
+    auto writer_cx = std::shared_ptr<LiftLowerContext>(createLiftLowerContext(&writer_heap, CanonicalOptions{}).release());
+    auto reader_cx = std::shared_ptr<LiftLowerContext>(createLiftLowerContext(&reader_heap, CanonicalOptions{}).release());
+
+    auto descriptor = make_stream_descriptor<uint32_t>();
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        std::memcpy(writer_heap.memory.data() + 1024 + i * 4, &i, 4);
+    }
+
+    auto shared = std::make_shared<SharedStreamState>(descriptor);
+    auto src = std::make_shared<ReadableBufferGuestImpl>(4, 4, writer_cx, 1024, 256, host_trap);
+    auto first = std::make_shared<WritableBufferGuestImpl>(4, 4, reader_cx, 0, 100, host_trap);
+    bool write_done = false;
+    shared->write(src, {}, [&](CopyResult)
+                  { write_done = true; }, host_trap);
+    bool read_done = false;
+    shared->read(first, {}, [&](CopyResult result)
+                 {
+                     read_done = true;
+                     CHECK(result == CopyResult::Completed); }, host_trap);
+    CHECK(read_done);
+    CHECK_FALSE(write_done);
+    CHECK(first->progress() == 100);
+    CHECK(src->progress() == 100);
+    CHECK(std::memcmp(reader_heap.memory.data(), writer_heap.memory.data() + 1024, 400) == 0);
+
+    //  The remainder lands in a second buffer, continuing where the first stopped.
+    auto second = std::make_shared<WritableBufferGuestImpl>(4, 4, reader_cx, 2048, 200, host_trap);
+    shared->read(second, {}, [](CopyResult) {}, host_trap);
+    CHECK(second->progress() == 156);
+    CHECK(src->remain() == 0);
+    CHECK(std::memcmp(reader_heap.memory.data() + 2048, writer_heap.memory.data() + 1024 + 400, 156 * 4) == 0);
+
+    auto extra = std::make_shared<WritableBufferGuestImpl>(4, 4, reader_cx, 0, 1, host_trap);
+    CHECK_THROWS(src->copy_to(*extra, 1, host_trap));
+    auto bytes = std::make_shared<WritableBufferGuestImpl>(1, 1, reader_cx, 0, 4, host_trap);
+    auto fresh = std::make_shared<ReadableBufferGuestImpl>(4, 4, writer_cx, 0, 1, host_trap);
+    CHECK_THROWS(fresh->copy_to(*bytes, 1, host_trap));
+}
+
+TEST_CASE("Host ring-buffer stream endpoints batch host and guest copies")
+{
+    HostTrap host_trap = [](const char *msg)
+    {
+        throw std::runtime_error(msg ? msg : "trap");
+    };
+    Store store;
+    ComponentInstance inst;
+    inst.store = &store;
+    Heap heap(8192);
+    CanonicalOptions options;
+    options.sync = false;
+    auto cx = std::shared_ptr<LiftLowerContext>(createLiftLowerContext(&heap, options).release());
+    auto descriptor = make_stream_descriptor<uint32_t>();
+    auto bytes_of = [](const uint32_t *p, std::size_t n)
+    {
+        return std::span<const uint8_t>(reinterpret_cast<const uint8_t *>(p), n * 4);
+    };
+    auto settle = [&store]()
+    {
+        while (store.tick())
+        {
+        }
+    };
+
+    auto source = host_stream_source(inst, descriptor, 6, host_trap);
+    CHECK(source.buffer->capacity() == 8);
+    auto *readable = inst.table.borrow<ReadableStreamEnd>(source.index, host_trap);
+
+    //  An async read parks on the empty ring; the next host batch posts its
+    //  completion, which the Store's next tick delivers.
+    CHECK(canon_stream_read(inst, descriptor, source.index, cx, 0, 16, false, host_trap) == BLOCKED);
+    uint32_t batch[5] = {1, 2, 3, 4, 5};
+    CHECK(source.buffer->push(bytes_of(batch, 5)) == 5);
+    CHECK_FALSE(readable->has_pending_event());
+    settle();
+    REQUIRE(readable->has_pending_event());
+    CHECK(readable->get_pending_event(host_trap).payload == pack_copy_result(CopyResult::Completed, 5));
+    CHECK(std::memcmp(heap.memory.data(), batch, sizeof(batch)) == 0);
+
+    //  With elements buffered a read completes at once; the ring wraps.
+    std::vector<uint32_t> values;
+    for (uint32_t i = 0; i < 12; ++i)
+    {
+        values.push_back(100 + i);
+    }
+    CHECK(source.buffer->push(bytes_of(values.data(), 12)) == 8);
+    CHECK(canon_stream_read(inst, descriptor, source.index, cx, 64, 16, false, host_trap) == pack_copy_result(CopyResult::Completed, 8));
+    CHECK(source.buffer->push(bytes_of(values.data() + 8, 4)) == 4);
+    CHECK(canon_stream_read(inst, descriptor, source.index, cx, 96, 16, false, host_trap) == pack_copy_result(CopyResult::Completed, 4));
+    CHECK(std::memcmp(heap.memory.data() + 64, values.data(), 48) == 0);
+
+    //  A host thread streams batches while the guest reads synchronously.
+    auto sync_cx = std::shared_ptr<LiftLowerContext>(createLiftLowerContext(&heap, CanonicalOptions{}).release());
+    constexpr uint32_t TOTAL = 4000;
+    std::thread producer([&]()
+                         {
+                             uint32_t next = 0;
+                             while (next < TOTAL)
+                             {
+                                 uint32_t chunk[7];
+                                 uint32_t n = std::min<uint32_t>(7, TOTAL - next);
+                                 for (uint32_t i = 0; i < n; ++i)
+                                 {
+                                     chunk[i] = next + i;
+                                 }
+                                 next += static_cast<uint32_t>(source.buffer->push(bytes_of(chunk, n)));
+                                 std::this_thread::yield();
+                             }
+                             source.buffer->close(); });
+    uint32_t expected = 0;
+    bool ordered = true;
+    uint32_t payload = 0;
+    for (;;)
+    {
+        payload = canon_stream_read(inst, descriptor, source.index, sync_cx, 1024, 32, true, host_trap);
+        for (uint32_t i = 0; i < (payload >> 4); ++i)
+        {
+            uint32_t v;
+            std::memcpy(&v, heap.memory.data() + 1024 + i * 4, 4);
+            ordered = ordered && v == expected++;
+        }
+        if ((payload & 0xF) != static_cast<uint32_t>(CopyResult::Completed))
+        {
+            break;
+        }
+    }
+    producer.join();
+    CHECK(ordered);
+    CHECK(expected == TOTAL);
+    CHECK((payload & 0xF) == static_cast<uint32_t>(CopyResult::Dropped));
+
+    //  Guest writes fill a sink's ring; popping resumes a parked writer.
+    auto sink = host_stream_sink(inst, descriptor, 4, host_trap);
+    std::size_t ready = 0;
+    sink.buffer->set_on_ready([&]()
+                              { ready += 1; });
+    auto *writable = inst.table.borrow<WritableStreamEnd>(sink.index, host_trap);
+    CHECK(canon_stream_write(inst, descriptor, sink.index, cx, 64, 12, host_trap) == pack_copy_result(CopyResult::Completed, 4));
+    CHECK(canon_stream_write(inst, descriptor, sink.index, cx, 80, 8, host_trap) == BLOCKED);
+    uint32_t out[8] = {};
+    CHECK(sink.buffer->pop(std::span<uint8_t>(reinterpret_cast<uint8_t *>(out), sizeof(out))) == 4);
+    settle();
+    REQUIRE(writable->has_pending_event());
+    CHECK(writable->get_pending_event(host_trap).payload == pack_copy_result(CopyResult::Completed, 4));
+    CHECK(sink.buffer->pop(std::span<uint8_t>(reinterpret_cast<uint8_t *>(out + 4), 16)) == 4);
+    CHECK(std::equal(out, out + 8, values.begin()));
+    CHECK(ready == 2);
+
+    canon_stream_drop_writable(inst, sink.index, host_trap);
+    CHECK(sink.buffer->drained());
+    sink.buffer->close();
+    CHECK(source.buffer->push(bytes_of(values.data(), 1)) == 0);
+
+    //  Ready callbacks may pop or push on their own ring.
+    auto echo = host_stream_sink(inst, descriptor, 4, host_trap);
+    std::vector<uint32_t> echoed;
+    echo.buffer->set_on_ready([&]()
+                              {
+                                  uint32_t got[4];
+                                  std::size_t n = echo.buffer->pop(std::span<uint8_t>(reinterpret_cast<uint8_t *>(got), sizeof(got)));
+                                  echoed.insert(echoed.end(), got, got + n); });
+    CHECK(canon_stream_write(inst, descriptor, echo.index, cx, 64, 12, host_trap) == pack_copy_result(CopyResult::Completed, 4));
+    CHECK(canon_stream_write(inst, descriptor, echo.index, cx, 80, 8, host_trap) == pack_copy_result(CopyResult::Completed, 4));
+    CHECK(echoed == std::vector<uint32_t>(values.begin(), values.begin() + 8));
+
+    auto feed = host_stream_source(inst, descriptor, 4, host_trap);
+    uint32_t fed = 0;
+    auto refill = [&]()
+    {
+        uint32_t chunk[4] = {fed, fed + 1, fed + 2, fed + 3};
+        fed += static_cast<uint32_t>(feed.buffer->push(bytes_of(chunk, 4)));
+    };
+    feed.buffer->set_on_ready(refill);
+    refill();
+    CHECK(canon_stream_read(inst, descriptor, feed.index, cx, 512, 4, false, host_trap) == pack_copy_result(CopyResult::Completed, 4));
+    CHECK(canon_stream_read(inst, descriptor, feed.index, cx, 528, 4, false, host_trap) == pack_copy_result(CopyResult::Completed, 4));
+    uint32_t first_eight[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+    CHECK(std::memcmp(heap.memory.data() + 512, first_eight, sizeof(first_eight)) == 0);
+    CHECK(fed == 12);
+}
+
+TEST_CASE("Typed host stream adapters lift and lower element batches")
+{
+    HostTrap host_trap = [](const char *msg)
+    {
+        throw std::runtime_error(msg ? msg : "trap");
+    };
+    ComponentInstance inst;
+    Heap heap(4096);
+    CanonicalOptions options;
+    options.sync = false;
+    auto cx = std::shared_ptr<LiftLowerContext>(createLiftLowerContext(&heap, options).release());
+
+    //  Guest-written strings are lifted one batch per copy.
+    auto reader = host_stream_reader<string_t>(inst, 2, host_trap);
+    auto descriptor = make_stream_descriptor<string_t>();
+    std::vector<string_t> words = {"alpha", "beta", "gamma"};
+    for (uint32_t i = 0; i < words.size(); ++i)
+    {
+        store(*cx, words[i], 64 + i * ValTrait<string_t>::size);
+    }
+    CHECK(canon_stream_write(inst, descriptor, reader.index, cx, 64, 3, host_trap) == pack_copy_result(CopyResult::Completed, 2));
+    CHECK(canon_stream_write(inst, descriptor, reader.index, cx, 64 + 2 * ValTrait<string_t>::size, 1, host_trap) == BLOCKED);
+    std::vector<string_t> received;
+    CHECK(reader.buffer->read(received) == 2);
+    auto *writable = inst.table.borrow<WritableStreamEnd>(reader.index, host_trap);
+    REQUIRE(writable->has_pending_event());
+    CHECK(writable->get_pending_event(host_trap).payload == pack_copy_result(CopyResult::Completed, 1));
+    CHECK(reader.buffer->read(received) == 1);
+    CHECK(received == words);
+    canon_stream_drop_writable(inst, reader.index, host_trap);
+    CHECK(reader.buffer->drained());
+
+    //  Host-written records are lowered into the guest buffer, strings and all.
+    using entry_t = tuple_t<uint32_t, string_t>;
+    auto writer = host_stream_writer<entry_t>(inst, 4, host_trap);
+    auto entry_descriptor = make_stream_descriptor<entry_t>();
+    CHECK(writer.buffer->write({entry_t{1, "one"}, entry_t{2, "two"}}) == 2);
+    uint32_t ptr = 512;
+    CHECK(canon_stream_read(inst, entry_descriptor, writer.index, cx, ptr, 8, false, host_trap) == pack_copy_result(CopyResult::Completed, 2));
+    CHECK(load<entry_t>(*cx, ptr) == entry_t{1, "one"});
+    CHECK(load<entry_t>(*cx, ptr + ValTrait<entry_t>::size) == entry_t{2, "two"});
+    CHECK(writer.buffer->size() == 0);
+    CHECK_THROWS(canon_stream_read(inst, descriptor, writer.index, cx, ptr, 8, false, host_trap));
+
+    CHECK(canon_stream_read(inst, entry_descriptor, writer.index, cx, ptr, 8, false, host_trap) == BLOCKED);
+    CHECK(writer.buffer->write({entry_t{3, "three"}}) == 1);
+    auto *readable = inst.table.borrow<ReadableStreamEnd>(writer.index, host_trap);
+    REQUIRE(readable->has_pending_event());
+    CHECK(readable->get_pending_event(host_trap).payload == pack_copy_result(CopyResult::Completed, 1));
+    CHECK(load<entry_t>(*cx, ptr) == entry_t{3, "three"});
+    writer.buffer->close();
+    CHECK(canon_stream_read(inst, entry_descriptor, writer.index, cx, ptr, 8, false, host_trap) == pack_copy_result(CopyResult::Dropped, 0));
+}
+
+TEST_CASE("Buffered streams wake ends only on watermark crossings")
+{
+    HostTrap host_trap = [](const char *msg)
+    {
+        throw std::runtime_error(msg ? msg : "trap");
+    };
+    ComponentInstance inst;
+    Heap heap(4096);
+    CanonicalOptions options;
+    options.sync = false;
+    auto cx = std::shared_ptr<LiftLowerContext>(createLiftLowerContext(&heap, options).release());
+    auto descriptor = make_stream_descriptor<uint8_t>();
+    CHECK_THROWS(canon_stream_new(inst, descriptor, StreamBuffering{8, 9, 2}, host_trap));
+    CHECK_THROWS(canon_stream_new(inst, descriptor, StreamBuffering{8, 4, 8}, host_trap));
+
+    uint64_t packed = canon_stream_new(inst, descriptor, StreamBuffering{8, 4, 2}, host_trap);
+    uint32_t readable_index = static_cast<uint32_t>(packed);
+    uint32_t writable_index = static_cast<uint32_t>(packed >> 32);
+    auto *readable = inst.table.borrow<ReadableStreamEnd>(readable_index, host_trap);
+    auto *writable = inst.table.borrow<WritableStreamEnd>(writable_index, host_trap);
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        heap.memory[i] = static_cast<uint8_t>(i);
+    }
+    uint32_t sent = 0;
+    auto write = [&](uint32_t n)
+    {
+        uint32_t result = canon_stream_write(inst, descriptor, writable_index, cx, sent, n, host_trap);
+        if (result != BLOCKED)
+        {
+            sent += result >> 4;
+        }
+        return result;
+    };
+    uint32_t received = 0;
+    auto read = [&](uint32_t n)
+    {
+        uint32_t result = canon_stream_read(inst, descriptor, readable_index, cx, 1024 + received, n, false, host_trap);
+        if (result != BLOCKED)
+        {
+            received += result >> 4;
+        }
+        return result;
+    };
+    auto event = [&](Waitable *end)
+    {
+        REQUIRE(end->has_pending_event());
+        return end->get_pending_event(host_trap).payload;
+    };
+
+    //  Writes complete at once; the parked reader wakes at the high-water mark.
+    CHECK(read(16) == BLOCKED);
+    CHECK(write(2) == pack_copy_result(CopyResult::Completed, 2));
+    CHECK_FALSE(readable->has_pending_event());
+    CHECK(write(3) == pack_copy_result(CopyResult::Completed, 3));
+    CHECK(event(readable) == pack_copy_result(CopyResult::Completed, 5));
+    received += 5;
+
+    //  A writer parks on a full buffer until reads drain it to the low-water mark.
+    CHECK(write(8) == pack_copy_result(CopyResult::Completed, 8));
+    CHECK(write(4) == BLOCKED);
+    CHECK(read(3) == pack_copy_result(CopyResult::Completed, 3));
+    CHECK_FALSE(writable->has_pending_event());
+    CHECK(read(4) == pack_copy_result(CopyResult::Completed, 4));
+    CHECK(event(writable) == pack_copy_result(CopyResult::Completed, 4));
+    sent += 4;
+    CHECK(read(16) == pack_copy_result(CopyResult::Completed, 5));
+
+    //  Dropping the writer flushes what a parked reader has not yet seen.
+    CHECK(read(16) == BLOCKED);
+    CHECK(write(1) == pack_copy_result(CopyResult::Completed, 1));
+    CHECK_FALSE(readable->has_pending_event());
+    canon_stream_drop_writable(inst, writable_index, host_trap);
+    CHECK(event(readable) == pack_copy_result(CopyResult::Completed, 1));
+    received += 1;
+    CHECK(read(16) == pack_copy_result(CopyResult::Dropped, 0));
+    CHECK(received == sent);
+    CHECK(std::memcmp(heap.memory.data() + 1024, heap.memory.data(), sent) == 0);
+}
+
 TEST_CASE("Resource handle lifecycle mirrors canonical definitions")
 {
     ComponentInstance resource_impl;
@@ -1654,13 +3299,13 @@ TEST_CASE("Resource handle lifecycle mirrors canonical definitions")
     uint32_t h4 = canon_resource_new(inst, rt, 45, host_trap);
     CHECK(h4 == 4);
 
-    const auto &table_entries = inst.handles.table(rt).entries();
-    CHECK(table_entries.size() == 5);
-    CHECK_FALSE(table_entries[0].has_value());
-    CHECK(table_entries[1].has_value());
-    CHECK(table_entries[2].has_value());
-    CHECK(table_entries[3].has_value());
-    CHECK(table_entries[4].has_value());
+    const auto &table = inst.handles.table(rt);
+    CHECK(table.size() == 5);
+    CHECK_FALSE(table.contains(0));
+    CHECK(table.contains(1));
+    CHECK(table.contains(2));
+    CHECK(table.contains(3));
+    CHECK(table.contains(4));
 
     CHECK(canon_resource_rep(inst, rt, h1, host_trap) == 42);
     CHECK(canon_resource_rep(inst, rt, h2, host_trap) == 43);
@@ -1671,21 +3316,47 @@ TEST_CASE("Resource handle lifecycle mirrors canonical definitions")
     canon_resource_drop(inst, rt, h1, host_trap);
     CHECK(dtor_calls == std::vector<uint32_t>{42});
     auto &table_after_drop = inst.handles.table(rt);
-    CHECK(table_after_drop.entries()[1].has_value() == false);
-    CHECK(table_after_drop.free_list().size() == 1);
+    CHECK_FALSE(table_after_drop.contains(1));
+    CHECK(table_after_drop.free_count() == 1);
 
     uint32_t h5 = canon_resource_new(inst, rt, 46, host_trap);
     CHECK(h5 == 1);
-    CHECK(table_after_drop.entries().size() == 5);
-    CHECK(table_after_drop.entries()[1].has_value());
+    CHECK(table_after_drop.size() == 5);
+    CHECK(table_after_drop.contains(1));
     CHECK(dtor_calls == std::vector<uint32_t>{42});
 
     borrow_scope.borrow_count = 1;
     canon_resource_drop(inst, rt, h3, host_trap);
     CHECK(dtor_calls == std::vector<uint32_t>{42});
     CHECK(borrow_scope.borrow_count == 0);
-    CHECK(table_after_drop.entries()[3].has_value() == false);
-    CHECK(table_after_drop.free_list().size() == 1);
+    CHECK_FALSE(table_after_drop.contains(3));
+    CHECK(table_after_drop.free_count() == 1);
+
+    //  Lends taken during a call are returned when the call exits.
+    borrow_scope.track_owning_lend(table_after_drop, h2);
+    CHECK(table_after_drop.get(h2, host_trap).lend_count == 1);
+    borrow_scope.exit_call();
+    CHECK(table_after_drop.get(h2, host_trap).lend_count == 0);
+
+    //  Each resource type has its own dense id and handle table.
+    ResourceType other(resource_impl);
+    CHECK(other.id() != rt.id());
+    CHECK(canon_resource_new(inst, other, 7, host_trap) == 1);
+    CHECK_THROWS(canon_resource_rep(inst, other, 2, host_trap));
+
+    //  A destroyed type's id goes to the next type, which starts with an
+    //  empty table.
+    uint32_t reused_id;
+    {
+        ResourceType scratch(resource_impl);
+        reused_id = scratch.id();
+        canon_resource_new(inst, scratch, 9, host_trap);
+    }
+    ResourceType successor(resource_impl);
+    CHECK(successor.id() == reused_id);
+    CHECK(inst.handles.find(successor) == nullptr);
+    CHECK_THROWS(canon_resource_rep(inst, successor, 1, host_trap));
+    CHECK(canon_resource_new(inst, successor, 10, host_trap) == 1);
 
     canon_resource_drop(inst, rt, h2, host_trap);
     CHECK(dtor_calls == std::vector<uint32_t>{42, 43});
@@ -1697,13 +3368,334 @@ TEST_CASE("Resource handle lifecycle mirrors canonical definitions")
     CHECK(dtor_calls == std::vector<uint32_t>{42, 43, 45, 46});
 
     auto &final_table = inst.handles.table(rt);
-    CHECK(final_table.free_list().size() == 4);
-    for (size_t i = 1; i < final_table.entries().size(); ++i)
+    CHECK(final_table.free_count() == 4);
+    for (uint32_t i = 1; i < final_table.size(); ++i)
+    {
+        CHECK_FALSE(final_table.contains(i));
+    }
+}
+
+TEST_CASE("Instance reset destroys handles in per-type batches")
+{
+    ComponentInstance inst;
+    HostTrap trap = [](const char *msg)
+    {
+        throw std::runtime_error(msg ? msg : "trap");
+    };
+
+    std::vector<std::vector<uint32_t>> batches;
+    ResourceType files(inst);
+    files.dtor_batch = [&](std::span<const uint32_t> reps)
+    {
+        batches.emplace_back(reps.begin(), reps.end());
+    };
+    std::vector<uint32_t> single;
+    ResourceType sockets(inst, [&](uint32_t rep)
+                         { single.push_back(rep); });
+
+    for (uint32_t rep = 100; rep < 1100; ++rep)
+    {
+        canon_resource_new(inst, files, rep, trap);
+    }
+    uint32_t s1 = canon_resource_new(inst, sockets, 7, trap);
+    canon_resource_new(inst, sockets, 8, trap);
+    canon_resource_drop(inst, files, 5, trap);
+    CHECK(batches.size() == 0);
+
+    LiftLowerOptions opts;
+    HostUnicodeConversion noop_convert = [](void *, uint32_t, const void *, uint32_t, Encoding, Encoding)
+    {
+        return std::pair<void *, size_t>{nullptr, 0};
+    };
+    LiftLowerContext scope(trap, noop_convert, opts, &inst);
+    scope.borrow_count = 1;
+    HandleElement borrowed;
+    borrowed.rep = 9;
+    borrowed.scope = &scope;
+    inst.handles.add(sockets, borrowed, trap);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        inst.table.add(std::make_shared<WaitableSet>(), trap);
+    }
+    auto kept = std::make_shared<Waitable>();
+    uint32_t kept_index = inst.table.add(kept, trap);
+    inst.table.remove<WaitableSet>(2, trap);
+    CHECK(inst.table.size() == 4);
+
+    //  A lent handle blocks teardown before anything is destroyed.
+    scope.track_owning_lend(inst.handles.table(sockets), s1);
+    CHECK_THROWS(reset_instance(inst, trap));
+    CHECK(single.empty());
+    scope.borrow_count = 0;
+    scope.exit_call();
+    scope.borrow_count = 1;
+
+    //  So does a borrow its scope no longer counts, or an impl that may not
+    //  be entered; no table is cleared before every check passes.
+    scope.borrow_count = 0;
+    CHECK_THROWS(reset_instance(inst, trap));
+    scope.borrow_count = 1;
+    ComponentInstance impl;
+    ResourceType pipes(impl);
+    canon_resource_new(inst, pipes, 3, trap);
+    impl.may_enter = false;
+    CHECK_THROWS(reset_instance(inst, trap));
+    CHECK(batches.empty());
+    CHECK(single.empty());
+    CHECK(inst.handles.table(files).contains(1));
+    CHECK(scope.borrow_count == 1);
+    impl.may_enter = true;
+
+    //  Teardown uses the type's current destructor.
+    sockets.dtor = [&](uint32_t rep)
+    {
+        single.push_back(rep + 1000);
+    };
+    reset_instance(inst, trap);
+    REQUIRE(batches.size() == 1);
+    CHECK(batches[0].size() == 999);
+    CHECK(batches[0].front() == 100);
+    CHECK(batches[0].back() == 1099);
+    CHECK(single == std::vector<uint32_t>{1007, 1008});
+    CHECK(scope.borrow_count == 0);
+    CHECK(inst.handles.table(files).free_count() == 0);
+    CHECK_FALSE(inst.handles.table(files).contains(1));
+    CHECK(inst.table.size() == 0);
+    CHECK(kept.use_count() == 1);
+    CHECK_THROWS(inst.table.get_entry(kept_index, trap));
+
+    //  The instance is reusable after a reset.
+    CHECK(canon_resource_new(inst, files, 1, trap) == 1);
+    CHECK(inst.table.add(std::make_shared<WaitableSet>(), trap) != 0);
+}
+
+namespace
+{
+    struct TestFile
+    {
+        static ComponentInstance &impl()
+        {
+            static ComponentInstance instance;
+            return instance;
+        }
+
+        static ResourceType &resource_type()
+        {
+            static ResourceType rt(impl());
+            return rt;
+        }
+    };
+}
+
+TEST_CASE("own and borrow handles transfer through the instance handle table")
+{
+    using file_own = own_t<TestFile>;
+    using file_borrow = borrow_t<TestFile>;
+    auto &rt = TestFile::resource_type();
+    HostTrap trap = [](const char *msg)
+    {
+        throw std::runtime_error(msg ? msg : "trap");
+    };
+
+    ComponentInstance guest;
+    Heap heap(1024);
+    auto cx = createLiftLowerContext(&heap, Encoding::Utf8);
+    cx->inst = &guest;
+
+    //  Lowering an own creates a handle; lifting it moves the rep back out.
+    auto flat = lower_flat(*cx, file_own{42});
+    uint32_t h = static_cast<uint32_t>(std::get<int32_t>(flat[0]));
+    CHECK(canon_resource_rep(guest, rt, h, trap) == 42);
+
+    //  Borrowing an owned handle lends it until the call exits.
+    auto borrowed = lift_flat<file_borrow>(*cx, WasmValVector{static_cast<int32_t>(h)});
+    CHECK(borrowed.rep == 42);
+    CHECK(guest.handles.table(rt).get(h, trap).lend_count == 1);
+    cx->exit_call();
+    CHECK(guest.handles.table(rt).get(h, trap).lend_count == 0);
+
+    auto owned = lift_flat<file_own>(*cx, WasmValVector{static_cast<int32_t>(h)});
+    CHECK(owned == file_own{42});
+    CHECK_FALSE(guest.handles.table(rt).contains(h));
+
+    //  Borrows lowered into another instance are scoped to the call.
+    flat = lower_flat(*cx, file_borrow{7});
+    uint32_t b = static_cast<uint32_t>(std::get<int32_t>(flat[0]));
+    CHECK(cx->borrow_count == 1);
+    CHECK(guest.handles.table(rt).get(b, trap).scope == cx.get());
+    CHECK_THROWS(cx->exit_call());
+    canon_resource_drop(guest, rt, b, trap);
+    CHECK(cx->borrow_count == 0);
+
+    //  Into the implementing instance a borrow is the rep itself.
+    cx->inst = &TestFile::impl();
+    flat = lower_flat(*cx, file_borrow{7});
+    CHECK(std::get<int32_t>(flat[0]) == 7);
+    CHECK(cx->borrow_count == 0);
+    CHECK(TestFile::impl().handles.find(rt) == nullptr);
+    cx->inst = &guest;
+
+    //  Handles nested in a tuple go through memory.
+    using pair_t = tuple_t<file_own, uint32_t>;
+    store(*cx, pair_t{file_own{5}, 9}, 16);
+    auto pair = load<pair_t>(*cx, 16);
+    CHECK(std::get<0>(pair).rep == 5);
+    CHECK(std::get<1>(pair) == 9);
+
+    //  The lender list only allocates past its inline capacity.
+    std::vector<uint32_t> handles;
+    for (uint32_t rep = 0; rep < 10; ++rep)
+    {
+        handles.push_back(canon_resource_new(guest, rt, rep, trap));
+        lift_flat<file_borrow>(*cx, WasmValVector{static_cast<int32_t>(handles.back())});
+        CHECK(cx->lenders.spilled() == (rep >= 8));
+    }
+    cx->exit_call();
+    CHECK(cx->lenders.empty());
+    for (auto handle : handles)
     {
-        CHECK_FALSE(final_table.entries()[i].has_value());
+        CHECK(guest.handles.table(rt).get(handle, trap).lend_count == 0);
     }
 }
 
+TEST_CASE("HostResource keeps host objects in slabs indexed by rep")
+{
+    ComponentInstance inst;
+    HostTrap trap = [](const char *msg)
+    {
+        throw std::runtime_error(msg ? msg : "trap");
+    };
+
+    struct Connection
+    {
+        int fd;
+        int *live;
+        Connection(int f, int *l) : fd(f), live(l) { *live += 1; }
+        ~Connection() { *live -= 1; }
+    };
+
+    int live = 0;
+    HostResource<Connection> connections(inst);
+    std::vector<uint32_t> handles;
+    for (int fd = 0; fd < 600; ++fd)
+    {
+        handles.push_back(connections.create(inst, trap, fd, &live));
+    }
+    CHECK(live == 600);
+    CHECK(connections.size() == 600);
+    CHECK(connections.capacity() == 768);
+
+    auto *first = &connections.get(inst, handles[0], trap);
+    CHECK(first->fd == 0);
+    CHECK(connections.get(inst, handles[599], trap).fd == 599);
+    CHECK(&connections.at(canon_resource_rep(inst, connections.type(), handles[0], trap), trap) == first);
+
+    connections.drop(inst, handles[10], trap);
+    CHECK(live == 599);
+    CHECK_THROWS(connections.get(inst, handles[10], trap));
+    CHECK_THROWS(connections.at(10, trap));
+
+    //  The freed rep is reused, and earlier objects never move.
+    uint32_t again = connections.create(inst, trap, 1000, &live);
+    CHECK(canon_resource_rep(inst, connections.type(), again, trap) == 10);
+    CHECK(&connections.get(inst, handles[0], trap) == first);
+
+    reset_instance(inst, trap);
+    CHECK(live == 0);
+    CHECK(connections.size() == 0);
+
+    connections.create(inst, trap, 1, &live);
+    CHECK(live == 1);
+    reset_instance(inst, trap);
+    CHECK(live == 0);
+
+    //  Objects held without handles are destroyed with their HostResource,
+    //  after which its instance tables no longer reach it.
+    {
+        HostResource<Connection> scoped(inst);
+        scoped.drop(inst, scoped.create(inst, trap, 2, &live), trap);
+        scoped.allocate(3, &live);
+        CHECK(live == 1);
+    }
+    CHECK(live == 0);
+    reset_instance(inst, trap);
+}
+
+TEST_CASE("Concurrent tables resolve handles from several threads")
+{
+    ComponentInstance inst;
+    HostTrap trap = [](const char *msg)
+    {
+        throw std::runtime_error(msg ? msg : "trap");
+    };
+
+    std::atomic<uint32_t> destroyed{0};
+    ResourceType rt(inst, [&](uint32_t)
+                    { destroyed.fetch_add(1); });
+    ConcurrentHandleTables handles;
+    ConcurrentInstanceTable table;
+
+    uint32_t shared_handle = canon_resource_new(handles, rt, 7, trap);
+    uint32_t shared_entry = table.add(std::make_shared<WaitableSet>(), trap);
+
+    constexpr uint32_t THREADS = 4;
+    constexpr uint32_t ROUNDS = 2000;
+    std::atomic<uint32_t> mismatches{0};
+    std::vector<std::thread> workers;
+    for (uint32_t t = 0; t < THREADS; ++t)
+    {
+        workers.emplace_back([&, t]()
+                             {
+                                 for (uint32_t i = 0; i < ROUNDS; ++i)
+                                 {
+                                     uint32_t rep = t * ROUNDS + i;
+                                     uint32_t h = canon_resource_new(handles, rt, rep, trap);
+                                     if (canon_resource_rep(handles, rt, h, trap) != rep ||
+                                         canon_resource_rep(handles, rt, shared_handle, trap) != 7)
+                                     {
+                                         mismatches.fetch_add(1);
+                                     }
+                                     canon_resource_drop(inst, handles, rt, h, trap);
+
+                                     uint32_t e = table.add(std::make_shared<Waitable>(), trap);
+                                     if (!table.get<WaitableSet>(shared_entry, trap) || !table.get<Waitable>(e, trap))
+                                     {
+                                         mismatches.fetch_add(1);
+                                     }
+                                     table.remove<Waitable>(e, trap);
+                                 } });
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    CHECK(mismatches.load() == 0);
+    CHECK(destroyed.load() == THREADS * ROUNDS);
+
+    //  Freed indices are recycled, so the tables stay small.
+    uint32_t fresh = canon_resource_new(handles, rt, 8, trap);
+    CHECK(fresh <= THREADS + 1);
+
+    auto key = table.key(shared_entry, trap);
+    CHECK_THROWS(table.get<Waitable>(shared_entry, trap));
+    table.remove<WaitableSet>(shared_entry, trap);
+    CHECK_THROWS(table.get(shared_entry, trap));
+    uint32_t reused = table.add(std::make_shared<WaitableSet>(), trap);
+    if (reused == key.index)
+    {
+        CHECK_THROWS(table.get<WaitableSet>(key, trap));
+    }
+    table.collect();
+
+    //  Lend counts are atomic and visible through get().
+    handles.lend(rt, shared_handle, trap);
+    CHECK(handles.get(rt, shared_handle, trap).lend_count == 1);
+    handles.end_lend(rt, shared_handle);
+    canon_resource_drop(inst, handles, rt, shared_handle, trap);
+    CHECK_THROWS(canon_resource_rep(handles, rt, shared_handle, trap));
+}
+
 TEST_CASE("Boolean")
 {
     Heap heap(1024 * 1024);
@@ -2330,6 +4322,59 @@ TEST_CASE("Stream sync read blocks until write")
     CHECK(heap.memory[read_ptr] == 0x7B);
 }
 
+#ifdef CMCPP_HAS_FIBERS
+TEST_CASE("Fiber sync stream calls suspend instead of blocking")
+{
+    Heap heap(256);
+    CanonicalOptions options;
+    options.sync = true;
+    auto cx = std::shared_ptr<LiftLowerContext>(createLiftLowerContext(&heap, options).release(), [](LiftLowerContext *ptr)
+                                                { delete ptr; });
+
+    HostTrap host_trap = [](const char *msg)
+    {
+        throw std::runtime_error(msg ? msg : "trap");
+    };
+
+    auto descriptor = make_stream_descriptor<uint8_t>();
+    auto shared_state = std::make_shared<SharedStreamState>(descriptor);
+    ReadableStreamEnd readable(shared_state);
+    WritableStreamEnd writable(shared_state);
+
+    uint32_t read_ptr = 0;
+    uint32_t write_ptr = 64;
+    heap.memory[write_ptr] = 0x5A;
+
+    Store store;
+    uint32_t read_result = 0;
+    uint32_t write_result = 0;
+    auto reader = spawn_fiber(store, [&]()
+                              { read_result = readable.read(cx, 1, read_ptr, 1, true, host_trap); });
+
+    store.tick();
+    CHECK_FALSE(reader->completed());
+    CHECK(read_result == 0);
+
+    auto writer = spawn_fiber(store, [&]()
+                              { write_result = writable.write(cx, 2, write_ptr, 1, true, host_trap); });
+
+    for (int i = 0; i < 8 && !(reader->completed() && writer->completed()); ++i)
+    {
+        store.tick();
+    }
+    CHECK(reader->completed());
+    CHECK(writer->completed());
+    CHECK(read_result == pack_copy_result(CopyResult::Completed, 1));
+    CHECK((write_result & 0xF) == static_cast<uint32_t>(CopyResult::Completed));
+    CHECK(heap.memory[read_ptr] == 0x5A);
+    CHECK(current_suspender() == nullptr);
+
+    auto failing = spawn_fiber(store, []()
+                               { throw std::runtime_error("fiber failure"); });
+    CHECK_THROWS_AS(store.tick(), std::runtime_error);
+}
+#endif
+
 TEST_CASE("Stream cancel-write posts events")
 {
     ComponentInstance inst;